@@ -0,0 +1,142 @@
+#include "AdaptiveSampler.h"
+#include "Shader.h"
+
+namespace {
+
+void allocateTargets(AdaptiveSampler& sampler, int width, int height) {
+    sampler.tilesX = (width + kAdaptiveTileSize - 1) / kAdaptiveTileSize;
+    sampler.tilesY = (height + kAdaptiveTileSize - 1) / kAdaptiveTileSize;
+    sampler.pixelMask = createRenderTarget(width, height, { GL_R8 });
+    sampler.tileMask = createRenderTarget(sampler.tilesX, sampler.tilesY, { GL_R8 });
+
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, sampler.readbackBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sampler.tilesX * sampler.tilesY, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void dropFences(AdaptiveSampler& sampler) {
+    for (int i = 0; i < 2; i++) {
+        if (sampler.readbackFences[i]) {
+            glDeleteSync(sampler.readbackFences[i]);
+            sampler.readbackFences[i] = 0;
+        }
+    }
+}
+
+}  // namespace
+
+void createAdaptiveSampler(AdaptiveSampler& sampler, int width, int height) {
+    glGenBuffers(2, sampler.readbackBuffers);
+    allocateTargets(sampler, width, height);
+    createTileList(sampler.activeTiles);
+    sampler.maskProgram = createShaderProgram("vertex_shader.glsl", "adaptive_mask_shader.glsl");
+    sampler.tileProgram = createShaderProgram("vertex_shader.glsl", "adaptive_tile_shader.glsl");
+}
+
+void resizeAdaptiveSampler(AdaptiveSampler& sampler, int width, int height) {
+    if (sampler.pixelMask.width == width && sampler.pixelMask.height == height) {
+        return;
+    }
+    dropFences(sampler);
+    destroyRenderTarget(sampler.pixelMask);
+    destroyRenderTarget(sampler.tileMask);
+    allocateTargets(sampler, width, height);
+    resetAdaptiveSampler(sampler);
+}
+
+void resetAdaptiveSampler(AdaptiveSampler& sampler) {
+    sampler.activeTilesValid = false;
+    sampler.generation++;
+}
+
+void updateAdaptiveMasks(AdaptiveSampler& sampler, GLuint historyMoments) {
+    // Per-pixel convergence test
+    glBindFramebuffer(GL_FRAMEBUFFER, sampler.pixelMask.fbo);
+    glViewport(0, 0, sampler.pixelMask.width, sampler.pixelMask.height);
+    glUseProgram(sampler.maskProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, historyMoments);
+    glUniform1i(glGetUniformLocation(sampler.maskProgram, "uHistoryMoments"), 0);
+    glUniform1f(glGetUniformLocation(sampler.maskProgram, "uThreshold"), sampler.threshold);
+    glUniform1f(glGetUniformLocation(sampler.maskProgram, "uMinFrames"), sampler.minFrames);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    // Reduce to one texel per tile
+    glBindFramebuffer(GL_FRAMEBUFFER, sampler.tileMask.fbo);
+    glViewport(0, 0, sampler.tileMask.width, sampler.tileMask.height);
+    glUseProgram(sampler.tileProgram);
+    glBindTexture(GL_TEXTURE_2D, sampler.pixelMask.textures[0]);
+    glUniform1i(glGetUniformLocation(sampler.tileProgram, "uPixelMask"), 0);
+    glUniform1i(glGetUniformLocation(sampler.tileProgram, "uTileSize"), kAdaptiveTileSize);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    // Queue the tile mask for readback unless the slot is still in flight
+    int slot = sampler.nextReadback;
+    if (!sampler.readbackFences[slot]) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, sampler.readbackBuffers[slot]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, sampler.tilesX, sampler.tilesY, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        sampler.readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        sampler.readbackGeneration[slot] = sampler.generation;
+        sampler.nextReadback = 1 - slot;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void collectActiveTiles(AdaptiveSampler& sampler) {
+    // The older of the two slots finishes first
+    int slot = sampler.nextReadback;
+    for (int attempt = 0; attempt < 2; attempt++, slot = 1 - slot) {
+        GLsync fence = sampler.readbackFences[slot];
+        if (!fence) {
+            continue;
+        }
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        glDeleteSync(fence);
+        sampler.readbackFences[slot] = 0;
+        if (sampler.readbackGeneration[slot] != sampler.generation) {
+            continue;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, sampler.readbackBuffers[slot]);
+        const unsigned char* mask = static_cast<const unsigned char*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sampler.tilesX * sampler.tilesY, GL_MAP_READ_BIT));
+        if (mask) {
+            std::vector<uint32_t> tiles;
+            for (int y = 0; y < sampler.tilesY; y++) {
+                for (int x = 0; x < sampler.tilesX; x++) {
+                    if (mask[y * sampler.tilesX + x] != 0) {
+                        tiles.push_back(packTile(x, y));
+                    }
+                }
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            uploadTileList(sampler.activeTiles, tiles);
+            sampler.activeTilesValid = true;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+float adaptiveActiveFraction(const AdaptiveSampler& sampler) {
+    if (!sampler.activeTilesValid || sampler.tilesX * sampler.tilesY == 0) {
+        return 1.0f;
+    }
+    return static_cast<float>(sampler.activeTiles.count) / (sampler.tilesX * sampler.tilesY);
+}
+
+void destroyAdaptiveSampler(AdaptiveSampler& sampler) {
+    dropFences(sampler);
+    destroyRenderTarget(sampler.pixelMask);
+    destroyRenderTarget(sampler.tileMask);
+    destroyTileList(sampler.activeTiles);
+    glDeleteBuffers(2, sampler.readbackBuffers);
+    glDeleteProgram(sampler.maskProgram);
+    glDeleteProgram(sampler.tileProgram);
+    sampler = AdaptiveSampler();
+}
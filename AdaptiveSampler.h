@@ -0,0 +1,58 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+#include "RenderTarget.h"
+#include "TileList.h"
+
+// Edge length in pixels of the tiles the active list is built from.
+const int kAdaptiveTileSize = 8;
+
+// Texture unit of the per-pixel active mask in the trace program.
+const int kAdaptiveMaskTextureUnit = 6;
+
+// Adaptive sampling for progressive accumulation: pixels whose accumulated
+// mean has a relative standard error below 'threshold' stop receiving
+// samples. A per-pixel mask (discarded in the trace shader) is reduced to a
+// per-tile mask that is read back asynchronously and compacted into a list
+// of active tiles, so converged tiles are never even rasterized.
+struct AdaptiveSampler {
+    float threshold = 0.01f;
+    float minFrames = 8.0f;
+
+    RenderTarget pixelMask;  // R8, render resolution
+    RenderTarget tileMask;   // R8, one texel per tile
+    GLuint maskProgram = 0;
+    GLuint tileProgram = 0;
+
+    // Double-buffered asynchronous readback of the tile mask
+    GLuint readbackBuffers[2] = {};
+    GLsync readbackFences[2] = {};
+    int readbackGeneration[2] = {};
+    int nextReadback = 0;
+
+    TileList activeTiles;
+    bool activeTilesValid = false;  // false until a readback of the current generation arrived
+    int generation = 0;             // bumped by resets; stale readbacks are ignored
+    int tilesX = 0;
+    int tilesY = 0;
+};
+
+void createAdaptiveSampler(AdaptiveSampler& sampler, int width, int height);
+void resizeAdaptiveSampler(AdaptiveSampler& sampler, int width, int height);
+
+// Invalidates the active list, e.g. when the camera moves or the history is reset.
+void resetAdaptiveSampler(AdaptiveSampler& sampler);
+
+// Rebuilds the masks from the accumulated moments and queues the tile mask for readback.
+// Expects the full-screen quad VAO to be bound.
+void updateAdaptiveMasks(AdaptiveSampler& sampler, GLuint historyMoments);
+
+// Picks up a finished readback without waiting and compacts it into activeTiles.
+void collectActiveTiles(AdaptiveSampler& sampler);
+
+// Fraction of tiles that still receive samples (1 while no list is available).
+float adaptiveActiveFraction(const AdaptiveSampler& sampler);
+
+void destroyAdaptiveSampler(AdaptiveSampler& sampler);
+
+#endif  // ADAPTIVE_SAMPLER_H
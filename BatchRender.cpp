@@ -0,0 +1,500 @@
+#include "BatchRender.h"
+#include "Camera.h"
+#include "Exr.h"
+#include "PreviewLod.h"
+#include "RenderTarget.h"
+#include "Shader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+namespace {
+
+// Checkpoint file layout: magic, then width, height and accumulated passes
+// as 32-bit integers, then the RGBA32F accumulation buffer.
+const char kCheckpointMagic[8] = { 'O', 'G', 'L', 'R', 'T', 'C', 'K', '1' };
+
+// Seed offset between passes: the shader derives its noise from uTime.
+const float kBatchPassSeedStep = 0.618034f;
+
+// Steps of the R2 low-discrepancy sequence (Roberts 2018) that spreads the
+// primary rays of successive passes over the pixel.
+const double kPixelJitterStep[2] = { 0.7548776662466927, 0.5698402909980532 };
+
+bool parseSwitch(const std::string& value, bool& result) {
+    if (value == "on") {
+        result = true;
+        return true;
+    }
+    if (value == "off") {
+        result = false;
+        return true;
+    }
+    return false;
+}
+
+// Restores the accumulation texture from a checkpoint. Returns the number of
+// passes it holds, or 0 if there is no usable checkpoint.
+int loadCheckpoint(const std::string& path, GLuint texture, int width, int height) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+    char magic[8];
+    int32_t header[3];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || std::memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0 ||
+        header[0] != width || header[1] != height || header[2] <= 0) {
+        std::cerr << "Ignoring checkpoint " << path << " that does not match the job\n";
+        return 0;
+    }
+    std::vector<float> pixels(static_cast<size_t>(width) * height * 4);
+    file.read(reinterpret_cast<char*>(pixels.data()), pixels.size() * sizeof(float));
+    if (!file) {
+        std::cerr << "Ignoring truncated checkpoint " << path << "\n";
+        return 0;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return header[2];
+}
+
+// Writes the checkpoint beside the final path and renames it into place, so a
+// job killed mid-write keeps the previous checkpoint.
+bool saveCheckpoint(const std::string& path, const std::vector<float>& pixels, int width, int height, int passes) {
+    std::string partial = path + ".partial";
+    {
+        std::ofstream file(partial, std::ios::binary);
+        int32_t header[3] = { width, height, passes };
+        file.write(kCheckpointMagic, sizeof(kCheckpointMagic));
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size() * sizeof(float));
+        if (!file) {
+            std::cerr << "Failed to write checkpoint " << partial << "\n";
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    return std::rename(partial.c_str(), path.c_str()) == 0;
+}
+
+void readAccumulation(GLuint texture, int width, int height, std::vector<float>& pixels) {
+    pixels.resize(static_cast<size_t>(width) * height * 4);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool fileExists(const std::string& path) {
+    return static_cast<bool>(std::ifstream(path));
+}
+
+bool parseCompression(const std::string& value, ExrCompression& result) {
+    const char* names[] = { "none", "rle", "zips", "zip" };
+    const ExrCompression methods[] = { kExrNoCompression, kExrRle, kExrZips, kExrZip };
+    for (int i = 0; i < 4; i++) {
+        if (value == names[i]) {
+            result = methods[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads a color texture as RGBA floats, top row first as EXR stores it.
+void readTopDown(GLuint texture, int width, int height, std::vector<float>& pixels) {
+    std::vector<float> bottomUp;
+    readAccumulation(texture, width, height, bottomUp);
+    size_t row = static_cast<size_t>(width) * 4;
+    pixels.resize(bottomUp.size());
+    for (int y = 0; y < height; y++) {
+        std::copy(&bottomUp[(height - 1 - y) * row], &bottomUp[(height - 1 - y) * row] + row, &pixels[y * row]);
+    }
+}
+
+// A finished frame handed to the writer thread; owns the pixels the EXR
+// channels point into.
+struct BatchOutput {
+    int frame = 0;
+    std::string path;
+    std::string checkpointPath;
+    std::chrono::steady_clock::time_point start;
+    std::vector<float> beauty;    // radiance (rgb), 1 (a)
+    std::vector<float> geometry;  // primary hit normal (xyz), distance (w)
+    std::vector<float> albedo;    // primary hit base color (rgb)
+    ExrImage image;
+};
+
+struct PendingWrite {
+    std::shared_ptr<BatchOutput> output;
+    std::future<bool> written;
+};
+
+// Waits for the frame being written, if any. Returns false if its write failed.
+bool finishWrite(PendingWrite& pending, int frameCount) {
+    if (!pending.written.valid()) {
+        return true;
+    }
+    bool written = pending.written.get();
+    const BatchOutput& output = *pending.output;
+    if (written) {
+        std::remove(output.checkpointPath.c_str());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - output.start).count();
+        std::cout << "Frame " << output.frame + 1 << "/" << frameCount << ": " << output.path << " written in "
+                  << seconds << " s\n";
+    }
+    pending.output.reset();
+    return written;
+}
+
+}  // namespace
+
+void batchCameraAt(const BatchJob& job, float time, float position[3], float& yaw, float& pitch) {
+    const std::vector<BatchKeyframe>& keys = job.keyframes;
+    size_t next = 0;
+    while (next < keys.size() && keys[next].time <= time) {
+        next++;
+    }
+    const BatchKeyframe& a = keys[next == 0 ? 0 : next - 1];
+    const BatchKeyframe& b = keys[next == keys.size() ? keys.size() - 1 : next];
+    float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.0f;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    for (int i = 0; i < 3; i++) {
+        position[i] = a.position[i] + (b.position[i] - a.position[i]) * t;
+    }
+    const float toRadians = 3.14159265f / 180.0f;
+    yaw = (a.yaw + (b.yaw - a.yaw) * t) * toRadians;
+    pitch = (a.pitch + (b.pitch - a.pitch) * t) * toRadians;
+}
+
+void setBatchSceneTime(BatchResources& resources, float time) {
+    Scene& scene = *resources.scene;
+    SceneBuffers& sceneBuffers = *resources.sceneBuffers;
+    if (resources.specializeScene) {
+        return;
+    }
+    if (updateSceneMeshes(sceneBuffers, scene, time, resources.gpuBvh == nullptr) && resources.gpuBvh) {
+        for (int m = 0; m < static_cast<int>(scene.meshes.size()); m++) {
+            if (scene.meshes[m].twistAmount != 0.0f) {
+                buildGpuBvh(*resources.gpuBvh, sceneBuffers, scene, m);
+            }
+        }
+    }
+    if (!scene.instances.empty()) {
+        updateSceneInstances(sceneBuffers, scene);
+    }
+}
+
+void drawBatchPass(BatchResources& resources, const CameraState& camera, float time, int pass,
+                   const BatchPassSettings& settings) {
+    GLuint program = resources.traceProgram;
+    glUseProgram(program);
+    setCameraUniforms(program, "uCam", camera);
+    glUniform1f(glGetUniformLocation(program, "uTime"), time + pass * kBatchPassSeedStep);
+    // Pass 0 traces the pixel centers; offsets stay within half a pixel
+    float jitter[2];
+    for (int axis = 0; axis < 2; axis++) {
+        double position = 0.5 + pass * kPixelJitterStep[axis];
+        jitter[axis] = static_cast<float>(position - std::floor(position) - 0.5);
+    }
+    glUniform2f(glGetUniformLocation(program, "uPixelJitter"), jitter[0], jitter[1]);
+    glUniform1f(glGetUniformLocation(program, "uAspect"), settings.aspect);
+    glUniform1f(glGetUniformLocation(program, "uFov"), settings.fov);
+    glUniform1i(glGetUniformLocation(program, "uDenoise"), settings.denoise ? 1 : 0);
+    glUniform1i(glGetUniformLocation(program, "uGI"), settings.gi ? 1 : 0);
+    glUniform1i(glGetUniformLocation(program, "uSkybox"), settings.skybox && resources.skyboxTexture ? 1 : 0);
+    glUniform1i(glGetUniformLocation(program, "uMaxBounces"), kPreviewLevelBounces[kPreviewFull]);
+    glUniform1i(glGetUniformLocation(program, "uRasterPrimary"), 0);
+    glUniform1i(glGetUniformLocation(program, "uAdaptive"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, resources.skyboxTexture);
+    glUniform1i(glGetUniformLocation(program, "uSkyboxTex"), 0);
+    bindSceneBuffers(program, *resources.sceneBuffers, 1);
+    glBindVertexArray(resources.quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+bool loadBatchJob(const std::string& path, BatchJob& job) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open job file " << path << "\n";
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        // Comments start at a '#' that begins a word; output patterns use '#' too
+        for (size_t hash = line.find('#'); hash != std::string::npos; hash = line.find('#', hash + 1)) {
+            if (hash == 0 || line[hash - 1] == ' ' || line[hash - 1] == '\t') {
+                line.erase(hash);
+                break;
+            }
+        }
+        std::istringstream fields(line);
+        std::string key;
+        if (!(fields >> key)) {
+            continue;
+        }
+        bool valid = true;
+        std::string value;
+        if (key == "size") {
+            valid = static_cast<bool>(fields >> job.width >> job.height) && job.width > 0 && job.height > 0;
+        }
+        else if (key == "spp") {
+            valid = static_cast<bool>(fields >> job.spp) && job.spp > 0;
+        }
+        else if (key == "frames") {
+            valid = static_cast<bool>(fields >> job.frameCount) && job.frameCount > 0;
+        }
+        else if (key == "fps") {
+            valid = static_cast<bool>(fields >> job.fps) && job.fps > 0.0f;
+        }
+        else if (key == "fov") {
+            valid = static_cast<bool>(fields >> job.fovDegrees) && job.fovDegrees > 0.0f && job.fovDegrees < 180.0f;
+        }
+        else if (key == "output") {
+            valid = static_cast<bool>(fields >> job.outputPattern);
+        }
+        else if (key == "scene") {
+            valid = static_cast<bool>(fields >> job.scene);
+        }
+        else if (key == "gi") {
+            valid = (fields >> value) && parseSwitch(value, job.gi);
+        }
+        else if (key == "denoise") {
+            valid = (fields >> value) && parseSwitch(value, job.denoise);
+        }
+        else if (key == "skybox") {
+            valid = (fields >> value) && parseSwitch(value, job.skybox);
+        }
+        else if (key == "checkpoint") {
+            valid = static_cast<bool>(fields >> job.checkpointSeconds) && job.checkpointSeconds > 0.0f;
+        }
+        else if (key == "compression") {
+            valid = (fields >> value) && parseCompression(value, job.compression);
+        }
+        else if (key == "tiles") {
+            valid = static_cast<bool>(fields >> job.tileSize) && job.tileSize >= 0;
+        }
+        else if (key == "precision") {
+            valid = static_cast<bool>(fields >> value) && (value == "half" || value == "float");
+            job.precision = value == "float" ? kExrFloat : kExrHalf;
+        }
+        else if (key == "aovs") {
+            valid = (fields >> value) && parseSwitch(value, job.aovs);
+        }
+        else if (key == "camera") {
+            BatchKeyframe keyframe;
+            valid = static_cast<bool>(fields >> keyframe.time >> keyframe.position[0] >> keyframe.position[1] >>
+                                      keyframe.position[2] >> keyframe.yaw >> keyframe.pitch);
+            if (valid) {
+                job.keyframes.push_back(keyframe);
+            }
+        }
+        else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << path << ":" << lineNumber << ": invalid job line: " << line << "\n";
+            return false;
+        }
+    }
+
+    if (job.keyframes.empty()) {
+        std::cerr << path << ": the job needs at least one camera keyframe\n";
+        return false;
+    }
+    std::stable_sort(job.keyframes.begin(), job.keyframes.end(),
+                     [](const BatchKeyframe& a, const BatchKeyframe& b) { return a.time < b.time; });
+    if (job.frameCount > 1 && job.outputPattern.find('#') == std::string::npos) {
+        std::cerr << path << ": output of a multi-frame job needs '#' for the frame number\n";
+        return false;
+    }
+    return true;
+}
+
+std::string batchFramePath(const BatchJob& job, int frame) {
+    std::string path = job.outputPattern;
+    size_t first = path.find('#');
+    if (first == std::string::npos) {
+        return path;
+    }
+    size_t last = path.find_first_not_of('#', first);
+    size_t digits = (last == std::string::npos ? path.size() : last) - first;
+    std::string number = std::to_string(frame);
+    if (number.size() < digits) {
+        number.insert(0, digits - number.size(), '0');
+    }
+    return path.replace(first, digits, number);
+}
+
+bool runBatchJob(const BatchJob& job, BatchResources& resources) {
+    // Attachments follow the trace shader outputs; the AOVs come from the last pass
+    std::vector<GLenum> passFormats = { GL_RGBA32F };
+    if (job.aovs) {
+        passFormats.push_back(GL_RGBA32F);
+        passFormats.push_back(GL_RGBA16F);
+    }
+    RenderTarget passTarget = createRenderTarget(job.width, job.height, passFormats);
+    RenderTarget accumulation = createRenderTarget(job.width, job.height, { GL_RGBA32F });
+    GLuint accumulateProgram = createShaderProgram("vertex_shader.glsl", "accumulate_shader.glsl");
+    int passSamples = job.denoise ? kBatchDenoisePassSamples : 1;
+    int passCount = (job.spp + passSamples - 1) / passSamples;
+    float aspect = static_cast<float>(job.width) / job.height;
+    float fov = job.fovDegrees * 3.14159265f / 180.0f;
+    std::vector<float> pixels;
+    ExrWriteOptions exrOptions;
+    exrOptions.compression = job.compression;
+    exrOptions.tileSize = job.tileSize;
+    PendingWrite pending;
+    bool success = true;
+
+    std::cout << "Batch job: " << job.frameCount << " frames at " << job.width << "x" << job.height << ", "
+              << passCount * passSamples << " spp\n";
+    for (int frame = 0; frame < job.frameCount; frame++) {
+        std::string outputPath = batchFramePath(job, frame);
+        if (fileExists(outputPath)) {
+            std::cout << "Frame " << frame + 1 << "/" << job.frameCount << ": " << outputPath
+                      << " exists, skipped\n";
+            continue;
+        }
+        auto frameStart = std::chrono::steady_clock::now();
+        float time = frame / job.fps;
+
+        setBatchSceneTime(resources, time);
+
+        // Resume from the checkpoint of an interrupted run
+        std::string checkpointPath = outputPath + ".checkpoint";
+        int pass = loadCheckpoint(checkpointPath, accumulation.textures[0], job.width, job.height);
+        if (pass > 0) {
+            std::cout << "Frame " << frame + 1 << "/" << job.frameCount << ": resuming at "
+                      << pass * passSamples << " spp\n";
+        }
+        else {
+            const GLfloat zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            glBindFramebuffer(GL_FRAMEBUFFER, accumulation.fbo);
+            glClearBufferfv(GL_COLOR, 0, zeros);
+        }
+
+        float position[3];
+        float yaw, pitch;
+        batchCameraAt(job, time, position, yaw, pitch);
+        CameraState camera = makeCameraState(position, yaw, pitch);
+
+        glViewport(0, 0, job.width, job.height);
+        glBindVertexArray(resources.quadVAO);
+        auto lastCheckpoint = std::chrono::steady_clock::now();
+        GLsync previousPass = 0;
+        for (; pass < passCount; pass++) {
+            // Trace one pass
+            glBindFramebuffer(GL_FRAMEBUFFER, passTarget.fbo);
+            BatchPassSettings settings;
+            settings.aspect = aspect;
+            settings.fov = fov;
+            settings.gi = job.gi;
+            settings.denoise = job.denoise;
+            settings.skybox = job.skybox;
+            drawBatchPass(resources, camera, time, pass, settings);
+
+            // Add it to the running sums
+            glBindFramebuffer(GL_FRAMEBUFFER, accumulation.fbo);
+            glUseProgram(accumulateProgram);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, passTarget.textures[0]);
+            glUniform1i(glGetUniformLocation(accumulateProgram, "uSource"), 0);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glDisable(GL_BLEND);
+
+            // Keep at most one pass queued ahead of the GPU so checkpoint timing
+            // follows the work actually done
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            if (previousPass) {
+                glClientWaitSync(previousPass, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(previousPass);
+            }
+            previousPass = fence;
+
+            double sinceCheckpoint = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastCheckpoint).count();
+            if (sinceCheckpoint >= job.checkpointSeconds && pass + 1 < passCount) {
+                readAccumulation(accumulation.textures[0], job.width, job.height, pixels);
+                if (saveCheckpoint(checkpointPath, pixels, job.width, job.height, pass + 1)) {
+                    std::cout << "  checkpoint at " << (pass + 1) * passSamples << "/" << passCount * passSamples
+                              << " spp\n";
+                }
+                lastCheckpoint = std::chrono::steady_clock::now();
+            }
+        }
+        if (previousPass) {
+            glDeleteSync(previousPass);
+        }
+        glBindVertexArray(0);
+
+        // Resolve the sums to linear radiance
+        std::shared_ptr<BatchOutput> output = std::make_shared<BatchOutput>();
+        output->frame = frame;
+        output->path = outputPath;
+        output->checkpointPath = checkpointPath;
+        output->start = frameStart;
+        readTopDown(accumulation.textures[0], job.width, job.height, output->beauty);
+        for (size_t i = 0; i < output->beauty.size(); i += 4) {
+            float count = output->beauty[i + 3];
+            float scale = count > 0.0f ? 1.0f / count : 0.0f;
+            for (int c = 0; c < 3; c++) {
+                output->beauty[i + c] *= scale;
+            }
+            output->beauty[i + 3] = 1.0f;
+        }
+
+        ExrImage& image = output->image;
+        image.width = job.width;
+        image.height = job.height;
+        const char* beautyNames[] = { "R", "G", "B", "A" };
+        for (int c = 0; c < 4; c++) {
+            image.channels.push_back({ beautyNames[c], job.precision, &output->beauty[c], 4 });
+        }
+        if (job.aovs) {
+            readTopDown(passTarget.textures[1], job.width, job.height, output->geometry);
+            readTopDown(passTarget.textures[2], job.width, job.height, output->albedo);
+            const char* albedoNames[] = { "albedo.R", "albedo.G", "albedo.B" };
+            const char* normalNames[] = { "normal.X", "normal.Y", "normal.Z" };
+            for (int c = 0; c < 3; c++) {
+                image.channels.push_back({ albedoNames[c], job.precision, &output->albedo[c], 4 });
+                image.channels.push_back({ normalNames[c], job.precision, &output->geometry[c], 4 });
+            }
+            // Hit distances exceed the half range, so depth is always float
+            image.channels.push_back({ "Z", kExrFloat, &output->geometry[3], 4 });
+        }
+
+        // Encode on another thread while the next frame renders; one frame at a time
+        if (!finishWrite(pending, job.frameCount)) {
+            success = false;
+        }
+        pending.output = output;
+        pending.written = std::async(std::launch::async, [output, exrOptions]() {
+            return writeExr(output->path, output->image, exrOptions);
+        });
+    }
+    if (!finishWrite(pending, job.frameCount)) {
+        success = false;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteProgram(accumulateProgram);
+    destroyRenderTarget(passTarget);
+    destroyRenderTarget(accumulation);
+    return success;
+}
@@ -0,0 +1,113 @@
+#ifndef BATCH_RENDER_H
+#define BATCH_RENDER_H
+
+#include "Camera.h"
+#include "Exr.h"
+#include "GpuBvh.h"
+#include "Scene.h"
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+// Samples per pixel of a pass with uDenoise set (see fragment_shader.glsl).
+const int kBatchDenoisePassSamples = 80;
+
+// Camera pose at a point of the sequence; angles in degrees.
+struct BatchKeyframe {
+    float time;
+    float position[3];
+    float yaw;
+    float pitch;
+};
+
+// Offline render of a camera sequence, read from a job file. Each line holds
+// a keyword and its values; a word starting with '#' begins a comment:
+//
+//   size 1920 1080          output resolution
+//   spp 1024                samples per pixel of every frame
+//   frames 48               frame count (default 1)
+//   fps 24                  frame rate the keyframe times are sampled at
+//   fov 45                  vertical field of view in degrees
+//   output shot_####.exr    '#'s are replaced by the zero-padded frame number
+//   scene instances         scene name as for --scene
+//   gi on                   global illumination, on or off (default on)
+//   denoise off             80-sample passes instead of single samples (default off)
+//   skybox on               HDR skybox lighting (default on)
+//   checkpoint 60           seconds between accumulation checkpoints
+//   compression zip         EXR compression: none, rle, zips or zip (default zip)
+//   tiles 64                tiled EXR with this tile size, 0 for scanlines (default 0)
+//   precision half          beauty and AOV channels in half or float (default half)
+//   aovs on                 also write albedo, normal and depth channels (default off)
+//   camera 0.0  0 1 -3  0 0 keyframe: time, position x y z, yaw, pitch
+//
+// The camera is interpolated linearly between keyframes and held before the
+// first and after the last.
+struct BatchJob {
+    int width = 1280;
+    int height = 720;
+    int spp = 256;
+    int frameCount = 1;
+    float fps = 24.0f;
+    float fovDegrees = 45.0f;
+    std::string outputPattern = "frame_####.exr";
+    std::string scene;  // empty keeps the --scene choice
+    bool gi = true;
+    bool denoise = false;
+    bool skybox = true;
+    float checkpointSeconds = 60.0f;
+    ExrCompression compression = kExrZip;
+    int tileSize = 0;
+    ExrPixelType precision = kExrHalf;
+    bool aovs = false;
+    std::vector<BatchKeyframe> keyframes;
+};
+
+// GPU resources owned by the application that the batch renderer traces with.
+struct BatchResources {
+    GLuint traceProgram = 0;  // trace shader, drawn over the full-screen quad
+    GLuint quadVAO = 0;
+    GLuint skyboxTexture = 0;
+    Scene* scene = nullptr;
+    SceneBuffers* sceneBuffers = nullptr;
+    bool specializeScene = false;      // scene baked into the shader, nothing to update
+    GpuBvhBuilder* gpuBvh = nullptr;   // rebuilds animated mesh BVHs when set, else refit on the host
+};
+
+// Shading switches and projection of one trace pass.
+struct BatchPassSettings {
+    float aspect = 1.0f;
+    float fov = 0.785398f;  // vertical, in radians
+    bool gi = true;
+    bool denoise = false;
+    bool skybox = true;
+};
+
+// Camera of the job at a time in seconds; yaw and pitch in radians.
+void batchCameraAt(const BatchJob& job, float time, float position[3], float& yaw, float& pitch);
+
+// Moves animated meshes and instances to the given time.
+void setBatchSceneTime(BatchResources& resources, float time);
+
+// Traces pass 'pass' of an image at a scene time over the current framebuffer
+// viewport: radiance and sample count to attachment 0, primary-hit AOVs to
+// attachments 1 and 2 if present. Every pass draws different noise and sends
+// the primary rays through a different point of each pixel, so the passes of
+// an image anti-alias it as they accumulate.
+void drawBatchPass(BatchResources& resources, const CameraState& camera, float time, int pass,
+                   const BatchPassSettings& settings);
+
+// Parses a job file. Prints the offending line and returns false on errors.
+bool loadBatchJob(const std::string& path, BatchJob& job);
+
+// Output file of one frame of the job.
+std::string batchFramePath(const BatchJob& job, int frame);
+
+// Renders every frame of the job that has no output file yet, accumulating
+// spp samples per pixel and writing each frame as an EXR. A frame is encoded
+// and written on a background thread while the next one renders. The
+// accumulation buffer of the frame in progress is saved next to its output
+// every checkpointSeconds, and a restarted job resumes from that checkpoint.
+// Returns false if any frame failed.
+bool runBatchJob(const BatchJob& job, BatchResources& resources);
+
+#endif  // BATCH_RENDER_H
@@ -0,0 +1,491 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+const int kSahBins = 16;
+
+struct BuildContext {
+    const std::vector<Aabb>& primBounds;
+    std::vector<float> centroids;  // xyz per primitive
+    Bvh& bvh;
+    int maxLeafSize;
+};
+
+float centroidOf(const Aabb& box, int axis) {
+    return 0.5f * (box.min[axis] + box.max[axis]);
+}
+
+// Finds the cheapest binned SAH split of node's primitives. Returns false if
+// no split beats keeping the node as a leaf.
+bool findSplit(const BuildContext& ctx, const BvhNode& node, int& bestAxis, float& bestPos) {
+    float bestCost = FLT_MAX;
+
+    // Split bins over the centroid bounds, not the node bounds
+    Aabb centroidBounds = emptyAabb();
+    for (int i = node.first; i < node.first + node.count; i++) {
+        growAabb(centroidBounds, &ctx.centroids[ctx.bvh.primIndices[i] * 3]);
+    }
+
+    // Small nodes get fewer bins; with one bin per primitive the split
+    // quality is the same, and the per-bin sweeps dominate deep in the tree
+    const int binCount = std::min(kSahBins, std::max(4, node.count));
+
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = centroidBounds.min[axis];
+        float hi = centroidBounds.max[axis];
+        if (hi - lo <= 0.0f) {
+            continue;
+        }
+        Aabb binBounds[kSahBins];
+        int binCounts[kSahBins] = {};
+        for (int b = 0; b < binCount; b++) {
+            binBounds[b] = emptyAabb();
+        }
+        float scale = binCount / (hi - lo);
+        for (int i = node.first; i < node.first + node.count; i++) {
+            int prim = ctx.bvh.primIndices[i];
+            int b = std::min(binCount - 1, static_cast<int>((ctx.centroids[prim * 3 + axis] - lo) * scale));
+            binCounts[b]++;
+            growAabb(binBounds[b], ctx.primBounds[prim]);
+        }
+
+        // Sweep from both sides to get the cost of every bin boundary
+        float leftArea[kSahBins - 1];
+        int leftCount[kSahBins - 1];
+        Aabb box = emptyAabb();
+        int count = 0;
+        for (int b = 0; b < binCount - 1; b++) {
+            count += binCounts[b];
+            if (binCounts[b]) growAabb(box, binBounds[b]);
+            leftCount[b] = count;
+            leftArea[b] = count ? aabbSurfaceArea(box) : 0.0f;
+        }
+        box = emptyAabb();
+        count = 0;
+        for (int b = binCount - 1; b > 0; b--) {
+            count += binCounts[b];
+            if (binCounts[b]) growAabb(box, binBounds[b]);
+            float cost = leftCount[b - 1] * leftArea[b - 1] + count * (count ? aabbSurfaceArea(box) : 0.0f);
+            if (leftCount[b - 1] > 0 && count > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestPos = lo + b / scale;
+            }
+        }
+    }
+
+    if (node.count > ctx.maxLeafSize) {
+        // Oversized leaves are split whenever any split exists
+        return bestCost < FLT_MAX;
+    }
+    // A split pays one extra node visit; with equal traversal and
+    // intersection costs it has to save at least one primitive test
+    float nodeArea = aabbSurfaceArea(node.bounds);
+    return bestCost + nodeArea < node.count * nodeArea;
+}
+
+void subdivide(BuildContext& ctx, int nodeIndex, int depth) {
+    BvhNode node = ctx.bvh.nodes[nodeIndex];
+    if (node.count <= 1 || depth + 1 >= kMaxBvhDepth) {
+        return;
+    }
+    // Two primitives that must not share a leaf have only one possible split
+    int leftCount = 1;
+    if (node.count > 2 || ctx.maxLeafSize >= 2) {
+        int axis = 0;
+        float splitPos = 0.0f;
+        if (!findSplit(ctx, node, axis, splitPos)) {
+            return;
+        }
+
+        // Partition the index range around the split plane
+        int* begin = ctx.bvh.primIndices.data() + node.first;
+        int* end = begin + node.count;
+        int* middle = std::partition(begin, end, [&](int prim) {
+            return ctx.centroids[prim * 3 + axis] < splitPos;
+        });
+        leftCount = static_cast<int>(middle - begin);
+        if (leftCount == 0 || leftCount == node.count) {
+            return;
+        }
+    }
+
+    int leftIndex = static_cast<int>(ctx.bvh.nodes.size());
+    BvhNode left = { emptyAabb(), node.first, leftCount };
+    BvhNode right = { emptyAabb(), node.first + leftCount, node.count - leftCount };
+    for (int i = left.first; i < left.first + left.count; i++) {
+        growAabb(left.bounds, ctx.primBounds[ctx.bvh.primIndices[i]]);
+    }
+    for (int i = right.first; i < right.first + right.count; i++) {
+        growAabb(right.bounds, ctx.primBounds[ctx.bvh.primIndices[i]]);
+    }
+    ctx.bvh.nodes.push_back(left);
+    ctx.bvh.nodes.push_back(right);
+
+    ctx.bvh.nodes[nodeIndex].first = leftIndex;
+    ctx.bvh.nodes[nodeIndex].count = 0;
+    subdivide(ctx, leftIndex, depth + 1);
+    subdivide(ctx, leftIndex + 1, depth + 1);
+}
+
+// Refits the subtree rooted at nodeIndex and returns the number of changed nodes.
+int refitSubtree(Bvh& bvh, const std::vector<Aabb>& primBounds, int nodeIndex,
+                 std::vector<unsigned char>& changedNodes) {
+    BvhNode& node = bvh.nodes[nodeIndex];
+    int changed = 0;
+    Aabb bounds = emptyAabb();
+    if (node.count > 0) {
+        for (int i = node.first; i < node.first + node.count; i++) {
+            growAabb(bounds, primBounds[bvh.primIndices[i]]);
+        }
+    } else {
+        changed += refitSubtree(bvh, primBounds, node.first, changedNodes);
+        changed += refitSubtree(bvh, primBounds, node.first + 1, changedNodes);
+        bounds = bvh.nodes[node.first].bounds;
+        growAabb(bounds, bvh.nodes[node.first + 1].bounds);
+    }
+    if (std::memcmp(&bounds, &node.bounds, sizeof(Aabb)) != 0) {
+        node.bounds = bounds;
+        changedNodes[nodeIndex] = 1;
+        changed++;
+    }
+    return changed;
+}
+
+// Splits leaves over maxLeafSize primitives (whose centroids coincide, so
+// SAH found no split) in half by index until they fit.
+void splitOversizedLeaves(Bvh& bvh, const std::vector<Aabb>& primBounds, int maxLeafSize) {
+    for (size_t i = 0; i < bvh.nodes.size(); i++) {
+        BvhNode node = bvh.nodes[i];
+        if (node.count <= maxLeafSize) {
+            continue;
+        }
+        int leftCount = node.count / 2;
+        BvhNode left = { emptyAabb(), node.first, leftCount };
+        BvhNode right = { emptyAabb(), node.first + leftCount, node.count - leftCount };
+        for (int p = left.first; p < left.first + left.count; p++) {
+            growAabb(left.bounds, primBounds[bvh.primIndices[p]]);
+        }
+        for (int p = right.first; p < right.first + right.count; p++) {
+            growAabb(right.bounds, primBounds[bvh.primIndices[p]]);
+        }
+        bvh.nodes[i].first = static_cast<int>(bvh.nodes.size());
+        bvh.nodes[i].count = 0;
+        bvh.nodes.push_back(left);
+        bvh.nodes.push_back(right);
+    }
+}
+
+// Primitive range [first, first + count) under every node of a binary tree.
+// Children always come after their parent, so one backwards pass suffices.
+void subtreeRanges(const Bvh& bvh, std::vector<int>& first, std::vector<int>& count) {
+    first.resize(bvh.nodes.size());
+    count.resize(bvh.nodes.size());
+    for (size_t i = bvh.nodes.size(); i-- > 0;) {
+        const BvhNode& node = bvh.nodes[i];
+        if (node.count > 0) {
+            first[i] = node.first;
+            count[i] = node.count;
+        } else {
+            first[i] = first[node.first];
+            count[i] = count[node.first] + count[node.first + 1];
+        }
+    }
+}
+
+// Children of a binary node once collapsed: opens the largest child until
+// kWideBvhArity children are reached. Subtrees small enough for one wide
+// leaf are never opened.
+std::vector<int> collapseChildren(const Bvh& bvh, const std::vector<int>& subtreeCount, int nodeIndex) {
+    if (subtreeCount[nodeIndex] <= kWideLeafSize) {
+        return { nodeIndex };
+    }
+    const BvhNode& node = bvh.nodes[nodeIndex];
+    std::vector<int> children = { node.first, node.first + 1 };
+    while (static_cast<int>(children.size()) < kWideBvhArity) {
+        int best = -1;
+        float bestArea = -1.0f;
+        for (size_t c = 0; c < children.size(); c++) {
+            float area = aabbSurfaceArea(bvh.nodes[children[c]].bounds);
+            if (subtreeCount[children[c]] > kWideLeafSize && area > bestArea) {
+                best = static_cast<int>(c);
+                bestArea = area;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        int opened = bvh.nodes[children[best]].first;
+        children[best] = opened;
+        children.push_back(opened + 1);
+    }
+    return children;
+}
+
+// Places children in the slots of the octants they lie in around the
+// parent's center; slot bit a set means the high side of axis a. Pairs are
+// assigned greedily, cheapest first.
+void assignSlots(const Bvh& bvh, const Aabb& parent, const std::vector<int>& children,
+                 int slots[kWideBvhArity]) {
+    float cost[kWideBvhArity][kWideBvhArity];
+    for (size_t c = 0; c < children.size(); c++) {
+        const Aabb& box = bvh.nodes[children[c]].bounds;
+        for (int s = 0; s < kWideBvhArity; s++) {
+            cost[c][s] = 0.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                float offset = centroidOf(box, axis) - centroidOf(parent, axis);
+                cost[c][s] += (s >> axis & 1) ? -offset : offset;
+            }
+        }
+    }
+    bool placed[kWideBvhArity] = {};
+    for (int s = 0; s < kWideBvhArity; s++) {
+        slots[s] = -1;
+    }
+    for (size_t n = 0; n < children.size(); n++) {
+        int bestChild = -1;
+        int bestSlot = -1;
+        for (size_t c = 0; c < children.size(); c++) {
+            for (int s = 0; s < kWideBvhArity; s++) {
+                if (!placed[c] && slots[s] < 0 &&
+                    (bestChild < 0 || cost[c][s] < cost[bestChild][bestSlot])) {
+                    bestChild = static_cast<int>(c);
+                    bestSlot = s;
+                }
+            }
+        }
+        placed[bestChild] = true;
+        slots[bestSlot] = bestChild;
+    }
+}
+
+// Smallest power-of-two step, as a biased exponent, with which 255 steps
+// from lo reach hi.
+unsigned char quantizationExponent(float lo, float hi) {
+    int exponent = -126;
+    if (hi > lo) {
+        exponent = std::max(-126, static_cast<int>(std::ceil(std::log2((hi - lo) / 255.0f))));
+        while (exponent < 127 && lo + std::ldexp(255.0f, exponent) < hi) {
+            exponent++;
+        }
+    }
+    return static_cast<unsigned char>(exponent + 127);
+}
+
+}  // namespace
+
+Aabb emptyAabb() {
+    return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+void growAabb(Aabb& box, const float point[3]) {
+    for (int i = 0; i < 3; i++) {
+        box.min[i] = std::min(box.min[i], point[i]);
+        box.max[i] = std::max(box.max[i], point[i]);
+    }
+}
+
+void growAabb(Aabb& box, const Aabb& other) {
+    for (int i = 0; i < 3; i++) {
+        box.min[i] = std::min(box.min[i], other.min[i]);
+        box.max[i] = std::max(box.max[i], other.max[i]);
+    }
+}
+
+float aabbSurfaceArea(const Aabb& box) {
+    float dx = box.max[0] - box.min[0];
+    float dy = box.max[1] - box.min[1];
+    float dz = box.max[2] - box.min[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+Bvh buildBvh(const std::vector<Aabb>& primBounds, int maxLeafSize) {
+    Bvh bvh;
+    int count = static_cast<int>(primBounds.size());
+    bvh.primIndices.resize(count);
+    for (int i = 0; i < count; i++) {
+        bvh.primIndices[i] = i;
+    }
+
+    BvhNode root = { emptyAabb(), 0, count };
+    for (const Aabb& box : primBounds) {
+        growAabb(root.bounds, box);
+    }
+    bvh.nodes.reserve(count > 0 ? 2 * count - 1 : 1);
+    bvh.nodes.push_back(root);
+
+    BuildContext ctx = { primBounds, std::vector<float>(count * 3), bvh, std::max(maxLeafSize, 1) };
+    for (int i = 0; i < count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            ctx.centroids[i * 3 + axis] = centroidOf(primBounds[i], axis);
+        }
+    }
+    subdivide(ctx, 0, 0);
+    return bvh;
+}
+
+int refitBvh(Bvh& bvh, const std::vector<Aabb>& primBounds, int threadCount,
+             std::vector<unsigned char>& changedNodes) {
+    changedNodes.assign(bvh.nodes.size(), 0);
+    if (bvh.nodes.empty()) {
+        return 0;
+    }
+
+    // Small trees are not worth a thread
+    const size_t minNodesPerThread = 2048;
+    threadCount = std::max(1, std::min(threadCount, static_cast<int>(bvh.nodes.size() / minNodesPerThread)));
+    if (threadCount == 1) {
+        return refitSubtree(bvh, primBounds, 0, changedNodes);
+    }
+
+    // Split the top of the tree breadth-first until there are a few subtrees
+    // per thread; every node on 'top' has its children either on 'top' or
+    // among the independent subtree roots.
+    std::vector<int> top;
+    std::vector<int> roots = { 0 };
+    while (static_cast<int>(roots.size()) < threadCount * 4) {
+        std::vector<int> next;
+        for (int index : roots) {
+            const BvhNode& node = bvh.nodes[index];
+            if (node.count > 0) {
+                next.push_back(index);
+            } else {
+                top.push_back(index);
+                next.push_back(node.first);
+                next.push_back(node.first + 1);
+            }
+        }
+        if (next.size() == roots.size()) {
+            break;
+        }
+        roots.swap(next);
+    }
+
+    // Subtrees never share nodes, so each thread writes disjoint bounds and flags
+    std::vector<int> changed(threadCount, 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.emplace_back([&, t]() {
+            for (size_t i = t; i < roots.size(); i += threadCount) {
+                changed[t] += refitSubtree(bvh, primBounds, roots[i], changedNodes);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // 'top' is in breadth-first order, so walking it backwards finishes
+    // both children of a node before the node itself
+    int total = 0;
+    for (int count : changed) {
+        total += count;
+    }
+    for (auto it = top.rbegin(); it != top.rend(); ++it) {
+        BvhNode& node = bvh.nodes[*it];
+        Aabb bounds = bvh.nodes[node.first].bounds;
+        growAabb(bounds, bvh.nodes[node.first + 1].bounds);
+        if (std::memcmp(&bounds, &node.bounds, sizeof(Aabb)) != 0) {
+            node.bounds = bounds;
+            changedNodes[*it] = 1;
+            total++;
+        }
+    }
+    return total;
+}
+
+float bvhSahCost(const Bvh& bvh) {
+    if (bvh.nodes.empty()) {
+        return 0.0f;
+    }
+    float rootArea = aabbSurfaceArea(bvh.nodes[0].bounds);
+    if (rootArea <= 0.0f) {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (const BvhNode& node : bvh.nodes) {
+        float area = aabbSurfaceArea(node.bounds) / rootArea;
+        cost += area * (node.count > 0 ? static_cast<float>(node.count) : 1.0f);
+    }
+    return cost;
+}
+
+WideBvh collapseBvh(const Bvh& bvh, const std::vector<Aabb>& primBounds) {
+    WideBvh wide;
+    if (bvh.nodes.empty()) {
+        return wide;
+    }
+    Bvh binary = bvh;
+    splitOversizedLeaves(binary, primBounds, kWideLeafSize);
+    std::vector<int> subtreeFirst;
+    std::vector<int> subtreeCount;
+    subtreeRanges(binary, subtreeFirst, subtreeCount);
+
+    // Every wide node gets its inner children as one contiguous block, so
+    // pending nodes are filled in after their whole block is allocated
+    std::vector<std::pair<int, int>> pending = { { 0, 0 } };  // wide node, binary node
+    wide.nodes.push_back(WideBvhNode());
+    while (!pending.empty()) {
+        int wideIndex = pending.back().first;
+        int binaryIndex = pending.back().second;
+        pending.pop_back();
+
+        const Aabb& bounds = binary.nodes[binaryIndex].bounds;
+        std::vector<int> children = collapseChildren(binary, subtreeCount, binaryIndex);
+        int slots[kWideBvhArity];
+        assignSlots(binary, bounds, children, slots);
+
+        WideBvhNode node = {};
+        std::fill(node.meta, node.meta + kWideBvhArity, 0xff);
+        node.childBase = static_cast<int>(wide.nodes.size());
+        node.primBase = static_cast<int>(wide.primIndices.size());
+        float step[3];
+        for (int axis = 0; axis < 3; axis++) {
+            node.origin[axis] = bounds.min[axis];
+            node.exponent[axis] = quantizationExponent(bounds.min[axis], bounds.max[axis]);
+            step[axis] = std::ldexp(1.0f, node.exponent[axis] - 127);
+        }
+        int innerCount = 0;
+        for (int s = 0; s < kWideBvhArity; s++) {
+            if (slots[s] < 0) {
+                continue;
+            }
+            int childIndex = children[slots[s]];
+            const BvhNode& child = binary.nodes[childIndex];
+            for (int axis = 0; axis < 3; axis++) {
+                // Round outwards, then make sure float rounding of the decoded
+                // bound never cuts into the child
+                float lo = std::floor((child.bounds.min[axis] - node.origin[axis]) / step[axis]);
+                float hi = std::ceil((child.bounds.max[axis] - node.origin[axis]) / step[axis]);
+                int qlo = std::max(0, std::min(255, static_cast<int>(lo)));
+                int qhi = std::max(0, std::min(255, static_cast<int>(hi)));
+                while (qlo > 0 && node.origin[axis] + qlo * step[axis] > child.bounds.min[axis]) qlo--;
+                while (qhi < 255 && node.origin[axis] + qhi * step[axis] < child.bounds.max[axis]) qhi++;
+                node.qlo[axis][s] = static_cast<unsigned char>(qlo);
+                node.qhi[axis][s] = static_cast<unsigned char>(qhi);
+            }
+            int count = subtreeCount[childIndex];
+            if (count <= kWideLeafSize) {
+                int offset = static_cast<int>(wide.primIndices.size()) - node.primBase;
+                node.meta[s] = static_cast<unsigned char>((count - 1) << 5 | offset);
+                auto first = binary.primIndices.begin() + subtreeFirst[childIndex];
+                wide.primIndices.insert(wide.primIndices.end(), first, first + count);
+            } else {
+                node.meta[s] = static_cast<unsigned char>(0x80 | innerCount);
+                pending.push_back({ node.childBase + innerCount, childIndex });
+                innerCount++;
+            }
+        }
+        wide.nodes.resize(wide.nodes.size() + innerCount);
+        wide.nodes[wideIndex] = node;
+    }
+    return wide;
+}
@@ -0,0 +1,89 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+
+// Axis-aligned bounding box.
+struct Aabb {
+    float min[3];
+    float max[3];
+};
+
+// An empty box that any growAabb() call replaces.
+Aabb emptyAabb();
+void growAabb(Aabb& box, const float point[3]);
+void growAabb(Aabb& box, const Aabb& other);
+float aabbSurfaceArea(const Aabb& box);
+
+// Flattened binary BVH node. Leaves (count > 0) hold primitives
+// [first, first + count) of the index list; inner nodes (count == 0) have
+// their two children at nodes[first] and nodes[first + 1].
+struct BvhNode {
+    Aabb bounds;
+    int first;
+    int count;
+};
+
+// Levels a binary tree may have at most. The trace shader's traversal stack
+// and stackless restart trail are sized for it.
+const int kMaxBvhDepth = 64;
+
+// Bounding volume hierarchy over an abstract set of primitives. primIndices
+// maps leaf ranges back to the caller's primitive order.
+struct Bvh {
+    std::vector<BvhNode> nodes;  // nodes[0] is the root
+    std::vector<int> primIndices;
+};
+
+// Builds a BVH with binned SAH splits over primitive bounds. Leaves hold at
+// most maxLeafSize primitives unless a split cannot separate them, or the
+// tree has reached kMaxBvhDepth levels.
+Bvh buildBvh(const std::vector<Aabb>& primBounds, int maxLeafSize);
+
+// Recomputes every node's bounds bottom-up from new primitive bounds while
+// keeping the tree topology. Subtrees below the top of the tree are refit on
+// up to threadCount threads. changedNodes[i] is set to 1 for every node whose
+// bounds moved; returns the number of such nodes.
+int refitBvh(Bvh& bvh, const std::vector<Aabb>& primBounds, int threadCount,
+             std::vector<unsigned char>& changedNodes);
+
+// Surface area heuristic cost of the tree (traversal cost 1, intersection cost 1),
+// relative to the root's surface area.
+float bvhSahCost(const Bvh& bvh);
+
+// Children per wide node and primitives per wide leaf.
+const int kWideBvhArity = 8;
+const int kWideLeafSize = 4;
+
+// Compressed eight-wide BVH node. Child bounds are stored as 8-bit offsets
+// on a per-axis grid of power-of-two steps anchored at 'origin'; a child
+// covers origin + q * 2^(exponent - 127) for q in [qlo, qhi]. Children sit
+// in the slot of the octant they lie in relative to the node's center, so
+// a ray visits them roughly front to back by walking the slots in an order
+// derived from its direction signs. meta[slot] is 0xff for an empty slot,
+// 0x80 | k for the inner node childBase + k, and (count - 1) << 5 | offset
+// for a leaf with primitives [primBase + offset, primBase + offset + count).
+struct WideBvhNode {
+    float origin[3];
+    unsigned char exponent[3];
+    int childBase;
+    int primBase;
+    unsigned char meta[kWideBvhArity];
+    unsigned char qlo[3][kWideBvhArity];
+    unsigned char qhi[3][kWideBvhArity];
+};
+
+// Wide BVH in the same sense as Bvh: nodes[0] is the root and primIndices
+// maps the leaf ranges back to the caller's primitive order.
+struct WideBvh {
+    std::vector<WideBvhNode> nodes;
+    std::vector<int> primIndices;
+};
+
+// Collapses a binary BVH into a wide one by repeatedly opening the largest
+// inner child until a node has kWideBvhArity children. Subtrees of at most
+// kWideLeafSize primitives become single leaves; binary leaves with more
+// are split first.
+WideBvh collapseBvh(const Bvh& bvh, const std::vector<Aabb>& primBounds);
+
+#endif  // BVH_H
@@ -0,0 +1,94 @@
+#include "Camera.h"
+#include <cmath>
+#include <string>
+
+void computeCameraRotation(float yaw, float pitch, float rotation[9]) {
+    float cosPitch = cosf(pitch);
+    float sinPitch = sinf(pitch);
+    float cosYaw = cosf(yaw);
+    float sinYaw = sinf(yaw);
+
+    // 1) Standard "look" vector in a right-handed coordinate system:
+    //    - yaw rotates around Y
+    //    - pitch rotates around X
+    //    This formula ensures "pitch" always moves the camera up/down in its local X axis
+    float front[3] = {
+        cosPitch * sinYaw,  // X
+        sinPitch,           // Y
+        cosPitch * cosYaw   // Z
+    };
+
+    // Normalize front (just in case)
+    {
+        float len = sqrtf(front[0] * front[0] + front[1] * front[1] + front[2] * front[2]);
+        front[0] /= len;
+        front[1] /= len;
+        front[2] /= len;
+    }
+
+    // 2) Compute right = front x worldUp
+    float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+    float right[3] = {
+        front[1] * worldUp[2] - front[2] * worldUp[1],
+        front[2] * worldUp[0] - front[0] * worldUp[2],
+        front[0] * worldUp[1] - front[1] * worldUp[0]
+    };
+    // Normalize right
+    {
+        float rLen = sqrtf(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+        right[0] /= rLen;
+        right[1] /= rLen;
+        right[2] /= rLen;
+    }
+
+    // 3) Compute up = right x front
+    float up[3] = {
+        right[1] * front[2] - right[2] * front[1],
+        right[2] * front[0] - right[0] * front[2],
+        right[0] * front[1] - right[1] * front[0]
+    };
+    // Normalize up
+    {
+        float uLen = sqrtf(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+        up[0] /= uLen;
+        up[1] /= uLen;
+        up[2] /= uLen;
+    }
+
+    // Columns as expected by uCamRot
+    float camRot[9] = {
+        right[0], up[0], front[0],
+        right[1], up[1], front[1],
+        right[2], up[2], front[2]
+    };
+    for (int i = 0; i < 9; i++) {
+        rotation[i] = camRot[i];
+    }
+}
+
+CameraState makeCameraState(const float position[3], float yaw, float pitch) {
+    CameraState camera;
+    for (int i = 0; i < 3; i++) {
+        camera.position[i] = position[i];
+    }
+    computeCameraRotation(yaw, pitch, camera.rotation);
+    return camera;
+}
+
+void setCameraUniforms(GLuint program, const char* prefix, const CameraState& camera) {
+    std::string name = prefix;
+    GLint camPosLoc = glGetUniformLocation(program, (name + "Pos").c_str());
+    glUniform3f(camPosLoc, camera.position[0], camera.position[1], camera.position[2]);
+    GLint camRotLoc = glGetUniformLocation(program, (name + "Rot").c_str());
+    glUniformMatrix3fv(camRotLoc, 1, GL_FALSE, camera.rotation);
+}
+
+bool cameraStatesEqual(const CameraState& a, const CameraState& b) {
+    for (int i = 0; i < 3; i++) {
+        if (a.position[i] != b.position[i]) return false;
+    }
+    for (int i = 0; i < 9; i++) {
+        if (a.rotation[i] != b.rotation[i]) return false;
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <GL/glew.h>
+
+// Camera as seen by the shaders: position and the uCamRot matrix.
+struct CameraState {
+    float position[3];
+    float rotation[9];  // column-major, uploaded as-is with glUniformMatrix3fv
+};
+
+// Builds the camera rotation (right, up, front) from yaw and pitch in radians.
+void computeCameraRotation(float yaw, float pitch, float rotation[9]);
+
+// Fills a camera state from a position and yaw/pitch angles.
+CameraState makeCameraState(const float position[3], float yaw, float pitch);
+
+// Uploads the camera to the uniforms <prefix>Pos and <prefix>Rot of the
+// currently used program, e.g. prefix "uCam" or "uPrevCam".
+void setCameraUniforms(GLuint program, const char* prefix, const CameraState& camera);
+
+// True if both cameras have exactly the same position and orientation.
+bool cameraStatesEqual(const CameraState& a, const CameraState& b);
+
+#endif  // CAMERA_H
@@ -0,0 +1,409 @@
+#include "DistributedRender.h"
+#include "Exr.h"
+#include "RenderDaemon.h"
+#include <iostream>
+
+#ifdef _WIN32
+
+bool runDistributedJob(const BatchJob& job, const std::vector<std::string>& workers, const std::string& token) {
+    std::cerr << "Distributed rendering needs the render daemon, which is not available on this platform\n";
+    return false;
+}
+
+#else
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Pieces sent to a worker before its first result comes back.
+const int kPiecesInFlight = 2;
+
+// Samples per pixel of one piece at most, so slow pieces stay short.
+const int kMaxPieceSpp = 1024;
+
+// A piece is given up after failing on this many workers.
+const int kMaxPieceAttempts = 3;
+
+// A worker that makes no progress for this long, plus the time its pieces
+// take at kMinSamplesPerMs, is considered hung and dropped.
+const double kWorkerTimeoutMs = 30000.0;
+const double kMinSamplesPerMs = 500.0;
+
+typedef std::chrono::steady_clock Clock;
+
+// A rectangle of the frame and a range of its passes.
+struct FramePiece {
+    int x, y, width, height;  // from the top left
+    int firstPass;
+    int passCount;
+    int attempts = 0;
+    Clock::time_point sentAt;  // when it was last sent to a worker
+};
+
+struct RenderWorker {
+    std::string address;
+    int fd = -1;
+    std::vector<int> inFlight;  // piece indices, in the order they were sent
+    std::string input;          // bytes received and not yet parsed
+    size_t payloadBytes = 0;    // pixel bytes still expected for payloadPiece
+    int payloadPiece = -1;
+    Clock::time_point lastFinished;  // when the worker last completed or failed a piece
+};
+
+std::vector<FramePiece> splitFrame(const BatchJob& job, int workerCount) {
+    int passSamples = job.denoise ? kBatchDenoisePassSamples : 1;
+    int passCount = (job.spp + passSamples - 1) / passSamples;
+    int tilesX = (job.width + kDistributedTileSize - 1) / kDistributedTileSize;
+    int tilesY = (job.height + kDistributedTileSize - 1) / kDistributedTileSize;
+
+    // Split samples as well when there are too few tiles to keep every worker busy
+    int slices = std::max(1, (2 * kPiecesInFlight * workerCount + tilesX * tilesY - 1) / (tilesX * tilesY));
+    int maxPiecePasses = std::max(1, kMaxPieceSpp / passSamples);
+    slices = std::max(slices, (passCount + maxPiecePasses - 1) / maxPiecePasses);
+    slices = std::min(slices, passCount);
+
+    std::vector<FramePiece> pieces;
+    for (int slice = 0; slice < slices; slice++) {
+        int firstPass = passCount * slice / slices;
+        int lastPass = passCount * (slice + 1) / slices;
+        for (int ty = 0; ty < tilesY; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                FramePiece piece;
+                piece.x = tx * kDistributedTileSize;
+                piece.y = ty * kDistributedTileSize;
+                piece.width = std::min(kDistributedTileSize, job.width - piece.x);
+                piece.height = std::min(kDistributedTileSize, job.height - piece.y);
+                piece.firstPass = firstPass;
+                piece.passCount = lastPass - firstPass;
+                pieces.push_back(piece);
+            }
+        }
+    }
+    return pieces;
+}
+
+std::string pieceRequest(const BatchJob& job, int frame, int index, const FramePiece& piece) {
+    float time = frame / job.fps;
+    float position[3];
+    float yaw, pitch;
+    batchCameraAt(job, time, position, yaw, pitch);
+    const float toDegrees = 180.0f / 3.14159265f;
+    int passSamples = job.denoise ? kBatchDenoisePassSamples : 1;
+
+    std::ostringstream request;
+    request.precision(9);
+    request << "render id " << index << " size " << job.width << " " << job.height << " region " << piece.x << " "
+            << piece.y << " " << piece.width << " " << piece.height << " spp " << piece.passCount * passSamples
+            << " seed " << piece.firstPass << " camera " << position[0] << " " << position[1] << " " << position[2]
+            << " " << yaw * toDegrees << " " << pitch * toDegrees << " fov " << job.fovDegrees
+            << " gi " << (job.gi ? "on" : "off") << " denoise " << (job.denoise ? "on" : "off")
+            << " skybox " << (job.skybox ? "on" : "off") << " time " << time << " format sums deliver inline\n";
+    return request.str();
+}
+
+bool sendAll(int fd, const std::string& text) {
+    size_t sent = 0;
+    while (sent < text.size()) {
+        ssize_t n = send(fd, text.data() + sent, text.size() - sent, 0);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Sends the daemon token and waits for the daemon to accept it.
+bool authenticate(int fd, const std::string& token) {
+    if (!sendAll(fd, "auth " + token + "\n")) {
+        return false;
+    }
+    std::string reply;
+    char c = 0;
+    while (reply.size() < 256 && recv(fd, &c, 1, 0) == 1 && c != '\n') {
+        reply += c;
+    }
+    return reply == "ok auth";
+}
+
+// Time by which a busy worker must have finished its oldest piece: counted
+// from when that piece was sent, or from the worker's previous result if it
+// was still busy then, and long enough for every piece it holds, which the
+// daemon may trace together.
+Clock::time_point workerDeadline(const RenderWorker& worker, const std::vector<FramePiece>& pieces,
+                                 int passSamples) {
+    int oldest = worker.payloadPiece >= 0 ? worker.payloadPiece : worker.inFlight.front();
+    double samples = 0.0;
+    for (int index : worker.inFlight) {
+        const FramePiece& piece = pieces[index];
+        samples += static_cast<double>(piece.width) * piece.height * piece.passCount * passSamples;
+    }
+    double budgetMs = kWorkerTimeoutMs + samples / kMinSamplesPerMs;
+    return std::max(pieces[oldest].sentAt, worker.lastFinished) +
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+}
+
+// Takes a worker out of the job and queues its pieces for the others.
+void dropWorker(RenderWorker& worker, std::deque<int>& queue, const std::string& reason) {
+    if (worker.payloadPiece >= 0) {
+        worker.inFlight.push_back(worker.payloadPiece);  // its pixels were cut off
+    }
+    std::cerr << "Worker " << worker.address << " " << reason << ", rescheduling " << worker.inFlight.size()
+              << " pieces\n";
+    for (int index : worker.inFlight) {
+        queue.push_front(index);
+    }
+    worker.inFlight.clear();
+    worker.input.clear();
+    worker.payloadPiece = -1;
+    close(worker.fd);
+    worker.fd = -1;
+}
+
+// Adds a piece's radiance sums and sample counts to the frame.
+void mergePiece(const FramePiece& piece, const char* data, int frameWidth, std::vector<float>& sums) {
+    const float* values = reinterpret_cast<const float*>(data);
+    for (int y = 0; y < piece.height; y++) {
+        float* row = &sums[(static_cast<size_t>(piece.y + y) * frameWidth + piece.x) * 4];
+        const float* source = &values[static_cast<size_t>(y) * piece.width * 4];
+        for (int i = 0; i < piece.width * 4; i++) {
+            row[i] += source[i];
+        }
+    }
+}
+
+// Parses the replies buffered for a worker. Returns false if the worker must
+// be dropped; failed pieces are queued again until they run out of attempts.
+bool readReplies(RenderWorker& worker, std::vector<FramePiece>& pieces, std::deque<int>& queue, int frameWidth,
+                 std::vector<float>& sums, int& finished, bool& gaveUp) {
+    for (;;) {
+        if (worker.payloadPiece >= 0) {
+            if (worker.input.size() < worker.payloadBytes) {
+                return true;
+            }
+            mergePiece(pieces[worker.payloadPiece], worker.input.data(), frameWidth, sums);
+            worker.input.erase(0, worker.payloadBytes);
+            worker.payloadPiece = -1;
+            worker.lastFinished = Clock::now();
+            finished++;
+            continue;
+        }
+        size_t end = worker.input.find('\n');
+        if (end == std::string::npos) {
+            return true;
+        }
+        std::istringstream reply(worker.input.substr(0, end));
+        worker.input.erase(0, end + 1);
+        std::string status, location, format;
+        int index = -1, width = 0, height = 0;
+        size_t bytes = 0;
+        // Replies without a piece number, such as "error - authentication
+        // required", cannot be matched to a piece
+        if (!(reply >> status >> index)) {
+            std::cerr << "Worker " << worker.address << " sent a reply without a piece: " << reply.str() << "\n";
+            return false;
+        }
+        auto sent = std::find(worker.inFlight.begin(), worker.inFlight.end(), index);
+        if (sent == worker.inFlight.end()) {
+            std::cerr << "Worker " << worker.address << " answered an unknown request: " << reply.str() << "\n";
+            return false;
+        }
+        worker.inFlight.erase(sent);
+        const FramePiece& piece = pieces[index];
+        reply >> location >> width >> height >> format >> bytes;
+        if (status == "ok" && location == "inline" && format == "sums" && width == piece.width &&
+            height == piece.height && bytes == static_cast<size_t>(width) * height * 4 * sizeof(float)) {
+            worker.payloadPiece = index;
+            worker.payloadBytes = bytes;
+            continue;
+        }
+        std::cerr << "Worker " << worker.address << " failed a piece: " << reply.str() << "\n";
+        worker.lastFinished = Clock::now();
+        if (++pieces[index].attempts >= kMaxPieceAttempts) {
+            gaveUp = true;
+        }
+        queue.push_back(index);
+        if (status == "ok") {
+            return false;  // a reply we cannot parse leaves the stream out of step
+        }
+    }
+}
+
+bool renderFrame(const BatchJob& job, int frame, std::vector<RenderWorker>& workers, std::vector<float>& sums) {
+    int aliveCount = 0;
+    for (const RenderWorker& worker : workers) {
+        aliveCount += worker.fd >= 0 ? 1 : 0;
+    }
+    std::vector<FramePiece> pieces = splitFrame(job, std::max(aliveCount, 1));
+    std::deque<int> queue;
+    for (int i = 0; i < static_cast<int>(pieces.size()); i++) {
+        queue.push_back(i);
+    }
+    sums.assign(static_cast<size_t>(job.width) * job.height * 4, 0.0f);
+    int finished = 0;
+    bool gaveUp = false;
+    int passSamples = job.denoise ? kBatchDenoisePassSamples : 1;
+
+    while (finished < static_cast<int>(pieces.size())) {
+        if (gaveUp) {
+            std::cerr << "Frame " << frame + 1 << ": a piece failed " << kMaxPieceAttempts << " times\n";
+            return false;
+        }
+        // Keep every worker busy
+        std::vector<pollfd> fds;
+        std::vector<RenderWorker*> polled;
+        for (RenderWorker& worker : workers) {
+            while (worker.fd >= 0 && !queue.empty() && static_cast<int>(worker.inFlight.size()) < kPiecesInFlight) {
+                int index = queue.front();
+                queue.pop_front();
+                worker.inFlight.push_back(index);
+                pieces[index].sentAt = Clock::now();
+                if (!sendAll(worker.fd, pieceRequest(job, frame, index, pieces[index]))) {
+                    dropWorker(worker, queue, "disconnected");
+                }
+            }
+            if (worker.fd >= 0) {
+                pollfd entry;
+                entry.fd = worker.fd;
+                entry.events = POLLIN;
+                entry.revents = 0;
+                fds.push_back(entry);
+                polled.push_back(&worker);
+            }
+        }
+        if (fds.empty()) {
+            std::cerr << "Frame " << frame + 1 << ": no workers left\n";
+            return false;
+        }
+
+        // Wake up in time to drop the first worker that hangs
+        Clock::time_point now = Clock::now();
+        int timeoutMs = -1;
+        for (RenderWorker* worker : polled) {
+            if (worker->inFlight.empty() && worker->payloadPiece < 0) {
+                continue;
+            }
+            Clock::time_point deadline = workerDeadline(*worker, pieces, passSamples);
+            if (deadline <= now) {
+                dropWorker(*worker, queue, "timed out");
+                timeoutMs = 0;
+                continue;
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+            timeoutMs = timeoutMs < 0 ? static_cast<int>(remaining) : std::min(timeoutMs, static_cast<int>(remaining));
+        }
+        if (timeoutMs == 0 || poll(fds.data(), fds.size(), timeoutMs) <= 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            RenderWorker& worker = *polled[i];
+            char buffer[65536];
+            ssize_t n = recv(worker.fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                dropWorker(worker, queue, "disconnected");
+                continue;
+            }
+            worker.input.append(buffer, static_cast<size_t>(n));
+            if (!readReplies(worker, pieces, queue, job.width, sums, finished, gaveUp)) {
+                dropWorker(worker, queue, "sent an unusable reply");
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+bool runDistributedJob(const BatchJob& job, const std::vector<std::string>& workerAddresses,
+                       const std::string& token) {
+    // A worker that dies mid-send must not end the coordinator
+    std::signal(SIGPIPE, SIG_IGN);
+    std::vector<RenderWorker> workers;
+    for (const std::string& address : workerAddresses) {
+        RenderWorker worker;
+        worker.address = address;
+        worker.fd = openDaemonSocket(address, false);
+        if (worker.fd >= 0 && !token.empty() && !authenticate(worker.fd, token)) {
+            std::cerr << "Worker " << address << " refused the token\n";
+            close(worker.fd);
+            worker.fd = -1;
+        }
+        if (worker.fd >= 0) {
+            workers.push_back(worker);
+        }
+    }
+    if (workers.empty()) {
+        std::cerr << "No render workers reachable\n";
+        return false;
+    }
+    if (job.aovs) {
+        std::cout << "AOVs are not rendered by workers; writing the beauty pass only\n";
+    }
+    std::cout << "Distributed job: " << job.frameCount << " frames at " << job.width << "x" << job.height
+              << " on " << workers.size() << " workers\n";
+
+    ExrWriteOptions exrOptions;
+    exrOptions.compression = job.compression;
+    exrOptions.tileSize = job.tileSize;
+    std::vector<float> sums;
+    bool success = true;
+    for (int frame = 0; frame < job.frameCount; frame++) {
+        std::string outputPath = batchFramePath(job, frame);
+        if (std::ifstream(outputPath)) {
+            std::cout << "Frame " << frame + 1 << "/" << job.frameCount << ": " << outputPath
+                      << " exists, skipped\n";
+            continue;
+        }
+        auto frameStart = std::chrono::steady_clock::now();
+        if (!renderFrame(job, frame, workers, sums)) {
+            success = false;
+            break;
+        }
+
+        // Divide the merged sums by the merged sample counts
+        for (size_t i = 0; i < sums.size(); i += 4) {
+            float scale = sums[i + 3] > 0.0f ? 1.0f / sums[i + 3] : 0.0f;
+            for (int c = 0; c < 3; c++) {
+                sums[i + c] *= scale;
+            }
+            sums[i + 3] = 1.0f;
+        }
+        ExrImage image;
+        image.width = job.width;
+        image.height = job.height;
+        const char* names[] = { "R", "G", "B", "A" };
+        for (int c = 0; c < 4; c++) {
+            image.channels.push_back({ names[c], job.precision, &sums[c], 4 });
+        }
+        if (!writeExr(outputPath, image, exrOptions)) {
+            success = false;
+            continue;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+        std::cout << "Frame " << frame + 1 << "/" << job.frameCount << ": " << outputPath << " written in "
+                  << seconds << " s\n";
+    }
+
+    for (RenderWorker& worker : workers) {
+        if (worker.fd >= 0) {
+            close(worker.fd);
+        }
+    }
+    return success;
+}
+
+#endif  // _WIN32
@@ -0,0 +1,24 @@
+#ifndef DISTRIBUTED_RENDER_H
+#define DISTRIBUTED_RENDER_H
+
+#include "BatchRender.h"
+#include <string>
+#include <vector>
+
+// Edge length in pixels of the tiles a frame is split into.
+const int kDistributedTileSize = 128;
+
+// Renders a batch job on render daemons (see RenderDaemon.h) instead of the
+// local GPU. Each frame is split into tiles, and into sample ranges when there
+// are few tiles per worker; every worker keeps two pieces in flight and
+// returns radiance sums with sample counts, which are added up so each pixel
+// is weighted by the samples it actually received. The pieces of a worker
+// that disconnects, fails or stops answering go back to the queue for the
+// others. Workers
+// trace the scene they were started with. Frames with an output file are
+// skipped, so an interrupted job resumes at the first missing frame. A
+// non-empty token is sent to every worker before the first request.
+// Returns false if a frame could not be completed.
+bool runDistributedJob(const BatchJob& job, const std::vector<std::string>& workers, const std::string& token);
+
+#endif  // DISTRIBUTED_RENDER_H
@@ -0,0 +1,68 @@
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Timer results lag a few frames; wait that long after a change before judging its effect.
+const int kSettleFrames = kGpuTimerLatency + 1;
+
+// Growing the resolution is delayed longer than shrinking it so a short
+// cheap stretch does not immediately push the next frame over budget.
+const int kGrowFrames = 3 * kSettleFrames;
+
+float snapScale(const DynamicResolution& c, float scale) {
+    scale = std::floor(scale / c.scaleStep + 0.5f) * c.scaleStep;
+    return std::min(std::max(scale, c.minScale), c.maxScale);
+}
+
+}  // namespace
+
+bool updateDynamicResolution(DynamicResolution& c, double gpuMs) {
+    if (gpuMs <= 0.0) {
+        return false;
+    }
+    if (c.warmupFrames > 0) {
+        c.warmupFrames--;
+        return false;
+    }
+
+    // Exponential moving average filters single-frame spikes.
+    float ms = static_cast<float>(gpuMs);
+    c.smoothedMs = (c.smoothedMs < 0.0f) ? ms : c.smoothedMs + 0.25f * (ms - c.smoothedMs);
+    c.framesSinceChange++;
+    if (c.framesSinceChange < kSettleFrames) {
+        return false;
+    }
+
+    float upper = c.targetMs * (1.0f + c.hysteresis);
+    float lower = c.targetMs * (1.0f - c.hysteresis);
+    float newScale = c.scale;
+
+    // Trace cost is proportional to pixel count, i.e. to scale squared.
+    if (c.smoothedMs > upper) {
+        newScale = c.scale * std::sqrt(c.targetMs / c.smoothedMs);
+    }
+    else if (c.smoothedMs < lower && c.framesSinceChange >= kGrowFrames) {
+        // Grow by at most 10% per step; the estimate is less reliable upwards.
+        newScale = c.scale * std::min(std::sqrt(c.targetMs / c.smoothedMs), 1.1f);
+    }
+
+    newScale = snapScale(c, newScale);
+    if (newScale == c.scale) {
+        return false;
+    }
+
+    // Predict the frame time at the new scale so the average does not have to relearn from scratch.
+    c.smoothedMs *= (newScale * newScale) / (c.scale * c.scale);
+    c.scale = newScale;
+    c.framesSinceChange = 0;
+    return true;
+}
+
+void resetDynamicResolution(DynamicResolution& c) {
+    c.smoothedMs = -1.0f;
+    c.framesSinceChange = 0;
+    c.warmupFrames = 1;
+}
@@ -0,0 +1,32 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// Adjusts the internal render scale from measured GPU frame times so the
+// trace pass stays within a frame-time budget.
+struct DynamicResolution {
+    float targetMs = 16.6f;
+    float minScale = 0.25f;
+    float maxScale = 1.0f;
+    // Frame times inside [target * (1 - hysteresis), target * (1 + hysteresis)]
+    // leave the scale alone, which keeps it from oscillating around the target.
+    float hysteresis = 0.15f;
+    // Scales are snapped to multiples of this step so small corrections do not
+    // reallocate the render target every frame.
+    float scaleStep = 1.0f / 32.0f;
+
+    float scale = 1.0f;
+    float smoothedMs = -1.0f;
+    int framesSinceChange = 0;
+    // Samples still to be ignored after a reset. The first frame after startup or a
+    // toggle includes lazy shader compilation and is not representative.
+    int warmupFrames = 1;
+};
+
+// Feeds one GPU frame time measured at the current scale. Returns true when
+// the controller picked a new scale (available in controller.scale).
+bool updateDynamicResolution(DynamicResolution& controller, double gpuMs);
+
+// Forgets the smoothed frame time, e.g. after a feature toggle changes the cost per pixel.
+void resetDynamicResolution(DynamicResolution& controller);
+
+#endif  // DYNAMIC_RESOLUTION_H
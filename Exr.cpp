@@ -0,0 +1,456 @@
+#include "Exr.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// Little-endian serialization of header fields, independent of the host.
+void putInt(std::vector<unsigned char>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+void putUint64(std::vector<unsigned char>& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+void putFloat(std::vector<unsigned char>& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putInt(out, bits);
+}
+
+void putString(std::vector<unsigned char>& out, const char* text) {
+    out.insert(out.end(), text, text + std::strlen(text) + 1);
+}
+
+// Attribute header: name, type name and value size.
+void putAttribute(std::vector<unsigned char>& out, const char* name, const char* type, uint32_t size) {
+    putString(out, name);
+    putString(out, type);
+    putInt(out, size);
+}
+
+void putBox(std::vector<unsigned char>& out, const char* name, int width, int height) {
+    putAttribute(out, name, "box2i", 16);
+    putInt(out, 0);
+    putInt(out, 0);
+    putInt(out, static_cast<uint32_t>(width - 1));
+    putInt(out, static_cast<uint32_t>(height - 1));
+}
+
+// Deflate output, least significant bit first.
+struct BitWriter {
+    std::vector<unsigned char>& out;
+    uint32_t bits = 0;
+    int count = 0;
+
+    explicit BitWriter(std::vector<unsigned char>& out) : out(out) {}
+
+    void put(uint32_t value, int length) {
+        bits |= value << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back(static_cast<unsigned char>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes are defined most significant bit first
+    void putCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed |= ((code >> i) & 1u) << (length - 1 - i);
+        }
+        put(reversed, length);
+    }
+
+    void flush() {
+        if (count > 0) {
+            out.push_back(static_cast<unsigned char>(bits));
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+const int kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                              35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                               3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                8193, 12289, 16385, 24577 };
+const int kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Fixed literal/length code of RFC 1951 section 3.2.6.
+void putLiteralLength(BitWriter& writer, int symbol) {
+    if (symbol < 144) {
+        writer.putCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.putCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.putCode(symbol - 256, 7);
+    } else {
+        writer.putCode(0xc0 + symbol - 280, 8);
+    }
+}
+
+void putMatch(BitWriter& writer, int length, int distance) {
+    int code = 0;
+    while (code < 28 && kLengthBase[code + 1] <= length) {
+        code++;
+    }
+    putLiteralLength(writer, 257 + code);
+    writer.put(length - kLengthBase[code], kLengthExtra[code]);
+    int distanceCode = 0;
+    while (distanceCode < 29 && kDistanceBase[distanceCode + 1] <= distance) {
+        distanceCode++;
+    }
+    writer.putCode(distanceCode, 5);
+    writer.put(distance - kDistanceBase[distanceCode], kDistanceExtra[distanceCode]);
+}
+
+// LZ77 window and match search limits.
+const int kWindowSize = 32768;
+const int kHashBits = 15;
+const int kMaxChain = 32;
+const int kMinMatch = 3;
+const int kMaxMatch = 258;
+
+uint32_t hash3(const unsigned char* p) {
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - kHashBits);
+}
+
+// The byte reordering and delta predictor shared by RLE and ZIP blocks.
+std::vector<unsigned char> predictBytes(const std::vector<unsigned char>& raw) {
+    std::vector<unsigned char> result(raw.size());
+    size_t half = (raw.size() + 1) / 2;
+    for (size_t i = 0; i < raw.size(); i++) {
+        result[(i & 1) ? half + i / 2 : i / 2] = raw[i];
+    }
+    unsigned char previous = result.empty() ? 0 : result[0];
+    for (size_t i = 1; i < result.size(); i++) {
+        unsigned char current = result[i];
+        result[i] = static_cast<unsigned char>(current - previous + 128);
+        previous = current;
+    }
+    return result;
+}
+
+std::vector<unsigned char> rleCompress(const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> out;
+    size_t i = 0;
+    while (i < data.size()) {
+        size_t run = 1;
+        while (i + run < data.size() && run < 128 && data[i + run] == data[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            // Repeat: count - 1, then the byte
+            out.push_back(static_cast<unsigned char>(run - 1));
+            out.push_back(data[i]);
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of three, as a negative count
+        size_t start = i;
+        while (i < data.size() && i - start < 127 &&
+               !(i + 2 < data.size() && data[i] == data[i + 1] && data[i] == data[i + 2])) {
+            i++;
+        }
+        out.push_back(static_cast<unsigned char>(-static_cast<int>(i - start)));
+        out.insert(out.end(), data.begin() + start, data.begin() + i);
+    }
+    return out;
+}
+
+// Region of the image stored in one block.
+struct ExrBlock {
+    int x0, y0, x1, y1;  // half-open pixel bounds
+    std::vector<unsigned char> data;
+};
+
+// Lines per scanline block of each compression method.
+int blockLines(ExrCompression compression) {
+    return compression == kExrZip ? 16 : 1;
+}
+
+void encodeBlock(const ExrImage& image, const std::vector<const ExrChannel*>& channels,
+                 ExrCompression compression, ExrBlock& block) {
+    // Each line holds every channel's samples in turn
+    std::vector<unsigned char> raw;
+    for (int y = block.y0; y < block.y1; y++) {
+        for (const ExrChannel* channel : channels) {
+            for (int x = block.x0; x < block.x1; x++) {
+                float value = channel->data[(static_cast<size_t>(y) * image.width + x) * channel->stride];
+                if (channel->type == kExrHalf) {
+                    unsigned short half = floatToHalf(value);
+                    raw.push_back(static_cast<unsigned char>(half & 0xff));
+                    raw.push_back(static_cast<unsigned char>(half >> 8));
+                } else {
+                    uint32_t bits;
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    for (int i = 0; i < 4; i++) {
+                        raw.push_back(static_cast<unsigned char>(bits >> (8 * i)));
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<unsigned char> packed;
+    if (compression == kExrRle) {
+        packed = rleCompress(predictBytes(raw));
+    } else if (compression == kExrZips || compression == kExrZip) {
+        std::vector<unsigned char> predicted = predictBytes(raw);
+        packed = zlibCompress(predicted.data(), predicted.size());
+    }
+    // Readers take a block no smaller than its raw size as uncompressed
+    if (compression == kExrNoCompression || packed.size() >= raw.size()) {
+        block.data.swap(raw);
+    } else {
+        block.data.swap(packed);
+    }
+}
+
+}  // namespace
+
+unsigned short floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7fffffffu;
+
+    if (magnitude >= 0x7f800000u) {
+        // Infinity, or NaN with a mantissa bit kept set
+        return static_cast<unsigned short>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+    }
+    if (magnitude >= 0x477ff000u) {
+        // Rounds past 65504
+        return static_cast<unsigned short>(sign | 0x7c00u);
+    }
+    if (magnitude < 0x38800000u) {
+        // Subnormal half: shift the mantissa with its implicit bit into place
+        if (magnitude < 0x33000000u) {
+            return static_cast<unsigned short>(sign);
+        }
+        uint32_t exponent = magnitude >> 23;
+        uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+        uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+            half++;
+        }
+        return static_cast<unsigned short>(sign | half);
+    }
+    // Normal: rebias the exponent and round the mantissa to 10 bits
+    uint32_t half = (magnitude - 0x38000000u) >> 13;
+    uint32_t remainder = magnitude & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        half++;
+    }
+    return static_cast<unsigned short>(sign | half);
+}
+
+std::vector<unsigned char> zlibCompress(const unsigned char* data, size_t size) {
+    std::vector<unsigned char> out = { 0x78, 0x01 };
+    BitWriter writer(out);
+    writer.put(1, 1);  // final block
+    writer.put(1, 2);  // fixed Huffman codes
+
+    // Greedy LZ77 over hash chains of three-byte prefixes
+    std::vector<int> head(1 << kHashBits, -1);
+    std::vector<int> previous(kWindowSize, -1);
+    size_t i = 0;
+    while (i < size) {
+        int bestLength = 0;
+        int bestDistance = 0;
+        if (i + kMinMatch <= size) {
+            uint32_t h = hash3(data + i);
+            int candidate = head[h];
+            int limit = static_cast<int>(std::min<size_t>(kMaxMatch, size - i));
+            for (int chain = 0; candidate >= 0 && chain < kMaxChain; chain++) {
+                int distance = static_cast<int>(i) - candidate;
+                if (distance > kWindowSize - 1) {
+                    break;
+                }
+                int length = 0;
+                while (length < limit && data[candidate + length] == data[i + length]) {
+                    length++;
+                }
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = distance;
+                    if (length == limit) {
+                        break;
+                    }
+                }
+                candidate = previous[candidate % kWindowSize];
+            }
+        }
+        size_t advance = bestLength >= kMinMatch ? bestLength : 1;
+        if (bestLength >= kMinMatch) {
+            putMatch(writer, bestLength, bestDistance);
+        } else {
+            putLiteralLength(writer, data[i]);
+        }
+        // Index every position the step covers
+        for (size_t j = i; j < i + advance && j + kMinMatch <= size; j++) {
+            uint32_t h = hash3(data + j);
+            previous[j % kWindowSize] = head[h];
+            head[h] = static_cast<int>(j);
+        }
+        i += advance;
+    }
+    putLiteralLength(writer, 256);
+    writer.flush();
+
+    // Adler-32 of the uncompressed data, big-endian
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t j = 0; j < size; j++) {
+        a = (a + data[j]) % 65521u;
+        b = (b + a) % 65521u;
+    }
+    uint32_t adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<unsigned char>(adler >> shift));
+    }
+    return out;
+}
+
+bool writeExr(const std::string& path, const ExrImage& image, const ExrWriteOptions& options) {
+    // Channels are listed, and stored, in alphabetical order
+    std::vector<const ExrChannel*> channels;
+    for (const ExrChannel& channel : image.channels) {
+        channels.push_back(&channel);
+    }
+    std::sort(channels.begin(), channels.end(),
+              [](const ExrChannel* a, const ExrChannel* b) { return a->name < b->name; });
+    bool tiled = options.tileSize > 0;
+
+    std::vector<unsigned char> header;
+    putInt(header, 20000630);             // magic number
+    putInt(header, tiled ? 0x202 : 2);    // version 2, single-part, tiled flag
+    uint32_t channelListSize = 1;
+    for (const ExrChannel* channel : channels) {
+        channelListSize += static_cast<uint32_t>(channel->name.size()) + 1 + 16;
+    }
+    putAttribute(header, "channels", "chlist", channelListSize);
+    for (const ExrChannel* channel : channels) {
+        putString(header, channel->name.c_str());
+        putInt(header, channel->type);
+        putInt(header, 0);  // pLinear and reserved bytes
+        putInt(header, 1);  // x sampling
+        putInt(header, 1);  // y sampling
+    }
+    header.push_back(0);
+    putAttribute(header, "compression", "compression", 1);
+    header.push_back(static_cast<unsigned char>(options.compression));
+    putBox(header, "dataWindow", image.width, image.height);
+    putBox(header, "displayWindow", image.width, image.height);
+    putAttribute(header, "lineOrder", "lineOrder", 1);
+    header.push_back(0);  // INCREASING_Y
+    putAttribute(header, "pixelAspectRatio", "float", 4);
+    putFloat(header, 1.0f);
+    putAttribute(header, "screenWindowCenter", "v2f", 8);
+    putFloat(header, 0.0f);
+    putFloat(header, 0.0f);
+    putAttribute(header, "screenWindowWidth", "float", 4);
+    putFloat(header, 1.0f);
+    if (tiled) {
+        putAttribute(header, "tiles", "tiledesc", 9);
+        putInt(header, static_cast<uint32_t>(options.tileSize));
+        putInt(header, static_cast<uint32_t>(options.tileSize));
+        header.push_back(0);  // one level, rounding down
+    }
+    header.push_back(0);
+
+    // Blocks in file order: scanline blocks top to bottom, or tiles row by row
+    std::vector<ExrBlock> blocks;
+    int blockWidth = tiled ? options.tileSize : image.width;
+    int blockHeight = tiled ? options.tileSize : blockLines(options.compression);
+    for (int y = 0; y < image.height; y += blockHeight) {
+        for (int x = 0; x < image.width; x += blockWidth) {
+            ExrBlock block;
+            block.x0 = x;
+            block.y0 = y;
+            block.x1 = std::min(x + blockWidth, image.width);
+            block.y1 = std::min(y + blockHeight, image.height);
+            blocks.push_back(block);
+        }
+    }
+
+    // Blocks are independent, so threads take them in turn
+    int threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threadCount = std::min(threadCount, static_cast<int>(blocks.size()));
+    std::atomic<size_t> nextBlock(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.emplace_back([&]() {
+            for (size_t b = nextBlock++; b < blocks.size(); b = nextBlock++) {
+                encodeBlock(image, channels, options.compression, blocks[b]);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // Offset table, then each block behind its coordinates and byte count
+    uint64_t offset = header.size() + blocks.size() * 8;
+    for (const ExrBlock& block : blocks) {
+        putUint64(header, offset);
+        offset += (tiled ? 20 : 8) + block.data.size();
+    }
+    // Written beside the final path and renamed into place, so a job killed
+    // mid-write never leaves a truncated file that looks finished
+    std::string partial = path + ".partial";
+    std::ofstream file(partial, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to write " << partial << "\n";
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    std::vector<unsigned char> prefix;
+    for (const ExrBlock& block : blocks) {
+        prefix.clear();
+        if (tiled) {
+            putInt(prefix, static_cast<uint32_t>(block.x0 / options.tileSize));
+            putInt(prefix, static_cast<uint32_t>(block.y0 / options.tileSize));
+            putInt(prefix, 0);  // level x
+            putInt(prefix, 0);  // level y
+        } else {
+            putInt(prefix, static_cast<uint32_t>(block.y0));
+        }
+        putInt(prefix, static_cast<uint32_t>(block.data.size()));
+        file.write(reinterpret_cast<const char*>(prefix.data()), prefix.size());
+        file.write(reinterpret_cast<const char*>(block.data.data()), block.data.size());
+    }
+    file.close();
+    if (!file) {
+        std::cerr << "Failed to write " << partial << "\n";
+        std::remove(partial.c_str());
+        return false;
+    }
+    std::remove(path.c_str());
+    if (std::rename(partial.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to rename " << partial << " to " << path << "\n";
+        return false;
+    }
+    return true;
+}
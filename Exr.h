@@ -0,0 +1,52 @@
+#ifndef EXR_H
+#define EXR_H
+
+#include <string>
+#include <vector>
+
+// Block compression, numbered as in the file format. PIZ is not supported.
+enum ExrCompression {
+    kExrNoCompression = 0,
+    kExrRle = 1,   // run lengths, one scanline per block
+    kExrZips = 2,  // deflate, one scanline per block
+    kExrZip = 3    // deflate, 16 scanlines per block
+};
+
+enum ExrPixelType {
+    kExrHalf = 1,
+    kExrFloat = 2
+};
+
+// One channel of an image. Samples are read from data[(y * width + x) * stride],
+// rows from top to bottom, so interleaved buffers are described without copies.
+struct ExrChannel {
+    std::string name;  // e.g. "R", "albedo.G", "Z"
+    ExrPixelType type = kExrHalf;
+    const float* data = nullptr;
+    int stride = 1;
+};
+
+struct ExrImage {
+    int width = 0;
+    int height = 0;
+    std::vector<ExrChannel> channels;  // in any order; the file sorts them by name
+};
+
+struct ExrWriteOptions {
+    ExrCompression compression = kExrZip;
+    int tileSize = 0;  // 0 writes scanline blocks, otherwise square tiles of this size
+};
+
+// Writes a single-part OpenEXR file. Blocks are encoded in parallel on one
+// thread per core, then written in order to path + ".partial", which is
+// renamed to path once complete. Returns false if the file cannot be written.
+bool writeExr(const std::string& path, const ExrImage& image, const ExrWriteOptions& options);
+
+// Converts a float to IEEE 754 half precision, rounding to nearest even.
+// Values beyond the half range become infinity; NaN stays NaN.
+unsigned short floatToHalf(float value);
+
+// Compresses data into a zlib stream (deflate with fixed Huffman codes).
+std::vector<unsigned char> zlibCompress(const unsigned char* data, size_t size);
+
+#endif  // EXR_H
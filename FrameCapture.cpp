@@ -0,0 +1,179 @@
+#include "FrameCapture.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Mapped frames the consumer may fall behind by before capture drops or waits.
+const size_t kCaptureQueueLimit = 4;
+
+void runConsumer(FrameCapture* capture) {
+    std::unique_lock<std::mutex> lock(capture->mutex);
+    for (;;) {
+        capture->wake.wait(lock, [capture]() { return capture->stopping || !capture->queue.empty(); });
+        if (capture->queue.empty()) {
+            return;
+        }
+        CapturedFrame frame = std::move(capture->queue.front());
+        capture->queue.pop_front();
+        capture->busy = true;
+        lock.unlock();
+
+        // glReadPixels returns the bottom row first
+        size_t row = static_cast<size_t>(frame.width) * 4;
+        for (int y = 0; y < frame.height / 2; y++) {
+            std::swap_ranges(frame.pixels.begin() + y * row, frame.pixels.begin() + (y + 1) * row,
+                             frame.pixels.begin() + (frame.height - 1 - y) * row);
+        }
+        capture->consumer(frame);
+
+        lock.lock();
+        capture->spare.push_back(std::move(frame.pixels));
+        capture->busy = false;
+        capture->space.notify_all();
+    }
+}
+
+// Maps a finished readback and queues it for the consumer.
+void collectSlot(FrameCapture& capture, int slot) {
+    GLsync fence = capture.fences[slot];
+    if (!fence) {
+        return;
+    }
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+    capture.fences[slot] = 0;
+
+    CapturedFrame frame;
+    frame.index = capture.indices[slot];
+    frame.width = capture.widths[slot];
+    frame.height = capture.heights[slot];
+    size_t size = static_cast<size_t>(frame.width) * frame.height * 4;
+    {
+        std::unique_lock<std::mutex> lock(capture.mutex);
+        if (capture.queue.size() >= kCaptureQueueLimit) {
+            if (capture.dropWhenBehind) {
+                capture.dropped++;
+                return;
+            }
+            capture.space.wait(lock, [&capture]() { return capture.queue.size() < kCaptureQueueLimit; });
+        }
+        if (!capture.spare.empty()) {
+            frame.pixels = std::move(capture.spare.back());
+            capture.spare.pop_back();
+        }
+    }
+    frame.pixels.resize(size);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[slot]);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (mapped) {
+        std::memcpy(frame.pixels.data(), mapped, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!mapped) {
+        std::cerr << "Failed to map capture buffer\n";
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    capture.queue.push_back(std::move(frame));
+    capture.wake.notify_one();
+}
+
+}  // namespace
+
+void createFrameCapture(FrameCapture& capture, CaptureConsumer consumer, bool dropWhenBehind) {
+    glGenBuffers(kCaptureRing, capture.buffers);
+    capture.consumer = consumer;
+    capture.dropWhenBehind = dropWhenBehind;
+    capture.stopping = false;
+    capture.worker = std::thread(runConsumer, &capture);
+}
+
+void captureFrame(FrameCapture& capture, GLuint framebuffer, int width, int height) {
+    int slot = capture.next;
+    collectSlot(capture, slot);
+
+    size_t size = static_cast<size_t>(width) * height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[slot]);
+    if (capture.capacity[slot] < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        capture.capacity[slot] = size;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture.widths[slot] = width;
+    capture.heights[slot] = height;
+    capture.indices[slot] = capture.frameCount++;
+
+    // The next slot holds the oldest readback, issued kCaptureRing - 1 captures ago
+    capture.next = (slot + 1) % kCaptureRing;
+    collectSlot(capture, capture.next);
+}
+
+void flushFrameCapture(FrameCapture& capture) {
+    for (int i = 0; i < kCaptureRing; i++) {
+        collectSlot(capture, (capture.next + i) % kCaptureRing);
+    }
+    std::unique_lock<std::mutex> lock(capture.mutex);
+    capture.space.wait(lock, [&capture]() { return capture.queue.empty() && !capture.busy; });
+}
+
+void destroyFrameCapture(FrameCapture& capture) {
+    if (!capture.worker.joinable()) {
+        return;
+    }
+    flushFrameCapture(capture);
+    {
+        std::lock_guard<std::mutex> lock(capture.mutex);
+        capture.stopping = true;
+        capture.wake.notify_one();
+    }
+    capture.worker.join();
+    glDeleteBuffers(kCaptureRing, capture.buffers);
+    if (capture.dropped > 0) {
+        std::cout << "Frame capture dropped " << capture.dropped << " of " << capture.frameCount
+                  << " frames while the consumer was busy\n";
+    }
+}
+
+std::string captureFramePath(const std::string& pattern, long long index) {
+    std::string path = pattern;
+    std::string number = std::to_string(index);
+    size_t first = path.find('#');
+    if (first == std::string::npos) {
+        size_t dot = path.find_last_of('.');
+        return path.insert(dot == std::string::npos ? path.size() : dot, "_" + number);
+    }
+    size_t last = path.find_first_not_of('#', first);
+    size_t digits = (last == std::string::npos ? path.size() : last) - first;
+    if (number.size() < digits) {
+        number.insert(0, digits - number.size(), '0');
+    }
+    return path.replace(first, digits, number);
+}
+
+bool writeCapturedFramePpm(const std::string& path, const CapturedFrame& frame) {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+    std::vector<unsigned char> rgb(static_cast<size_t>(frame.width) * frame.height * 3);
+    for (size_t i = 0, j = 0; j < rgb.size(); i += 4, j += 3) {
+        rgb[j] = frame.pixels[i];
+        rgb[j + 1] = frame.pixels[i + 1];
+        rgb[j + 2] = frame.pixels[i + 2];
+    }
+    file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    if (!file) {
+        std::cerr << "Failed to write " << path << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pixel pack buffers in the readback ring. A frame is mapped two frames after
+// its glReadPixels, when the GPU has long finished it.
+const int kCaptureRing = 3;
+
+// A captured image, RGBA8 with the top row first.
+struct CapturedFrame {
+    long long index = 0;  // capture counter, counting dropped frames too
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Receives frames on the capture thread, in capture order.
+typedef std::function<void(const CapturedFrame& frame)> CaptureConsumer;
+
+// Asynchronous readback of rendered frames: each capture reads into the next
+// buffer of a ring of pixel pack buffers, and the buffer filled two captures
+// earlier is mapped and copied out. Frames are flipped and handed to the
+// consumer on a thread of its own, so image writers, encoders or sockets run
+// beside the render loop instead of stalling it.
+struct FrameCapture {
+    GLuint buffers[kCaptureRing] = {};
+    GLsync fences[kCaptureRing] = {};
+    int widths[kCaptureRing] = {};
+    int heights[kCaptureRing] = {};
+    long long indices[kCaptureRing] = {};
+    size_t capacity[kCaptureRing] = {};  // bytes allocated in each buffer
+    int next = 0;
+    long long frameCount = 0;
+    long long dropped = 0;
+    bool dropWhenBehind = true;
+
+    CaptureConsumer consumer;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable space;
+    std::deque<CapturedFrame> queue;             // mapped frames waiting for the consumer
+    std::vector<std::vector<unsigned char>> spare;  // pixel storage returned by the consumer
+    bool busy = false;  // the consumer is handling a frame
+    bool stopping = false;
+};
+
+// Allocates the ring and starts the consumer thread. While the consumer is
+// behind by more than a few frames, new frames are dropped if dropWhenBehind
+// is set, and capture waits for it otherwise.
+void createFrameCapture(FrameCapture& capture, CaptureConsumer consumer, bool dropWhenBehind);
+
+// Queues a readback of the color buffer of a framebuffer (the back buffer for
+// 0) and passes on the frame captured two calls earlier.
+void captureFrame(FrameCapture& capture, GLuint framebuffer, int width, int height);
+
+// Passes on every readback still in the ring and waits until the consumer has
+// taken all frames.
+void flushFrameCapture(FrameCapture& capture);
+
+// Flushes, stops the consumer thread and deletes the buffers.
+void destroyFrameCapture(FrameCapture& capture);
+
+// Output file of a captured frame: a run of '#'s in the pattern is replaced
+// by the zero-padded frame index, or the index is appended before the extension.
+std::string captureFramePath(const std::string& pattern, long long index);
+
+// Writes a frame as a binary PPM, dropping alpha.
+bool writeCapturedFramePpm(const std::string& path, const CapturedFrame& frame);
+
+#endif  // FRAME_CAPTURE_H
@@ -0,0 +1,208 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Re-measure the GPU clock offset this often; the clocks drift apart slowly.
+const int64_t kCalibrationIntervalNs = 1000000000;
+
+// Small per-thread track numbers for the JSON, in order of first use.
+std::atomic<int> nextTrack{ 1 };
+thread_local int threadTrack = 0;
+
+int currentTrack() {
+    if (threadTrack == 0) {
+        threadTrack = nextTrack.fetch_add(1);
+    }
+    return threadTrack;
+}
+
+void pushEvent(FrameProfiler& profiler, const ProfileEvent& event) {
+    uint64_t index = profiler.written.fetch_add(1, std::memory_order_relaxed);
+    ProfileSlot& slot = profiler.slots[index % kProfileEventCapacity];
+    // Mark the slot as being rewritten; the fence keeps the event stores
+    // from becoming visible before the mark
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = event;
+    slot.seq.store(index + 1, std::memory_order_release);
+}
+
+void calibrateGpuClock(FrameProfiler& profiler) {
+    // GL_TIMESTAMP reads the GPU clock once earlier commands reach the server,
+    // without waiting for them to finish
+    GLint64 gpuNs = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNs);
+    int64_t now = profilerNow(profiler);
+    profiler.gpuOffsetNs = now - gpuNs;
+    profiler.lastCalibrationNs = now;
+}
+
+// JSON string contents of a zone name.
+std::string escaped(const char* name) {
+    std::string result;
+    for (const char* c = name; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            result += '\\';
+        }
+        result += *c;
+    }
+    return result;
+}
+
+}  // namespace
+
+void createFrameProfiler(FrameProfiler& profiler, bool enabled) {
+    profiler.enabled = enabled;
+    profiler.epoch = std::chrono::steady_clock::now();
+    if (!enabled) {
+        return;
+    }
+    profiler.slots = new ProfileSlot[kProfileEventCapacity];
+    profiler.written.store(0);
+    glGenQueries(2 * kProfileGpuZoneCapacity, profiler.queries);
+    calibrateGpuClock(profiler);
+}
+
+int64_t profilerNow(const FrameProfiler& profiler) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - profiler.epoch).count();
+}
+
+void recordCpuZone(FrameProfiler& profiler, const char* name, int64_t startNs) {
+    if (!profiler.enabled) {
+        return;
+    }
+    ProfileEvent event;
+    event.name = name;
+    event.startNs = startNs;
+    event.durationNs = profilerNow(profiler) - startNs;
+    event.track = currentTrack();
+    pushEvent(profiler, event);
+}
+
+int beginGpuZone(FrameProfiler& profiler, const char* name) {
+    if (!profiler.enabled) {
+        return -1;
+    }
+    int zone = profiler.nextGpuZone;
+    if (profiler.pending[zone]) {
+        pollFrameProfiler(profiler);
+        if (profiler.pending[zone]) {
+            return -1;
+        }
+    }
+    profiler.gpuNames[zone] = name;
+    profiler.pending[zone] = true;
+    profiler.ended[zone] = false;
+    profiler.nextGpuZone = (zone + 1) % kProfileGpuZoneCapacity;
+    glQueryCounter(profiler.queries[2 * zone], GL_TIMESTAMP);
+    return zone;
+}
+
+void endGpuZone(FrameProfiler& profiler, int zone) {
+    if (zone < 0) {
+        return;
+    }
+    glQueryCounter(profiler.queries[2 * zone + 1], GL_TIMESTAMP);
+    profiler.ended[zone] = true;
+}
+
+void pollFrameProfiler(FrameProfiler& profiler) {
+    if (!profiler.enabled) {
+        return;
+    }
+    // Collect in the order zones began and stop at the first one still open or
+    // unfinished. Its end query was issued last, so its availability covers both.
+    while (profiler.pending[profiler.oldestGpuZone] && profiler.ended[profiler.oldestGpuZone]) {
+        int zone = profiler.oldestGpuZone;
+        GLint available = 0;
+        glGetQueryObjectiv(profiler.queries[2 * zone + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 beginNs = 0;
+        GLuint64 endNs = 0;
+        glGetQueryObjectui64v(profiler.queries[2 * zone], GL_QUERY_RESULT, &beginNs);
+        glGetQueryObjectui64v(profiler.queries[2 * zone + 1], GL_QUERY_RESULT, &endNs);
+        ProfileEvent event;
+        event.name = profiler.gpuNames[zone];
+        event.startNs = static_cast<int64_t>(beginNs) + profiler.gpuOffsetNs;
+        event.durationNs = static_cast<int64_t>(endNs - beginNs);
+        event.track = 0;
+        pushEvent(profiler, event);
+        profiler.pending[zone] = false;
+        profiler.oldestGpuZone = (zone + 1) % kProfileGpuZoneCapacity;
+    }
+    if (profilerNow(profiler) - profiler.lastCalibrationNs > kCalibrationIntervalNs) {
+        calibrateGpuClock(profiler);
+    }
+}
+
+bool writeFrameProfile(FrameProfiler& profiler, const std::string& path) {
+    if (!profiler.enabled) {
+        return false;
+    }
+    pollFrameProfiler(profiler);
+
+    // Copy out every slot that holds the generation it should; slots being
+    // rewritten concurrently are skipped
+    uint64_t written = profiler.written.load(std::memory_order_acquire);
+    uint64_t first = written > static_cast<uint64_t>(kProfileEventCapacity) ? written - kProfileEventCapacity : 0;
+    std::vector<ProfileEvent> events;
+    events.reserve(static_cast<size_t>(written - first));
+    int maxTrack = 0;
+    for (uint64_t index = first; index < written; index++) {
+        const ProfileSlot& slot = profiler.slots[index % kProfileEventCapacity];
+        if (slot.seq.load(std::memory_order_acquire) != index + 1) {
+            continue;
+        }
+        ProfileEvent event = slot.event;
+        // Orders the copy before the re-check, so a rewrite that overlapped it is seen
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != index + 1) {
+            continue;
+        }
+        events.push_back(event);
+        maxTrack = std::max(maxTrack, event.track);
+    }
+    std::sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+        return a.startNs < b.startNs;
+    });
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to write " << path << "\n";
+        return false;
+    }
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+    for (int track = 1; track <= maxTrack; track++) {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track
+             << ",\"args\":{\"name\":\"" << (track == 1 ? "Render thread" : "CPU worker") << "\"}}";
+    }
+    char times[64];
+    for (const ProfileEvent& event : events) {
+        // Chrome trace times are in microseconds
+        std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f",
+                      event.startNs * 1e-3, event.durationNs * 1e-3);
+        file << ",\n{\"name\":\"" << escaped(event.name) << "\",\"cat\":\"" << (event.track == 0 ? "gpu" : "cpu")
+             << "\",\"ph\":\"X\"," << times << ",\"pid\":1,\"tid\":" << event.track << "}";
+    }
+    file << "\n]}\n";
+    std::cout << "Frame profile of " << events.size() << " events written to " << path << "\n";
+    return true;
+}
+
+void destroyFrameProfiler(FrameProfiler& profiler) {
+    if (profiler.enabled) {
+        glDeleteQueries(2 * kProfileGpuZoneCapacity, profiler.queries);
+        delete[] profiler.slots;
+    }
+    profiler.slots = nullptr;
+    profiler.enabled = false;
+}
@@ -0,0 +1,90 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <GL/glew.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Events kept by the profiler; once full the oldest are overwritten.
+const int kProfileEventCapacity = 1 << 14;
+
+// GPU zones whose timestamps may be in flight at once.
+const int kProfileGpuZoneCapacity = 64;
+
+// One complete zone on the profiler's clock, in nanoseconds since it was created.
+struct ProfileEvent {
+    const char* name = nullptr;  // must outlive the profiler, e.g. a string literal
+    int64_t startNs = 0;
+    int64_t durationNs = 0;
+    int track = 0;               // 0 for the GPU, otherwise the recording CPU thread
+};
+
+// Ring slot. seq is written last and tells a reader which generation the slot
+// holds, so recording never takes a lock and a dump skips torn slots.
+struct ProfileSlot {
+    ProfileEvent event;
+    std::atomic<uint64_t> seq{ 0 };
+};
+
+// Timeline of CPU zones and GPU passes written out as Chrome trace event
+// JSON, readable by chrome://tracing and the Perfetto UI. CPU zones come from
+// the steady clock, GPU zones from pairs of GL_TIMESTAMP queries that are
+// collected without waiting and moved onto the CPU clock. When disabled every
+// call returns immediately.
+struct FrameProfiler {
+    bool enabled = false;
+    std::chrono::steady_clock::time_point epoch;
+    ProfileSlot* slots = nullptr;  // kProfileEventCapacity entries
+    std::atomic<uint64_t> written{ 0 };
+
+    // Timestamp query pairs, used in ring order
+    GLuint queries[2 * kProfileGpuZoneCapacity] = {};
+    const char* gpuNames[kProfileGpuZoneCapacity] = {};
+    bool pending[kProfileGpuZoneCapacity] = {};
+    bool ended[kProfileGpuZoneCapacity] = {};  // end timestamp issued
+    int oldestGpuZone = 0;
+    int nextGpuZone = 0;
+    int64_t gpuOffsetNs = 0;       // profiler time minus GPU time
+    int64_t lastCalibrationNs = 0;
+};
+
+void createFrameProfiler(FrameProfiler& profiler, bool enabled);
+
+// Nanoseconds since the profiler was created.
+int64_t profilerNow(const FrameProfiler& profiler);
+
+// Records a CPU zone that started at startNs (from profilerNow) and ends now.
+// Safe to call from any thread.
+void recordCpuZone(FrameProfiler& profiler, const char* name, int64_t startNs);
+
+// Brackets the GPU commands issued in between with timestamp queries. Unlike
+// GL_TIME_ELAPSED queries GPU zones may nest. beginGpuZone returns -1, and the
+// zone is dropped, when kProfileGpuZoneCapacity zones are still in flight.
+int beginGpuZone(FrameProfiler& profiler, const char* name);
+void endGpuZone(FrameProfiler& profiler, int zone);
+
+// Moves finished GPU zones into the event ring without waiting. Call once a
+// frame; also re-measures the offset between the GPU and CPU clocks.
+void pollFrameProfiler(FrameProfiler& profiler);
+
+// Writes the recorded events to 'path' as Chrome trace event JSON.
+bool writeFrameProfile(FrameProfiler& profiler, const std::string& path);
+
+void destroyFrameProfiler(FrameProfiler& profiler);
+
+// Scoped CPU zone: records from construction to the end of the enclosing block.
+struct ProfileZone {
+    FrameProfiler& profiler;
+    const char* name;
+    int64_t startNs;
+
+    ProfileZone(FrameProfiler& profiler, const char* name)
+        : profiler(profiler), name(name), startNs(profilerNow(profiler)) {}
+    ~ProfileZone() { recordCpuZone(profiler, name, startNs); }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#endif  // FRAME_PROFILER_H
@@ -0,0 +1,154 @@
+#include "GpuBvh.h"
+#include "Shader.h"
+#include <algorithm>
+
+namespace {
+
+const int kGroupSize = 256;  // local_size_x of every kernel
+const int kRadixBits = 4;
+const int kRadixSize = 1 << kRadixBits;
+const int kKeyBits = 32;     // 8 passes cover the 30-bit codes and end in keys[0]
+
+GLuint createKernel(const std::string& source, const char* define) {
+    return createComputeProgramFromSource(addShaderDefines(source, { define }));
+}
+
+GLuint createStorage(size_t bytes) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(bytes, 16), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+
+void setMeshUniforms(GLuint program, const SceneBuffers& buffers, int triangleBase, int count) {
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uScenePrims"), 0);
+    glUniform1i(glGetUniformLocation(program, "uTriangleOffset"), buffers.triangleOffset);
+    glUniform1i(glGetUniformLocation(program, "uTriangleBase"), triangleBase);
+    glUniform1i(glGetUniformLocation(program, "uCount"), count);
+}
+
+}  // namespace
+
+bool gpuBvhSupported() {
+    return GLEW_VERSION_4_3 != 0;
+}
+
+void createGpuBvhBuilder(GpuBvhBuilder& builder, const Scene& scene) {
+    std::string source = readFile("lbvh_shader.glsl");
+    builder.centroidProgram = createKernel(source, "LBVH_CENTROID_BOUNDS");
+    builder.mortonProgram = createKernel(source, "LBVH_MORTON");
+    builder.countProgram = createKernel(source, "LBVH_SORT_COUNT");
+    builder.scanProgram = createKernel(source, "LBVH_SORT_SCAN");
+    builder.scatterProgram = createKernel(source, "LBVH_SORT_SCATTER");
+    builder.hierarchyProgram = createKernel(source, "LBVH_HIERARCHY");
+    builder.fitProgram = createKernel(source, "LBVH_FIT");
+
+    for (const Mesh& mesh : scene.meshes) {
+        builder.capacity = std::max(builder.capacity, static_cast<int>(mesh.indices.size() / 3));
+    }
+    size_t n = builder.capacity;
+    size_t groups = (n + kGroupSize - 1) / kGroupSize;
+    for (int i = 0; i < 2; i++) {
+        builder.keys[i] = createStorage(n * sizeof(GLuint));
+        builder.values[i] = createStorage(n * sizeof(GLuint));
+    }
+    builder.histogram = createStorage(groups * kRadixSize * sizeof(GLuint));
+    builder.centroidBounds = createStorage(6 * sizeof(GLuint));
+    builder.children = createStorage(n * 2 * sizeof(GLint));
+    builder.parents = createStorage(n * 2 * sizeof(GLint));
+    builder.visits = createStorage(n * sizeof(GLuint));
+    builder.nodeBounds = createStorage(n * 2 * 2 * 4 * sizeof(float));
+}
+
+void buildGpuBvh(GpuBvhBuilder& builder, const SceneBuffers& buffers, const Scene& scene, int mesh) {
+    int count = static_cast<int>(scene.meshes[mesh].indices.size() / 3);
+    if (count < 2 || count > builder.capacity) {
+        return;
+    }
+    int triangleBase = buffers.triangleBases[mesh];
+    GLuint groups = (count + kGroupSize - 1) / kGroupSize;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, buffers.texture);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers.buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, builder.histogram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, builder.centroidBounds);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, builder.children);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, builder.parents);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, builder.visits);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, builder.nodeBounds);
+
+    // Centroid bounds start inverted: ordered min at the top, max at zero
+    const GLuint initialBounds[6] = { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0u, 0u, 0u };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, builder.centroidBounds);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(initialBounds), initialBounds);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    setMeshUniforms(builder.centroidProgram, buffers, triangleBase, count);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Morton codes into keys[0] / values[0]
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, builder.keys[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, builder.values[0]);
+    setMeshUniforms(builder.mortonProgram, buffers, triangleBase, count);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // LSD radix sort, 4 bits per pass: count, scan, scatter
+    for (int shift = 0; shift < kKeyBits; shift += kRadixBits) {
+        int in = (shift / kRadixBits) % 2;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, builder.keys[in]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, builder.values[in]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, builder.keys[1 - in]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, builder.values[1 - in]);
+
+        setMeshUniforms(builder.countProgram, buffers, triangleBase, count);
+        glUniform1ui(glGetUniformLocation(builder.countProgram, "uShift"), shift);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        setMeshUniforms(builder.scanProgram, buffers, triangleBase, count);
+        glUniform1ui(glGetUniformLocation(builder.scanProgram, "uHistogramSize"), groups * kRadixSize);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        setMeshUniforms(builder.scatterProgram, buffers, triangleBase, count);
+        glUniform1ui(glGetUniformLocation(builder.scatterProgram, "uShift"), shift);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Sorted keys are back in keys[0]; link the internal nodes, then fit bounds
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, builder.keys[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, builder.values[0]);
+    setMeshUniforms(builder.hierarchyProgram, buffers, triangleBase, count);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    setMeshUniforms(builder.fitProgram, buffers, triangleBase, count);
+    glUniform1i(glGetUniformLocation(builder.fitProgram, "uBlasNodeOffset"), buffers.blasNodeOffset);
+    glUniform1i(glGetUniformLocation(builder.fitProgram, "uNodeBase"), buffers.blasRoots[mesh]);
+    glDispatchCompute(groups, 1, 1);
+
+    // The trace shader reads the nodes through the scene texture buffer
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void destroyGpuBvhBuilder(GpuBvhBuilder& builder) {
+    GLuint programs[] = { builder.centroidProgram, builder.mortonProgram, builder.countProgram,
+                          builder.scanProgram, builder.scatterProgram, builder.hierarchyProgram,
+                          builder.fitProgram };
+    for (GLuint program : programs) {
+        glDeleteProgram(program);
+    }
+    GLuint storage[] = { builder.keys[0], builder.keys[1], builder.values[0], builder.values[1],
+                         builder.histogram, builder.centroidBounds, builder.children,
+                         builder.parents, builder.visits, builder.nodeBounds };
+    glDeleteBuffers(10, storage);
+    builder = GpuBvhBuilder();
+}
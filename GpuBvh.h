@@ -0,0 +1,45 @@
+#ifndef GPU_BVH_H
+#define GPU_BVH_H
+
+#include "Scene.h"
+
+// Builds mesh BVHs on the GPU with the compute kernels in lbvh_shader.glsl
+// (needs GL 4.3). 30-bit Morton codes of the triangle centroids are
+// radix-sorted and turned into a linear BVH (Karras 2012) whose bounds are
+// fitted from the leaves up in parallel. The nodes are written straight into
+// the scene buffer in the layout the trace shader reads, so nothing is
+// uploaded or read back.
+struct GpuBvhBuilder {
+    GLuint centroidProgram = 0;
+    GLuint mortonProgram = 0;
+    GLuint countProgram = 0;
+    GLuint scanProgram = 0;
+    GLuint scatterProgram = 0;
+    GLuint hierarchyProgram = 0;
+    GLuint fitProgram = 0;
+    // Ping-pong key/value buffers of the radix sort
+    GLuint keys[2] = {};
+    GLuint values[2] = {};
+    GLuint histogram = 0;
+    GLuint centroidBounds = 0;
+    // Per-node scratch: children, parents, arrival counters, bounds
+    GLuint children = 0;
+    GLuint parents = 0;
+    GLuint visits = 0;
+    GLuint nodeBounds = 0;
+    int capacity = 0;  // triangles
+};
+
+// True if the current context can run the builder.
+bool gpuBvhSupported();
+
+// Compiles the kernels and sizes the scratch buffers for the scene's largest mesh.
+void createGpuBvhBuilder(GpuBvhBuilder& builder, const Scene& scene);
+
+// Rebuilds the BVH of one mesh from its triangles in the scene buffer, which
+// must be stored in mesh order (see updateSceneMeshes). Leaves hold one triangle.
+void buildGpuBvh(GpuBvhBuilder& builder, const SceneBuffers& buffers, const Scene& scene, int mesh);
+
+void destroyGpuBvhBuilder(GpuBvhBuilder& builder);
+
+#endif  // GPU_BVH_H
@@ -0,0 +1,58 @@
+#include "GpuTimer.h"
+
+void createGpuTimer(GpuTimer& timer) {
+    glGenQueries(kGpuTimerLatency, timer.queries);
+    for (int i = 0; i < kGpuTimerLatency; i++) {
+        timer.pending[i] = false;
+    }
+    timer.next = 0;
+    timer.active = -1;
+}
+
+void beginGpuTimer(GpuTimer& timer) {
+    if (timer.pending[timer.next]) {
+        // The GPU is more than kGpuTimerLatency frames behind; skip this measurement.
+        timer.active = -1;
+        return;
+    }
+    timer.active = timer.next;
+    glBeginQuery(GL_TIME_ELAPSED, timer.queries[timer.active]);
+}
+
+void endGpuTimer(GpuTimer& timer, int tag) {
+    if (timer.active < 0) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    timer.pending[timer.active] = true;
+    timer.tags[timer.active] = tag;
+    timer.next = (timer.active + 1) % kGpuTimerLatency;
+    timer.active = -1;
+}
+
+bool pollGpuTimer(GpuTimer& timer, GpuTimerResult& result) {
+    // Slots are filled in ring order, so the oldest pending one follows the newest.
+    for (int i = 0; i < kGpuTimerLatency; i++) {
+        int slot = (timer.next + i) % kGpuTimerLatency;
+        if (!timer.pending[slot]) {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(timer.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(timer.queries[slot], GL_QUERY_RESULT, &elapsedNs);
+        timer.pending[slot] = false;
+        result.ms = static_cast<double>(elapsedNs) / 1.0e6;
+        result.tag = timer.tags[slot];
+        return true;
+    }
+    return false;
+}
+
+void destroyGpuTimer(GpuTimer& timer) {
+    glDeleteQueries(kGpuTimerLatency, timer.queries);
+    timer = GpuTimer();
+}
@@ -0,0 +1,42 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+
+// Number of frames a timer result may lag behind before its query is reused.
+// Results are read only once available, so measuring never stalls the pipeline.
+const int kGpuTimerLatency = 4;
+
+// A finished measurement.
+struct GpuTimerResult {
+    double ms = 0.0;
+    int tag = 0;  // tag passed to endGpuTimer() for the section
+};
+
+// Non-blocking GPU duration measurement built on a ring of GL_TIME_ELAPSED queries.
+// Only one GL_TIME_ELAPSED query may be active at a time, so timed sections must not nest.
+struct GpuTimer {
+    GLuint queries[kGpuTimerLatency] = {};
+    bool pending[kGpuTimerLatency] = {};
+    int tags[kGpuTimerLatency] = {};
+    int next = 0;
+    int active = -1;  // slot opened by beginGpuTimer(), -1 if the section is skipped
+};
+
+// Allocates the query objects.
+void createGpuTimer(GpuTimer& timer);
+
+// Starts timing the GPU commands issued until endGpuTimer(). If the ring slot
+// is still waiting for an old result the section is skipped. The tag is
+// handed back with the result, e.g. to record how much work was measured.
+void beginGpuTimer(GpuTimer& timer);
+void endGpuTimer(GpuTimer& timer, int tag = 0);
+
+// Hands back the oldest finished result without waiting. Returns false once
+// no further result is available; call it in a loop so none is skipped.
+bool pollGpuTimer(GpuTimer& timer, GpuTimerResult& result);
+
+// Deletes the query objects.
+void destroyGpuTimer(GpuTimer& timer);
+
+#endif  // GPU_TIMER_H
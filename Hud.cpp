@@ -0,0 +1,282 @@
+#include "Hud.h"
+#include "Shader.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// 5x7 glyphs for ASCII 32 ('space') to 95 ('_'), one byte per column with
+// the top row in bit 0. Lowercase letters are drawn with the uppercase glyphs.
+const unsigned char kFont5x7[64][5] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },
+    { 0x14, 0x7F, 0x14, 0x7F, 0x14 }, { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+    { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1C, 0x22, 0x41, 0x00 },
+    { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x08, 0x2A, 0x1C, 0x2A, 0x08 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+    { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },
+    { 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+    { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 }, { 0x18, 0x14, 0x12, 0x7F, 0x10 },
+    { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x36, 0x36, 0x00, 0x00 },
+    { 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x00, 0x08, 0x14, 0x22, 0x41 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+    { 0x41, 0x22, 0x14, 0x08, 0x00 }, { 0x02, 0x01, 0x51, 0x09, 0x06 }, { 0x32, 0x49, 0x79, 0x41, 0x3E },
+    { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+    { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x01, 0x01 },
+    { 0x3E, 0x41, 0x41, 0x51, 0x32 }, { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+    { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 }, { 0x7F, 0x40, 0x40, 0x40, 0x40 },
+    { 0x7F, 0x02, 0x04, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+    { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 },
+    { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+    { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x7F, 0x20, 0x18, 0x20, 0x7F }, { 0x63, 0x14, 0x08, 0x14, 0x63 },
+    { 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x00, 0x7F, 0x41, 0x41 },
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x41, 0x41, 0x7F, 0x00, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 },
+    { 0x40, 0x40, 0x40, 0x40, 0x40 },
+};
+
+// Atlas layout: one row of 6x8 cells, the glyphs followed by a solid cell.
+const int kGlyphCount = 64;
+const int kCellWidth = 6;
+const int kCellHeight = 8;
+const int kSolidCell = kGlyphCount;
+const int kAtlasWidth = (kGlyphCount + 1) * kCellWidth;
+
+// Window pixels per font texel, and the resulting character advance.
+const float kTextScale = 2.0f;
+const float kCharWidth = kCellWidth * kTextScale;
+const float kLineHeight = (kCellHeight + 2) * kTextScale;
+
+const float kPanelMargin = 8.0f;
+const float kGraphHeight = 64.0f;
+
+struct Color {
+    float r, g, b, a;
+};
+
+const Color kTextColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+const Color kDimColor = { 0.5f, 0.5f, 0.5f, 1.0f };
+const Color kOnColor = { 0.3f, 1.0f, 0.4f, 1.0f };
+const Color kPanelColor = { 0.0f, 0.0f, 0.0f, 0.6f };
+const Color kGuideColor = { 1.0f, 1.0f, 1.0f, 0.35f };
+
+void addQuad(std::vector<float>& vertices, float x0, float y0, float x1, float y1,
+             float u0, float v0, float u1, float v1, const Color& color) {
+    const float corners[6][4] = {
+        { x0, y0, u0, v0 }, { x1, y0, u1, v0 }, { x1, y1, u1, v1 },
+        { x0, y0, u0, v0 }, { x1, y1, u1, v1 }, { x0, y1, u0, v1 },
+    };
+    for (const float* corner : corners) {
+        vertices.insert(vertices.end(), { corner[0], corner[1], corner[2], corner[3],
+                                          color.r, color.g, color.b, color.a });
+    }
+}
+
+void addRect(std::vector<float>& vertices, float x0, float y0, float x1, float y1, const Color& color) {
+    // Sample the middle of the solid cell so filtering never reaches a glyph
+    float u = (kSolidCell * kCellWidth + kCellWidth * 0.5f) / kAtlasWidth;
+    addQuad(vertices, x0, y0, x1, y1, u, 0.5f, u, 0.5f, color);
+}
+
+// Appends a line of text and returns the x coordinate after its last character.
+float addText(std::vector<float>& vertices, float x, float y, const std::string& text, const Color& color) {
+    for (char c : text) {
+        if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+        int glyph = (c >= 32 && c < 32 + kGlyphCount) ? c - 32 : '?' - 32;
+        float u0 = static_cast<float>(glyph * kCellWidth) / kAtlasWidth;
+        float u1 = static_cast<float>(glyph * kCellWidth + kCellWidth) / kAtlasWidth;
+        addQuad(vertices, x, y, x + kCharWidth, y + kCellHeight * kTextScale, u0, 0.0f, u1, 1.0f, color);
+        x += kCharWidth;
+    }
+    return x;
+}
+
+std::string formatMs(double ms) {
+    if (ms < 0.0) {
+        return "-";
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), ms < 10.0 ? "%.2f" : "%.1f", ms);
+    return text;
+}
+
+// Takes the finished timings of a pass; the newest one is shown.
+void collectHudPass(Hud& hud, int pass) {
+    GpuTimerResult result;
+    while (pollGpuTimer(hud.passTimers[pass], result)) {
+        hud.passMs[pass] = result.ms;
+    }
+}
+
+}  // namespace
+
+void createHud(Hud& hud, bool visible) {
+    hud.visible = visible;
+    hud.program = createShaderProgram("hud_vertex_shader.glsl", "hud_fragment_shader.glsl");
+
+    // Unpack the font into a one-channel atlas
+    std::vector<unsigned char> atlas(kAtlasWidth * kCellHeight, 0);
+    for (int glyph = 0; glyph < kGlyphCount; glyph++) {
+        for (int column = 0; column < 5; column++) {
+            for (int row = 0; row < 7; row++) {
+                if (kFont5x7[glyph][column] & (1 << row)) {
+                    atlas[row * kAtlasWidth + glyph * kCellWidth + column] = 255;
+                }
+            }
+        }
+    }
+    for (int row = 0; row < kCellHeight; row++) {
+        for (int column = 0; column < kCellWidth; column++) {
+            atlas[row * kAtlasWidth + kSolidCell * kCellWidth + column] = 255;
+        }
+    }
+    glGenTextures(1, &hud.fontTexture);
+    glBindTexture(GL_TEXTURE_2D, hud.fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, kAtlasWidth, kCellHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Position, atlas coordinates and color per vertex
+    glGenVertexArrays(1, &hud.vao);
+    glGenBuffers(1, &hud.vbo);
+    glBindVertexArray(hud.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, hud.vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(4 * sizeof(float)));
+    glBindVertexArray(0);
+
+    for (int pass = 0; pass < kHudPassCount; pass++) {
+        createGpuTimer(hud.passTimers[pass]);
+    }
+}
+
+void recordHudFrame(Hud& hud, float frameMs) {
+    hud.frameMs[hud.nextFrame] = frameMs;
+    hud.nextFrame = (hud.nextFrame + 1) % kHudHistory;
+    hud.frameCount = std::min(hud.frameCount + 1, kHudHistory);
+}
+
+void beginHudPass(Hud& hud, HudPass pass) {
+    if (hud.visible) {
+        // Collect first so a result is never left behind a restarted timer
+        collectHudPass(hud, pass);
+        beginGpuTimer(hud.passTimers[pass]);
+    }
+}
+
+void endHudPass(Hud& hud, HudPass pass) {
+    if (hud.visible) {
+        endGpuTimer(hud.passTimers[pass]);
+    }
+}
+
+void drawHud(Hud& hud, const HudStats& stats, int width, int height) {
+    if (!hud.visible || hud.frameCount == 0) {
+        return;
+    }
+    for (int pass = 0; pass < kHudPassCount; pass++) {
+        collectHudPass(hud, pass);
+    }
+    hud.passMs[kHudPassTrace] = stats.traceMs;
+
+    // Frame time statistics over the history
+    std::vector<float> sorted(hud.frameMs, hud.frameMs + hud.frameCount);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (float ms : sorted) {
+        sum += ms;
+    }
+    float latestMs = hud.frameMs[(hud.nextFrame + kHudHistory - 1) % kHudHistory];
+    float p99Ms = sorted[std::min(hud.frameCount - 1, hud.frameCount * 99 / 100)];
+
+    std::vector<float>& vertices = hud.vertices;
+    vertices.clear();
+    float panelWidth = std::max(kHudHistory * 2.0f, 64.0f * kCharWidth);
+    float x = kPanelMargin * 2.0f;
+    float y = kPanelMargin * 2.0f;
+    addRect(vertices, kPanelMargin, kPanelMargin, kPanelMargin * 3.0f + panelWidth,
+            kPanelMargin * 3.0f + kGraphHeight + 4.0f * kLineHeight, kPanelColor);
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "FRAME %s MS  AVG %s  P99 %s  (%.0f FPS)", formatMs(latestMs).c_str(),
+                  formatMs(sum / hud.frameCount).c_str(), formatMs(p99Ms).c_str(),
+                  sum > 0.0 ? 1000.0 * hud.frameCount / sum : 0.0);
+    addText(vertices, x, y, line, kTextColor);
+    y += kLineHeight;
+
+    // Rolling graph, oldest frame on the left. The scale fits twice the frame
+    // budget or the slowest frame, whichever is larger.
+    float graphMaxMs = std::max(2.0f * stats.targetMs, sorted.back());
+    float barWidth = panelWidth / kHudHistory;
+    for (int i = 0; i < hud.frameCount; i++) {
+        int slot = (hud.nextFrame + kHudHistory - hud.frameCount + i) % kHudHistory;
+        float ms = hud.frameMs[slot];
+        Color color = ms <= stats.targetMs ? kOnColor
+            : ms <= 2.0f * stats.targetMs ? Color{ 1.0f, 0.85f, 0.2f, 1.0f } : Color{ 1.0f, 0.3f, 0.2f, 1.0f };
+        float barHeight = std::min(ms / graphMaxMs, 1.0f) * kGraphHeight;
+        float barX = x + (kHudHistory - hud.frameCount + i) * barWidth;
+        addRect(vertices, barX, y + kGraphHeight - barHeight, barX + barWidth, y + kGraphHeight, color);
+    }
+    float budgetY = y + kGraphHeight - stats.targetMs / graphMaxMs * kGraphHeight;
+    addRect(vertices, x, budgetY, x + panelWidth, budgetY + 1.0f, kGuideColor);
+    y += kGraphHeight + kPanelMargin;
+
+    const char* passNames[kHudPassCount] = { "RASTER", "TRACE", "RESOLVE", "UPSCALE" };
+    float textX = addText(vertices, x, y, "GPU MS", kDimColor);
+    for (int pass = 0; pass < kHudPassCount; pass++) {
+        textX = addText(vertices, textX, y, std::string("  ") + passNames[pass] + " ", kDimColor);
+        textX = addText(vertices, textX, y, formatMs(hud.passMs[pass]), kTextColor);
+    }
+    y += kLineHeight;
+
+    std::snprintf(line, sizeof(line), "%dX%d (%d%%)  SPP %.0f  PRIMARY MRAYS/S %.1f  ACTIVE %d%%",
+                  stats.renderWidth, stats.renderHeight, static_cast<int>(stats.renderScale * 100.0f + 0.5f),
+                  stats.effectiveSpp, stats.primaryMrays, static_cast<int>(stats.activeFraction * 100.0f + 0.5f));
+    addText(vertices, x, y, line, kTextColor);
+    y += kLineHeight;
+
+    // Enabled features bright, disabled ones dimmed; wraps at the panel edge
+    textX = x;
+    for (const std::pair<const char*, bool>& toggle : stats.toggles) {
+        float nameWidth = (std::strlen(toggle.first) + 1) * kCharWidth;
+        if (textX + nameWidth > x + panelWidth) {
+            break;
+        }
+        textX = addText(vertices, textX, y, toggle.first, toggle.second ? kOnColor : kDimColor) + kCharWidth;
+    }
+
+    glViewport(0, 0, width, height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(hud.program);
+    glUniform2f(glGetUniformLocation(hud.program, "uViewport"), static_cast<float>(width), static_cast<float>(height));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hud.fontTexture);
+    glUniform1i(glGetUniformLocation(hud.program, "uFont"), 0);
+    glBindVertexArray(hud.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, hud.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size() / 8));
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+}
+
+void destroyHud(Hud& hud) {
+    for (int pass = 0; pass < kHudPassCount; pass++) {
+        destroyGpuTimer(hud.passTimers[pass]);
+    }
+    glDeleteProgram(hud.program);
+    glDeleteTextures(1, &hud.fontTexture);
+    glDeleteBuffers(1, &hud.vbo);
+    glDeleteVertexArrays(1, &hud.vao);
+    hud = Hud();
+}
@@ -0,0 +1,69 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include "GpuTimer.h"
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+// Frames kept for the frame-time graph and statistics.
+const int kHudHistory = 240;
+
+// GPU passes broken down by the HUD.
+enum HudPass {
+    kHudPassRaster = 0,   // hybrid-mode G-buffer rasterization
+    kHudPassTrace = 1,    // path tracing, timed by the caller's trace timer
+    kHudPassResolve = 2,  // temporal reprojection or SVGF
+    kHudPassUpscale = 3,
+    kHudPassCount = 4
+};
+
+// Values the HUD shows that only the render loop knows.
+struct HudStats {
+    double traceMs = -1.0;      // latest GPU trace time, -1 if unknown
+    int renderWidth = 0;
+    int renderHeight = 0;
+    float renderScale = 1.0f;
+    float effectiveSpp = 0.0f;  // samples accumulated in the displayed pixels
+    double primaryMrays = 0.0;  // camera rays per second of GPU trace time, in millions
+    float activeFraction = 1.0f;  // tiles adaptive sampling still traces
+    float targetMs = 16.6f;     // frame budget, drawn as a guide line in the graph
+    std::vector<std::pair<const char*, bool>> toggles;  // feature name and state
+};
+
+// In-window performance overlay: current, average and 99th percentile frame
+// time, a rolling frame-time graph, GPU time per pass, sample and ray rates,
+// the share of tiles adaptive sampling still traces and the active toggles.
+// Text uses a built-in 5x7 bitmap font; everything is drawn as textured quads
+// by one small program.
+struct Hud {
+    bool visible = false;
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint fontTexture = 0;
+    float frameMs[kHudHistory] = {};
+    int frameCount = 0;  // frames recorded, up to kHudHistory
+    int nextFrame = 0;
+    GpuTimer passTimers[kHudPassCount];
+    double passMs[kHudPassCount] = { -1.0, -1.0, -1.0, -1.0 };
+    std::vector<float> vertices;  // rebuilt every frame
+};
+
+// Compiles the HUD program and uploads the font atlas.
+void createHud(Hud& hud, bool visible);
+
+// Adds one frame interval to the history.
+void recordHudFrame(Hud& hud, float frameMs);
+
+// Time the GPU commands of a pass; does nothing while the HUD is hidden.
+// Passes must not nest and must not overlap other GL_TIME_ELAPSED queries.
+void beginHudPass(Hud& hud, HudPass pass);
+void endHudPass(Hud& hud, HudPass pass);
+
+// Draws the overlay over the currently bound framebuffer of the given size.
+void drawHud(Hud& hud, const HudStats& stats, int width, int height);
+
+void destroyHud(Hud& hud);
+
+#endif  // HUD_H
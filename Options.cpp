@@ -0,0 +1,237 @@
+#include "Options.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --scene NAME        scene to render: default, meshes, instances, animated\n"
+              << "                      (default: default)\n"
+              << "  --hybrid            rasterize triangle meshes for primary visibility\n"
+              << "  --gpu-bvh           build animated mesh BVHs on the GPU (needs OpenGL 4.3)\n"
+              << "  --no-wide-bvh       trace static meshes through binary BVHs\n"
+              << "  --stackless         walk binary BVHs without a per-ray stack\n"
+              << "  --bvh-benchmark     alternate stack and stackless traversal, report GPU times\n"
+              << "  --trace-stats [F]   record per-pixel trace cost, write a CSV histogram to F on exit\n"
+              << "                      (default: trace_stats.csv)\n"
+              << "  --batch JOBFILE     render the camera sequence of a job file to EXR and exit\n"
+              << "  --workers A,B,...   render the --batch job on these daemon addresses\n"
+              << "  --daemon ADDRESS    serve render requests on a Unix socket path or TCP host:port\n"
+              << "                      (\":port\" listens on loopback only)\n"
+              << "  --daemon-token T    token daemon clients must send; required beyond loopback\n"
+              << "  --capture [PATTERN] write displayed frames to numbered PPM files (F12 toggles)\n"
+              << "                      (default: capture_####.ppm)\n"
+              << "  --video OUT         stream fixed-timestep frames as Y4M to OUT, or to a command\n"
+              << "                      given as \"|command\" (e.g. \"|ffmpeg -i - out.mp4\")\n"
+              << "  --video-fps N       frame rate of the video timestep (default 30)\n"
+              << "  --video-frames N    close after N video frames (default: on Esc)\n"
+              << "  --hud               start with the performance overlay shown (F1 toggles it)\n"
+              << "  --profile [F]       record a CPU/GPU frame timeline, write Chrome trace JSON to F\n"
+              << "                      (default: frame_profile.json)\n"
+              << "  --render-size WxH   trace at a fixed internal resolution\n"
+              << "  --render-scale S    trace at S times the window resolution (default 1.0)\n"
+              << "  --target-ms MS      GPU frame-time budget for dynamic resolution (default 16.6)\n"
+              << "  --no-dynamic-res    keep the render scale fixed\n"
+              << "  --no-temporal       disable temporal reprojection of previous frames\n"
+              << "  --svgf              start with the SVGF denoiser enabled\n"
+              << "  --slice-ms MS       GPU time per frame for tiled heavy modes (default: --target-ms)\n"
+              << "  --no-slicing        trace heavy modes in a single full-screen pass\n"
+              << "  --no-preview-lod    keep full quality while the camera moves\n"
+              << "  --adaptive [E]      stop sampling converged pixels (relative error E, default 0.01)\n"
+              << "  --idle-spp N        stop redrawing a still image at N samples per pixel (default 1024)\n"
+              << "  --no-idle           keep redrawing converged images\n"
+              << "  --fov DEGREES       vertical field of view (default 45)\n"
+              << "  --sharpen S         sharpening strength of the upscale pass (default 0)\n";
+}
+
+}  // namespace
+
+bool parseOptions(int argc, char** argv, AppOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+        if (std::strcmp(arg, "--scene") == 0 && value) {
+            options.scene = value;
+            if (options.scene != "default" && options.scene != "meshes" &&
+                options.scene != "instances" && options.scene != "animated") {
+                std::cerr << "Unknown scene: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--hybrid") == 0) {
+            options.hybridRaster = true;
+        }
+        else if (std::strcmp(arg, "--gpu-bvh") == 0) {
+            options.gpuBvh = true;
+        }
+        else if (std::strcmp(arg, "--render-size") == 0 && value) {
+            if (std::sscanf(value, "%dx%d", &options.renderWidth, &options.renderHeight) != 2 ||
+                options.renderWidth <= 0 || options.renderHeight <= 0) {
+                std::cerr << "Invalid render size: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--render-scale") == 0 && value) {
+            options.renderScale = static_cast<float>(std::atof(value));
+            if (options.renderScale <= 0.0f) {
+                std::cerr << "Invalid render scale: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--target-ms") == 0 && value) {
+            options.targetMs = static_cast<float>(std::atof(value));
+            if (options.targetMs <= 0.0f) {
+                std::cerr << "Invalid frame-time target: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--no-dynamic-res") == 0) {
+            options.dynamicResolution = false;
+        }
+        else if (std::strcmp(arg, "--no-temporal") == 0) {
+            options.temporalReprojection = false;
+        }
+        else if (std::strcmp(arg, "--svgf") == 0) {
+            options.svgf = true;
+        }
+        else if (std::strcmp(arg, "--slice-ms") == 0 && value) {
+            options.sliceMs = static_cast<float>(std::atof(value));
+            if (options.sliceMs <= 0.0f) {
+                std::cerr << "Invalid time slice: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--idle-spp") == 0 && value) {
+            options.idleSpp = static_cast<float>(std::atof(value));
+            if (options.idleSpp < 1.0f) {
+                std::cerr << "Invalid idle sample count: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--no-idle") == 0) {
+            options.idleThrottle = false;
+        }
+        else if (std::strcmp(arg, "--no-slicing") == 0) {
+            options.timeSlicing = false;
+        }
+        else if (std::strcmp(arg, "--no-wide-bvh") == 0) {
+            options.wideBvh = false;
+        }
+        else if (std::strcmp(arg, "--stackless") == 0) {
+            options.stacklessBvh = true;
+        }
+        else if (std::strcmp(arg, "--bvh-benchmark") == 0) {
+            options.bvhBenchmark = true;
+        }
+        else if (std::strcmp(arg, "--trace-stats") == 0) {
+            options.traceStats = true;
+            // The file name is optional
+            if (value && value[0] != '-') {
+                options.traceStatsPath = value;
+                i++;
+            }
+        }
+        else if (std::strcmp(arg, "--batch") == 0 && value) {
+            options.batchJobPath = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--workers") == 0 && value) {
+            std::string list = value;
+            for (size_t start = 0; start <= list.size();) {
+                size_t comma = std::min(list.find(',', start), list.size());
+                if (comma > start) {
+                    options.workers.push_back(list.substr(start, comma - start));
+                }
+                start = comma + 1;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--daemon") == 0 && value) {
+            options.daemonAddress = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--daemon-token") == 0 && value) {
+            options.daemonToken = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--capture") == 0) {
+            options.capture = true;
+            // The pattern is optional
+            if (value && value[0] != '-') {
+                options.capturePattern = value;
+                i++;
+            }
+        }
+        else if (std::strcmp(arg, "--video") == 0 && value) {
+            options.videoPath = value;
+            i++;
+        }
+        else if (std::strcmp(arg, "--video-fps") == 0 && value) {
+            options.videoFps = std::atoi(value);
+            if (options.videoFps <= 0) {
+                std::cerr << "Invalid video frame rate: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--video-frames") == 0 && value) {
+            options.videoFrames = std::atoi(value);
+            if (options.videoFrames < 0) {
+                std::cerr << "Invalid video frame count: " << value << "\n";
+                return false;
+            }
+            i++;
+        }
+        else if (std::strcmp(arg, "--hud") == 0) {
+            options.hud = true;
+        }
+        else if (std::strcmp(arg, "--profile") == 0) {
+            options.profile = true;
+            // The file name is optional
+            if (value && value[0] != '-') {
+                options.profilePath = value;
+                i++;
+            }
+        }
+        else if (std::strcmp(arg, "--no-preview-lod") == 0) {
+            options.previewLod = false;
+        }
+        else if (std::strcmp(arg, "--adaptive") == 0) {
+            options.adaptiveSampling = true;
+            // The threshold is optional
+            if (value && value[0] != '-') {
+                options.adaptiveThreshold = static_cast<float>(std::atof(value));
+                if (options.adaptiveThreshold <= 0.0f) {
+                    std::cerr << "Invalid adaptive sampling threshold: " << value << "\n";
+                    return false;
+                }
+                i++;
+            }
+        }
+        else if (std::strcmp(arg, "--fov") == 0 && value) {
+            options.fovDegrees = static_cast<float>(std::atof(value));
+            i++;
+        }
+        else if (std::strcmp(arg, "--sharpen") == 0 && value) {
+            options.sharpness = static_cast<float>(std::atof(value));
+            i++;
+        }
+        else {
+            std::cerr << "Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
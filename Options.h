@@ -0,0 +1,89 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+
+// Command-line configuration of the renderer.
+struct AppOptions {
+    // Fixed internal render resolution. 0 means "follow the window, scaled by renderScale".
+    int renderWidth = 0;
+    int renderHeight = 0;
+    // Internal resolution as a fraction of the window framebuffer.
+    float renderScale = 1.0f;
+    // Scene to load: "default", "meshes", "instances" or "animated".
+    std::string scene = "default";
+    // Rasterize triangle meshes for primary visibility and trace only the bounces.
+    bool hybridRaster = false;
+    // Rebuild animated mesh BVHs on the GPU with compute shaders (requests a GL 4.3 context).
+    bool gpuBvh = false;
+    // Collapse static mesh BVHs into compressed eight-wide trees.
+    bool wideBvh = true;
+    // Walk binary BVHs with the stackless restart-trail shader permutation.
+    bool stacklessBvh = false;
+    // Alternate the stack and stackless permutations every frame and report
+    // their GPU trace times on exit.
+    bool bvhBenchmark = false;
+    // Trace with the instrumented shader permutation that records per-pixel
+    // cost counters, and write their histogram to traceStatsPath on exit.
+    bool traceStats = false;
+    std::string traceStatsPath = "trace_stats.csv";
+    // Record CPU zones and GPU pass timestamps, written to profilePath as
+    // Chrome trace JSON on 'J' and on exit.
+    bool profile = false;
+    std::string profilePath = "frame_profile.json";
+    // Start with the performance overlay shown (F1 toggles it).
+    bool hud = false;
+    // Stop redrawing and wait for input once a still image reaches idleSpp
+    // samples per pixel or adaptive sampling reports it converged.
+    bool idleThrottle = true;
+    float idleSpp = 1024.0f;
+    // Write every displayed frame (before the HUD is drawn) to numbered PPM
+    // files through asynchronous readback; F12 toggles it.
+    bool capture = false;
+    std::string capturePattern = "capture_####.ppm";
+    // Stream frames rendered at a fixed timestep of 1/videoFps seconds as
+    // YUV4MPEG2 to videoPath, or to an encoder command given as "|command"
+    // (see VideoOutput.h). Stops after videoFrames frames unless 0.
+    std::string videoPath;
+    int videoFps = 30;
+    int videoFrames = 0;
+    // Render the job file offline instead of opening the interactive viewer
+    // (see BatchRender.h).
+    std::string batchJobPath;
+    // Render the batch job on these render daemons instead of the local GPU
+    // (see DistributedRender.h).
+    std::vector<std::string> workers;
+    // Serve render requests on this Unix domain socket, or TCP host:port,
+    // instead of opening the interactive viewer (see RenderDaemon.h).
+    std::string daemonAddress;
+    // Shared secret a daemon requires from its clients, and that --workers
+    // sends to the daemons. Needed to listen beyond the loopback interface.
+    std::string daemonToken;
+    // Vertical field of view in degrees.
+    float fovDegrees = 45.0f;
+    // Adapt the render scale to hold the GPU frame time at targetMs.
+    bool dynamicResolution = true;
+    float targetMs = 16.6f;
+    // Accumulate samples across frames by reprojecting the previous result.
+    bool temporalReprojection = true;
+    // Start with the SVGF denoiser enabled.
+    bool svgf = false;
+    // Split the trace pass of heavy modes (denoise, GI) into tiles spread over
+    // several frames, issuing at most sliceMs of GPU work per frame (0 = targetMs).
+    bool timeSlicing = true;
+    float sliceMs = 0.0f;
+    // Drop to cheaper shading while the camera moves (see PreviewLod.h).
+    bool previewLod = true;
+    // Stop sampling pixels whose accumulated estimate has converged.
+    bool adaptiveSampling = false;
+    // Relative standard error at which a pixel counts as converged.
+    float adaptiveThreshold = 0.01f;
+    // Strength of the sharpening applied while upscaling to the window (0 = plain bilinear).
+    float sharpness = 0.0f;
+};
+
+// Parses argv into options. Prints usage and returns false on an unknown or malformed argument.
+bool parseOptions(int argc, char** argv, AppOptions& options);
+
+#endif  // OPTIONS_H
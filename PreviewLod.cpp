@@ -0,0 +1,75 @@
+#include "PreviewLod.h"
+#include <cmath>
+
+namespace {
+
+// Camera speed in world units (translation) plus radians (rotation) per second.
+float cameraSpeed(const CameraState& a, const CameraState& b, float deltaTime) {
+    float moved = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        float d = a.position[i] - b.position[i];
+        moved += d * d;
+    }
+    // For rotation matrices ||A - B|| = 2 sqrt(2) sin(angle / 2), about sqrt(2) * angle.
+    float turned = 0.0f;
+    for (int i = 0; i < 9; i++) {
+        float d = a.rotation[i] - b.rotation[i];
+        turned += d * d;
+    }
+    float distance = std::sqrt(moved) + std::sqrt(turned * 0.5f);
+    return distance / std::fmax(deltaTime, 1e-4f);
+}
+
+float predictedMs(const PreviewLod& lod, int level, int fullPixels) {
+    float scale = kPreviewLevelScale[level];
+    return lod.msPerMegapixel[level] * fullPixels * scale * scale / 1.0e6f;
+}
+
+}  // namespace
+
+PreviewLevel updatePreviewLod(PreviewLod& lod, const CameraState& camera, float deltaTime, int fullPixels) {
+    float speed = lod.hasLastCamera ? cameraSpeed(camera, lod.lastCamera, deltaTime) : 0.0f;
+    lod.lastCamera = camera;
+    lod.hasLastCamera = true;
+
+    lod.sinceFast = (speed >= lod.fastSpeed) ? 0.0f : lod.sinceFast + deltaTime;
+    lod.sinceMotion = (speed > 0.0f) ? 0.0f : lod.sinceMotion + deltaTime;
+
+    int level = kPreviewFull;
+    if (lod.sinceFast < lod.fastHoldSeconds) {
+        level = kPreviewPrimary;
+    }
+    else if (lod.sinceMotion < lod.settleSeconds) {
+        level = kPreviewReflections;
+    }
+
+    // Upgrade while moving as far as measured costs allow
+    for (int richer = kPreviewFull; richer > level; richer--) {
+        if (lod.msPerMegapixel[richer] >= 0.0f && predictedMs(lod, richer, fullPixels) <= lod.targetMs) {
+            level = richer;
+            break;
+        }
+    }
+
+    lod.level = static_cast<PreviewLevel>(level);
+    return lod.level;
+}
+
+void recordPreviewCost(PreviewLod& lod, PreviewLevel level, double gpuMs, int pixels) {
+    if (gpuMs <= 0.0 || pixels <= 0) {
+        return;
+    }
+    if (lod.warmupSamples > 0) {
+        lod.warmupSamples--;
+        return;
+    }
+    float sample = static_cast<float>(gpuMs * 1.0e6 / pixels);
+    float& cost = lod.msPerMegapixel[level];
+    cost = (cost < 0.0f) ? sample : cost + 0.25f * (sample - cost);
+}
+
+void resetPreviewCosts(PreviewLod& lod) {
+    for (int i = 0; i < kPreviewLevelCount; i++) {
+        lod.msPerMegapixel[i] = -1.0f;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef PREVIEW_LOD_H
+#define PREVIEW_LOD_H
+
+#include "Camera.h"
+
+// Quality ladder used while the camera moves, cheapest first.
+enum PreviewLevel {
+    kPreviewPrimary = 0,      // primary rays with direct shading only, reduced resolution
+    kPreviewReflections = 1,  // full reflection bounces, no GI or multi-sampling
+    kPreviewFull = 2,         // everything the user enabled, progressive accumulation
+    kPreviewLevelCount = 3
+};
+
+// Render scale of each level relative to the full-quality scale.
+const float kPreviewLevelScale[kPreviewLevelCount] = { 0.5f, 1.0f, 1.0f };
+
+// Bounce limit of each level (uMaxBounces); the shader clamps it to its own maxBounces.
+const int kPreviewLevelBounces[kPreviewLevelCount] = { 1, 16, 16 };
+
+// Picks the preview level from camera motion. Fast motion gets primary rays
+// only, slow motion and short pauses add reflections, and a still camera
+// gets the full path tracer. While moving, a richer level is used whenever its
+// measured GPU cost fits the frame-time target, so the ladder only kicks in
+// when the full mode cannot keep up.
+struct PreviewLod {
+    float targetMs = 16.6f;
+    // Camera speed (world units or radians per second) counted as fast motion.
+    float fastSpeed = 1.0f;
+    // Fast motion keeps the primary-only level for this long, so brief slow
+    // frames in between mouse events do not flicker between levels.
+    float fastHoldSeconds = 0.15f;
+    // Pause before the full path tracer takes over again.
+    float settleSeconds = 0.3f;
+
+    // Smoothed GPU cost of each level per megapixel, -1 until measured.
+    float msPerMegapixel[kPreviewLevelCount] = { -1.0f, -1.0f, -1.0f };
+    // Samples still to be ignored; the first timer result after startup is not representative.
+    int warmupSamples = 1;
+
+    PreviewLevel level = kPreviewFull;
+    float sinceFast = 1e9f;    // seconds since the last fast motion
+    float sinceMotion = 1e9f;  // seconds since the camera last moved
+    CameraState lastCamera = {};
+    bool hasLastCamera = false;
+};
+
+// Measures camera motion since the previous call and returns the level for
+// this frame. fullPixels is the pixel count of the trace at full quality.
+PreviewLevel updatePreviewLod(PreviewLod& lod, const CameraState& camera, float deltaTime, int fullPixels);
+
+// Feeds the GPU time of a trace at the given level covering 'pixels' pixels.
+void recordPreviewCost(PreviewLod& lod, PreviewLevel level, double gpuMs, int pixels);
+
+// Forgets measured costs, e.g. when a toggle changes the cost of the full level.
+void resetPreviewCosts(PreviewLod& lod);
+
+#endif  // PREVIEW_LOD_H
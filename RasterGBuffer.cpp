@@ -0,0 +1,178 @@
+#include "RasterGBuffer.h"
+#include "Shader.h"
+#include <cmath>
+
+namespace {
+
+// Clip planes of the raster pass. Only the depth test depends on them; the
+// ray distance in the G-buffer is exact.
+const float kNearPlane = 0.01f;
+const float kFarPlane = 10000.0f;
+
+// Matches skyDepth in the shaders.
+const float kNoHitDistance = 1e6f;
+
+// Three transform rows and the material per instance.
+const int kInstanceFloats = 13;
+
+// Points the per-instance attributes at the given first instance. GL 3.3 has
+// no base instance for instanced draws, so each mesh's range is selected
+// through the attribute offsets instead.
+void bindInstanceRange(GLuint instanceVbo, int firstInstance) {
+    const GLsizei stride = kInstanceFloats * sizeof(float);
+    const size_t base = static_cast<size_t>(firstInstance) * stride;
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    for (int row = 0; row < 3; row++) {
+        glVertexAttribPointer(2 + row, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + row * 4 * sizeof(float)));
+    }
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, stride, (void*)(base + 12 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Appends the mesh as a triangle soup with a flat face normal per vertex.
+void appendMeshVertices(std::vector<float>& vertices, const Mesh& mesh) {
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const float* v[3] = {
+            &mesh.positions[mesh.indices[i] * 3],
+            &mesh.positions[mesh.indices[i + 1] * 3],
+            &mesh.positions[mesh.indices[i + 2] * 3],
+        };
+        float e1[3] = { v[1][0] - v[0][0], v[1][1] - v[0][1], v[1][2] - v[0][2] };
+        float e2[3] = { v[2][0] - v[0][0], v[2][1] - v[0][1], v[2][2] - v[0][2] };
+        float n[3] = {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0]
+        };
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len > 0.0f) {
+            n[0] /= len;
+            n[1] /= len;
+            n[2] /= len;
+        }
+        for (int k = 0; k < 3; k++) {
+            vertices.insert(vertices.end(), { v[k][0], v[k][1], v[k][2], n[0], n[1], n[2] });
+        }
+    }
+}
+
+}  // namespace
+
+void createRasterGBuffer(RasterGBuffer& raster, const Scene& scene, int width, int height) {
+    // Object-space triangle soup, one range per mesh
+    std::vector<float> vertices;
+    for (const Mesh& mesh : scene.meshes) {
+        raster.meshFirstVertex.push_back(static_cast<int>(vertices.size() / 6));
+        appendMeshVertices(vertices, mesh);
+        raster.meshVertexCount.push_back(static_cast<int>(vertices.size() / 6) - raster.meshFirstVertex.back());
+    }
+
+    // Per-instance object-to-world rows and material, grouped by mesh
+    std::vector<float> instances;
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        raster.meshFirstInstance.push_back(static_cast<int>(instances.size() / kInstanceFloats));
+        for (const MeshInstance& instance : scene.instances) {
+            if (instance.mesh != static_cast<int>(m)) {
+                continue;
+            }
+            int material = instance.material >= 0 ? instance.material : scene.meshes[m].material;
+            instances.insert(instances.end(), instance.transform, instance.transform + 12);
+            instances.push_back(static_cast<float>(material));
+        }
+        raster.meshInstanceCount.push_back(static_cast<int>(instances.size() / kInstanceFloats) -
+                                           raster.meshFirstInstance.back());
+    }
+
+    glGenVertexArrays(1, &raster.vao);
+    glGenBuffers(1, &raster.vbo);
+    glGenBuffers(1, &raster.instanceVbo);
+    glBindVertexArray(raster.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, raster.vbo);
+    GLenum usage = sceneAnimated(scene) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), usage);
+    glEnableVertexAttribArray(0);  // position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);  // face normal
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, raster.instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+    for (int attrib = 2; attrib <= 5; attrib++) {
+        glEnableVertexAttribArray(attrib);  // transform rows 2-4, material 5
+        glVertexAttribDivisor(attrib, 1);
+    }
+    glBindVertexArray(0);
+
+    raster.program = createShaderProgram("gbuffer_vertex_shader.glsl", "gbuffer_fragment_shader.glsl");
+    raster.target = createRenderTarget(width, height, { GL_RGBA32F, GL_RGBA32F }, true);
+}
+
+void updateRasterGBufferMeshes(RasterGBuffer& raster, const Scene& scene) {
+    glBindBuffer(GL_ARRAY_BUFFER, raster.vbo);
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        if (scene.meshes[m].twistAmount == 0.0f) {
+            continue;
+        }
+        std::vector<float> vertices;
+        appendMeshVertices(vertices, scene.meshes[m]);
+        glBufferSubData(GL_ARRAY_BUFFER, raster.meshFirstVertex[m] * 6 * sizeof(float),
+                        vertices.size() * sizeof(float), vertices.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void resizeRasterGBuffer(RasterGBuffer& raster, int width, int height) {
+    resizeRenderTarget(raster.target, width, height);
+}
+
+void renderRasterGBuffer(RasterGBuffer& raster, const CameraState& camera, float aspect, float fov) {
+    glBindFramebuffer(GL_FRAMEBUFFER, raster.target.fbo);
+    glViewport(0, 0, raster.target.width, raster.target.height);
+
+    const float noPosition[4] = { 0.0f, 0.0f, 0.0f, -1.0f };
+    const float noHit[4] = { 0.0f, 0.0f, 0.0f, kNoHitDistance };
+    glClearBufferfv(GL_COLOR, 0, noPosition);
+    glClearBufferfv(GL_COLOR, 1, noHit);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glUseProgram(raster.program);
+    setCameraUniforms(raster.program, "uCam", camera);
+    glUniform1f(glGetUniformLocation(raster.program, "uAspect"), aspect);
+    glUniform1f(glGetUniformLocation(raster.program, "uFov"), fov);
+    glUniform1f(glGetUniformLocation(raster.program, "uNear"), kNearPlane);
+    glUniform1f(glGetUniformLocation(raster.program, "uFar"), kFarPlane);
+
+    glBindVertexArray(raster.vao);
+    for (size_t m = 0; m < raster.meshFirstVertex.size(); m++) {
+        if (raster.meshInstanceCount[m] == 0) {
+            continue;
+        }
+        bindInstanceRange(raster.instanceVbo, raster.meshFirstInstance[m]);
+        glDrawArraysInstanced(GL_TRIANGLES, raster.meshFirstVertex[m], raster.meshVertexCount[m],
+                              raster.meshInstanceCount[m]);
+    }
+    glBindVertexArray(0);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void bindRasterGBuffer(GLuint program, const RasterGBuffer& raster, int textureUnit) {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D, raster.target.textures[0]);
+    glUniform1i(glGetUniformLocation(program, "uRasterPosition"), textureUnit);
+    glActiveTexture(GL_TEXTURE0 + textureUnit + 1);
+    glBindTexture(GL_TEXTURE_2D, raster.target.textures[1]);
+    glUniform1i(glGetUniformLocation(program, "uRasterGeom"), textureUnit + 1);
+}
+
+void destroyRasterGBuffer(RasterGBuffer& raster) {
+    glDeleteVertexArrays(1, &raster.vao);
+    glDeleteBuffers(1, &raster.vbo);
+    glDeleteBuffers(1, &raster.instanceVbo);
+    glDeleteProgram(raster.program);
+    destroyRenderTarget(raster.target);
+    raster = RasterGBuffer();
+}
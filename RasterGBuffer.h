@@ -0,0 +1,45 @@
+#ifndef RASTER_GBUFFER_H
+#define RASTER_GBUFFER_H
+
+#include "Camera.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+
+// Rasterized primary visibility for the scene's triangle meshes. Each mesh is
+// drawn once with all of its instances (glDrawArraysInstanced) with the normal
+// depth test into a G-buffer the tracer reads its primary hits from, so
+// triangles never cost a primary ray.
+// Attachment 0: world position (xyz) and material (w).
+// Attachment 1: normal facing the camera (xyz) and ray distance (w), 1e6 where no triangle.
+struct RasterGBuffer {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint instanceVbo = 0;
+    std::vector<int> meshFirstVertex;    // per mesh, into vbo
+    std::vector<int> meshVertexCount;
+    std::vector<int> meshFirstInstance;  // per mesh, into instanceVbo (sorted by mesh)
+    std::vector<int> meshInstanceCount;
+    GLuint program = 0;
+    RenderTarget target;
+};
+
+// Uploads the scene's meshes and instances and compiles gbuffer_*_shader.glsl.
+void createRasterGBuffer(RasterGBuffer& raster, const Scene& scene, int width, int height);
+
+// Re-uploads the vertices of the scene's animated meshes after animateMesh().
+void updateRasterGBufferMeshes(RasterGBuffer& raster, const Scene& scene);
+
+// Matches the G-buffer to the trace target size.
+void resizeRasterGBuffer(RasterGBuffer& raster, int width, int height);
+
+// Rasterizes the meshes as seen from the camera. Leaves the default framebuffer
+// bound and the depth test disabled.
+void renderRasterGBuffer(RasterGBuffer& raster, const CameraState& camera, float aspect, float fov);
+
+// Binds the G-buffer to textureUnit and textureUnit + 1 and sets uRasterPosition
+// and uRasterGeom on the currently used program.
+void bindRasterGBuffer(GLuint program, const RasterGBuffer& raster, int textureUnit);
+
+void destroyRasterGBuffer(RasterGBuffer& raster);
+
+#endif  // RASTER_GBUFFER_H
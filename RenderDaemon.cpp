@@ -0,0 +1,705 @@
+#include "RenderDaemon.h"
+#include "RenderTarget.h"
+#include "Shader.h"
+#include <iostream>
+
+#ifdef _WIN32
+
+bool runRenderDaemon(const DaemonOptions& options, BatchResources& resources) {
+    std::cerr << "Daemon mode needs Unix domain sockets and POSIX shared memory\n";
+    return false;
+}
+
+int openDaemonSocket(const std::string& address, bool listening) {
+    return -1;
+}
+
+#else
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Requests of at most this many pixels share an atlas with others.
+const int kAtlasJobPixels = 512 * 512;
+
+// Atlas width, and the height at which a group is split into several atlases.
+const int kAtlasSize = 2048;
+
+// Render targets grow in steps of this many pixels, so similar groups reuse them.
+const int kTargetGranularity = 256;
+
+// Longest request line; a client that sends more without a newline is closed.
+const size_t kMaxLineLength = 4096;
+
+typedef std::chrono::steady_clock Clock;
+
+enum ResultFormat {
+    kResultRgba8,    // radiance clamped to [0, 1], as the viewer shows it
+    kResultRgba32f,  // linear radiance
+    kResultSums      // radiance sums (rgb) and sample count (a), for merging
+};
+
+const char* const kResultFormatNames[3] = { "rgba8", "rgba32f", "sums" };
+
+struct DaemonRequest {
+    int client = -1;
+    std::string id = "-";
+    int width = 256;
+    int height = 256;
+    int spp = 16;
+    float position[3] = { 0.0f, 1.0f, -3.0f };
+    float yaw = 0.0f;    // degrees
+    float pitch = 0.0f;  // degrees
+    float fovDegrees = 45.0f;
+    bool gi = true;
+    bool denoise = false;
+    bool skybox = true;
+    float time = 0.0f;
+    int seed = 0;  // index of the first pass, so sample ranges of one image differ
+    ResultFormat format = kResultRgba8;
+    bool inlineResult = false;
+    int regionX = 0;  // traced part of the image, from the top left
+    int regionY = 0;
+    int regionWidth = 0;  // 0 traces the whole image
+    int regionHeight = 0;
+    int atlasX = 0;  // placement of the region in the atlas, from the bottom left
+    int atlasY = 0;
+    Clock::time_point received;
+};
+
+struct DaemonClient {
+    int fd = -1;
+    std::string input;                       // bytes after the last complete line
+    std::string output;                      // replies and inline results not yet sent
+    size_t outputSent = 0;                   // bytes of output already sent
+    bool authenticated = false;              // sent the daemon's token, or none is needed
+    std::vector<std::string> sharedObjects;  // results not yet known to be unlinked
+};
+
+struct DaemonState {
+    const DaemonOptions* options = nullptr;
+    BatchResources* resources = nullptr;
+    int listener = -1;
+    GLint maxViewport[2] = { 0, 0 };  // largest image: its viewport spans all of it
+    std::vector<DaemonClient> clients;
+    std::vector<DaemonRequest> pending;
+    RenderTarget passTarget;
+    RenderTarget accumulation;
+    GLuint accumulateProgram = 0;
+    std::vector<float> pixels;
+    long long resultCount = 0;
+    bool running = true;
+};
+
+bool readSwitch(std::istringstream& fields, bool& result) {
+    std::string value;
+    if (!(fields >> value) || (value != "on" && value != "off")) {
+        return false;
+    }
+    result = value == "on";
+    return true;
+}
+
+// Sends as much queued output as the socket takes without blocking, so a
+// client that stops reading cannot hold up the others. The rest is sent
+// when poll reports the socket writable. Errors surface on the next read.
+void flushClient(DaemonClient& client) {
+    while (client.outputSent < client.output.size()) {
+        ssize_t n = send(client.fd, client.output.data() + client.outputSent,
+                         client.output.size() - client.outputSent, 0);
+        if (n <= 0) {
+            return;
+        }
+        client.outputSent += static_cast<size_t>(n);
+    }
+    client.output.clear();
+    client.outputSent = 0;
+}
+
+void sendAll(DaemonClient& client, const void* data, size_t size) {
+    client.output.append(static_cast<const char*>(data), size);
+    flushClient(client);
+}
+
+void sendLine(DaemonClient& client, const std::string& line) {
+    std::string text = line + "\n";
+    sendAll(client, text.data(), text.size());
+}
+
+// Parses a render request. Returns an error message, empty if it is valid.
+// Only the region is traced and read back, so options.maxSize limits the
+// region; the image only has to fit in a viewport.
+std::string parseRequest(const std::string& line, const DaemonOptions& options, const GLint maxViewport[2],
+                         DaemonRequest& request) {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+    while (fields >> key) {
+        bool valid = true;
+        if (key == "id") {
+            valid = static_cast<bool>(fields >> request.id);
+        }
+        else if (key == "size") {
+            valid = static_cast<bool>(fields >> request.width >> request.height) && request.width > 0 &&
+                request.height > 0 && request.width <= maxViewport[0] && request.height <= maxViewport[1];
+        }
+        else if (key == "spp") {
+            valid = static_cast<bool>(fields >> request.spp) && request.spp > 0 && request.spp <= options.maxSpp;
+        }
+        else if (key == "camera") {
+            valid = static_cast<bool>(fields >> request.position[0] >> request.position[1] >> request.position[2] >>
+                                      request.yaw >> request.pitch);
+        }
+        else if (key == "fov") {
+            valid = static_cast<bool>(fields >> request.fovDegrees) && request.fovDegrees > 0.0f &&
+                request.fovDegrees < 180.0f;
+        }
+        else if (key == "gi") {
+            valid = readSwitch(fields, request.gi);
+        }
+        else if (key == "denoise") {
+            valid = readSwitch(fields, request.denoise);
+        }
+        else if (key == "skybox") {
+            valid = readSwitch(fields, request.skybox);
+        }
+        else if (key == "time") {
+            valid = static_cast<bool>(fields >> request.time);
+        }
+        else if (key == "seed") {
+            valid = static_cast<bool>(fields >> request.seed) && request.seed >= 0;
+        }
+        else if (key == "region") {
+            valid = static_cast<bool>(fields >> request.regionX >> request.regionY >> request.regionWidth >>
+                                      request.regionHeight) && request.regionX >= 0 && request.regionY >= 0 &&
+                request.regionWidth > 0 && request.regionHeight > 0;
+        }
+        else if (key == "format") {
+            std::string format;
+            valid = false;
+            fields >> format;
+            for (int i = 0; i < 3; i++) {
+                if (format == kResultFormatNames[i]) {
+                    request.format = static_cast<ResultFormat>(i);
+                    valid = true;
+                }
+            }
+        }
+        else if (key == "deliver") {
+            std::string delivery;
+            valid = (fields >> delivery) && (delivery == "shm" || delivery == "inline");
+            request.inlineResult = delivery == "inline";
+        }
+        else {
+            return "unknown keyword " + key;
+        }
+        if (!valid) {
+            return "invalid value for " + key;
+        }
+    }
+    if (request.regionWidth == 0) {
+        request.regionX = 0;
+        request.regionY = 0;
+        request.regionWidth = request.width;
+        request.regionHeight = request.height;
+    }
+    if (request.regionX + request.regionWidth > request.width || request.regionY + request.regionHeight > request.height) {
+        return "region outside the image";
+    }
+    if (request.regionWidth > options.maxSize || request.regionHeight > options.maxSize) {
+        return "region larger than " + std::to_string(options.maxSize) + " pixels";
+    }
+    return "";
+}
+
+// Compares without stopping at the first difference, so the time taken
+// does not reveal how much of a guessed token was right.
+bool tokensMatch(const std::string& given, const std::string& expected) {
+    unsigned char difference = given.size() == expected.size() ? 0 : 1;
+    for (size_t i = 0; i < given.size(); i++) {
+        difference |= static_cast<unsigned char>(given[i] ^ expected[i % std::max<size_t>(expected.size(), 1)]);
+    }
+    return difference == 0;
+}
+
+// Whether a listening socket is reachable from this machine only.
+bool isLocalListener(int fd) {
+    sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        return false;
+    }
+    if (address.ss_family == AF_UNIX) {
+        return true;
+    }
+    if (address.ss_family == AF_INET) {
+        const sockaddr_in& ipv4 = reinterpret_cast<const sockaddr_in&>(address);
+        return (ntohl(ipv4.sin_addr.s_addr) >> 24) == 127;
+    }
+    if (address.ss_family == AF_INET6) {
+        const sockaddr_in6& ipv6 = reinterpret_cast<const sockaddr_in6&>(address);
+        return IN6_IS_ADDR_LOOPBACK(&ipv6.sin6_addr);
+    }
+    return false;
+}
+
+void closeClient(DaemonState& state, size_t index) {
+    DaemonClient& client = state.clients[index];
+    for (const std::string& name : client.sharedObjects) {
+        shm_unlink(name.c_str());
+    }
+    close(client.fd);
+    int fd = client.fd;
+    state.pending.erase(std::remove_if(state.pending.begin(), state.pending.end(),
+                                       [fd](const DaemonRequest& r) { return r.client == fd; }),
+                        state.pending.end());
+    state.clients.erase(state.clients.begin() + index);
+}
+
+void handleLine(DaemonState& state, DaemonClient& client, const std::string& line) {
+    std::istringstream fields(line);
+    std::string command;
+    if (!(fields >> command)) {
+        return;
+    }
+    if (command == "auth") {
+        std::string token;
+        fields >> token;
+        client.authenticated = state.options->token.empty() || tokensMatch(token, state.options->token);
+        sendLine(client, client.authenticated ? "ok auth" : "error - wrong token");
+        return;
+    }
+    if (!client.authenticated) {
+        sendLine(client, "error - authentication required");
+        return;
+    }
+    if (command == "shutdown") {
+        state.running = false;
+        sendLine(client, "ok shutdown");
+        return;
+    }
+    DaemonRequest request;
+    if (command != "render") {
+        sendLine(client, "error - unknown command " + command);
+        return;
+    }
+    std::string error = parseRequest(line, *state.options, state.maxViewport, request);
+    if (!error.empty()) {
+        sendLine(client, "error " + request.id + " " + error);
+        return;
+    }
+    request.client = client.fd;
+    request.received = Clock::now();
+    state.pending.push_back(request);
+}
+
+// Accepts connections and reads requests until the timeout passes (-1 waits
+// for the first event).
+void serviceSockets(DaemonState& state, int timeoutMs) {
+    std::vector<pollfd> fds(1 + state.clients.size());
+    fds[0].fd = state.listener;
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < state.clients.size(); i++) {
+        fds[i + 1].fd = state.clients[i].fd;
+        fds[i + 1].events = POLLIN | (state.clients[i].output.empty() ? 0 : POLLOUT);
+    }
+    if (poll(fds.data(), fds.size(), timeoutMs) <= 0) {
+        return;
+    }
+
+    for (size_t i = fds.size() - 1; i >= 1; i--) {
+        DaemonClient& client = state.clients[i - 1];
+        if (fds[i].revents & POLLOUT) {
+            flushClient(client);
+        }
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+        char buffer[4096];
+        ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+        if (n <= 0) {
+            closeClient(state, i - 1);
+            continue;
+        }
+        client.input.append(buffer, static_cast<size_t>(n));
+        for (size_t end = client.input.find('\n'); end != std::string::npos; end = client.input.find('\n')) {
+            std::string line = client.input.substr(0, end);
+            client.input.erase(0, end + 1);
+            handleLine(state, client, line);
+        }
+        if (client.input.size() > kMaxLineLength) {
+            closeClient(state, i - 1);
+        }
+    }
+    if (fds[0].revents & POLLIN) {
+        int fd = accept(state.listener, nullptr, nullptr);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            DaemonClient client;
+            client.fd = fd;
+            client.authenticated = state.options->token.empty();
+            state.clients.push_back(client);
+        }
+    }
+}
+
+DaemonClient* findClient(DaemonState& state, int fd) {
+    for (DaemonClient& client : state.clients) {
+        if (client.fd == fd) {
+            return &client;
+        }
+    }
+    return nullptr;
+}
+
+// Converts a request's region of the atlas readback to its result format,
+// top row first.
+void resolveResult(const DaemonState& state, const DaemonRequest& request, int atlasWidth,
+                   std::vector<unsigned char>& result) {
+    size_t pixelBytes = request.format == kResultRgba8 ? 4 : 4 * sizeof(float);
+    result.resize(static_cast<size_t>(request.regionWidth) * request.regionHeight * pixelBytes);
+    for (int y = 0; y < request.regionHeight; y++) {
+        const float* source = &state.pixels[(static_cast<size_t>(request.atlasY + request.regionHeight - 1 - y) *
+                                             atlasWidth + request.atlasX) * 4];
+        for (int x = 0; x < request.regionWidth; x++) {
+            size_t target = static_cast<size_t>(y) * request.regionWidth + x;
+            float count = source[x * 4 + 3];
+            float scale = count > 0.0f ? 1.0f / count : 0.0f;
+            if (request.format == kResultSums) {
+                std::memcpy(&result[target * pixelBytes], &source[x * 4], pixelBytes);
+            }
+            else if (request.format == kResultRgba32f) {
+                float* out = reinterpret_cast<float*>(&result[target * pixelBytes]);
+                for (int c = 0; c < 3; c++) {
+                    out[c] = source[x * 4 + c] * scale;
+                }
+                out[3] = 1.0f;
+            }
+            else {
+                unsigned char* out = &result[target * pixelBytes];
+                for (int c = 0; c < 3; c++) {
+                    float value = std::min(std::max(source[x * 4 + c] * scale, 0.0f), 1.0f);
+                    out[c] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+                }
+                out[3] = 255;
+            }
+        }
+    }
+}
+
+// Answers a request with its pixels, in a new shared memory object or
+// following the reply line on the socket.
+void deliverResult(DaemonState& state, const DaemonRequest& request, int atlasWidth) {
+    DaemonClient* client = findClient(state, request.client);
+    if (!client) {
+        return;
+    }
+    std::vector<unsigned char> result;
+    resolveResult(state, request, atlasWidth, result);
+
+    std::string location = "inline";
+    if (!request.inlineResult) {
+        location = "/oglrt-" + std::to_string(getpid()) + "-" + std::to_string(state.resultCount);
+        int fd = shm_open(location.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        void* mapped = MAP_FAILED;
+        if (fd >= 0 && ftruncate(fd, static_cast<off_t>(result.size())) == 0) {
+            mapped = mmap(nullptr, result.size(), PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (mapped == MAP_FAILED) {
+            shm_unlink(location.c_str());
+            sendLine(*client, "error " + request.id + " cannot create shared memory: " + std::strerror(errno));
+            return;
+        }
+        std::memcpy(mapped, result.data(), result.size());
+        munmap(mapped, result.size());
+        client->sharedObjects.push_back(location);
+    }
+    state.resultCount++;
+
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - request.received).count();
+    std::ostringstream reply;
+    reply << "ok " << request.id << " " << location << " " << request.regionWidth << " " << request.regionHeight
+          << " " << kResultFormatNames[request.format] << " " << result.size() << " " << ms;
+    sendLine(*client, reply.str());
+    if (request.inlineResult) {
+        sendAll(*client, result.data(), result.size());
+    }
+}
+
+// Traces requests placed side by side in one atlas and answers them.
+void renderAtlas(DaemonState& state, std::vector<DaemonRequest>& requests, int width, int height) {
+    // Targets only grow, in coarse steps
+    int targetWidth = std::max(state.passTarget.width,
+                               (width + kTargetGranularity - 1) / kTargetGranularity * kTargetGranularity);
+    int targetHeight = std::max(state.passTarget.height,
+                                (height + kTargetGranularity - 1) / kTargetGranularity * kTargetGranularity);
+    resizeRenderTarget(state.passTarget, targetWidth, targetHeight);
+    resizeRenderTarget(state.accumulation, targetWidth, targetHeight);
+
+    const DaemonRequest& first = requests[0];
+    BatchResources& resources = *state.resources;
+    setBatchSceneTime(resources, first.time);
+    int passSamples = first.denoise ? kBatchDenoisePassSamples : 1;
+    int passCount = 0;
+    for (const DaemonRequest& request : requests) {
+        passCount = std::max(passCount, (request.spp + passSamples - 1) / passSamples);
+    }
+
+    const GLfloat zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glBindFramebuffer(GL_FRAMEBUFFER, state.accumulation.fbo);
+    glClearBufferfv(GL_COLOR, 0, zeros);
+    for (int pass = 0; pass < passCount; pass++) {
+        // Requests that already have their samples stay cleared and add nothing
+        glBindFramebuffer(GL_FRAMEBUFFER, state.passTarget.fbo);
+        glClearBufferfv(GL_COLOR, 0, zeros);
+        for (const DaemonRequest& request : requests) {
+            if (pass * passSamples >= request.spp) {
+                continue;
+            }
+            const float toRadians = 3.14159265f / 180.0f;
+            BatchPassSettings settings;
+            settings.aspect = static_cast<float>(request.width) / request.height;
+            settings.fov = request.fovDegrees * toRadians;
+            settings.gi = request.gi;
+            settings.denoise = request.denoise;
+            settings.skybox = request.skybox;
+            // The viewport spans the whole image, placed so that only the
+            // region falls inside the scissor box of its atlas slot
+            int imageBottom = request.atlasY - (request.height - request.regionY - request.regionHeight);
+            glViewport(request.atlasX - request.regionX, imageBottom, request.width, request.height);
+            glScissor(request.atlasX, request.atlasY, request.regionWidth, request.regionHeight);
+            glEnable(GL_SCISSOR_TEST);
+            drawBatchPass(resources, makeCameraState(request.position, request.yaw * toRadians,
+                                                     request.pitch * toRadians),
+                          request.time, request.seed + pass, settings);
+            glDisable(GL_SCISSOR_TEST);
+        }
+
+        // One accumulation draw over the whole atlas
+        glBindFramebuffer(GL_FRAMEBUFFER, state.accumulation.fbo);
+        glViewport(0, 0, width, height);
+        glUseProgram(state.accumulateProgram);
+        glBindVertexArray(resources.quadVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, state.passTarget.textures[0]);
+        glUniform1i(glGetUniformLocation(state.accumulateProgram, "uSource"), 0);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glDisable(GL_BLEND);
+    }
+    glBindVertexArray(0);
+
+    // One readback for every request of the atlas
+    state.pixels.resize(static_cast<size_t>(width) * height * 4);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, state.pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    for (const DaemonRequest& request : requests) {
+        deliverResult(state, request, width);
+    }
+}
+
+// Groups the pending requests by shading switches and time, packs the small
+// ones of each group into shelves of shared atlases and traces them.
+void renderPending(DaemonState& state) {
+    typedef std::tuple<bool, bool, bool, float> GroupKey;
+    std::map<GroupKey, std::vector<DaemonRequest>> groups;
+    for (const DaemonRequest& request : state.pending) {
+        groups[GroupKey(request.gi, request.denoise, request.skybox, request.time)].push_back(request);
+    }
+    state.pending.clear();
+
+    for (auto& entry : groups) {
+        std::vector<DaemonRequest>& group = entry.second;
+        std::stable_sort(group.begin(), group.end(),
+                         [](const DaemonRequest& a, const DaemonRequest& b) { return a.regionHeight > b.regionHeight; });
+        std::vector<DaemonRequest> atlas;
+        int shelfX = 0, shelfY = 0, shelfHeight = 0, atlasWidth = 0;
+        for (DaemonRequest& request : group) {
+            // Large or long regions get an image of their own
+            if (request.regionWidth * request.regionHeight > kAtlasJobPixels ||
+                request.regionWidth > kAtlasSize || request.regionHeight > kAtlasSize) {
+                request.atlasX = 0;
+                request.atlasY = 0;
+                std::vector<DaemonRequest> single(1, request);
+                renderAtlas(state, single, request.regionWidth, request.regionHeight);
+                continue;
+            }
+            if (shelfX + request.regionWidth > kAtlasSize) {
+                shelfX = 0;
+                shelfY += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (shelfY + request.regionHeight > kAtlasSize && !atlas.empty()) {
+                renderAtlas(state, atlas, atlasWidth, shelfY);
+                atlas.clear();
+                shelfX = shelfY = shelfHeight = atlasWidth = 0;
+            }
+            request.atlasX = shelfX;
+            request.atlasY = shelfY;
+            atlas.push_back(request);
+            shelfX += request.regionWidth;
+            shelfHeight = std::max(shelfHeight, request.regionHeight);
+            atlasWidth = std::max(atlasWidth, shelfX);
+        }
+        if (!atlas.empty()) {
+            renderAtlas(state, atlas, atlasWidth, shelfY + shelfHeight);
+        }
+    }
+}
+
+bool isTcpAddress(const std::string& address) {
+    size_t colon = address.rfind(':');
+    return colon != std::string::npos && colon + 1 < address.size() && address.find('/') == std::string::npos &&
+        address.find_first_not_of("0123456789", colon + 1) == std::string::npos;
+}
+
+}  // namespace
+
+int openDaemonSocket(const std::string& address, bool listening) {
+    int fd = -1;
+    if (isTcpAddress(address)) {
+        size_t colon = address.rfind(':');
+        std::string host = address.substr(0, colon);
+        if (host.empty()) {
+            host = "127.0.0.1";  // ":port" stays on this machine
+        }
+        std::string port = address.substr(colon + 1);
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* results = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0) {
+            std::cerr << "Cannot resolve " << address << "\n";
+            return -1;
+        }
+        for (addrinfo* info = results; info && fd < 0; info = info->ai_next) {
+            fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            bool opened;
+            if (listening) {
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+                opened = bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, 16) == 0;
+            }
+            else {
+                opened = connect(fd, info->ai_addr, info->ai_addrlen) == 0;
+            }
+            if (!opened) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(results);
+    }
+    else {
+        sockaddr_un local;
+        std::memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(local.sun_path)) {
+            std::cerr << "Socket path too long: " << address << "\n";
+            return -1;
+        }
+        std::strcpy(local.sun_path, address.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listening) {
+            unlink(address.c_str());
+        }
+        sockaddr* target = reinterpret_cast<sockaddr*>(&local);
+        if (fd >= 0 && (listening ? bind(fd, target, sizeof(local)) != 0 || listen(fd, 16) != 0
+                                  : connect(fd, target, sizeof(local)) != 0)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        std::cerr << "Failed to " << (listening ? "listen on " : "connect to ") << address << ": "
+                  << std::strerror(errno) << "\n";
+    }
+    return fd;
+}
+
+bool runRenderDaemon(const DaemonOptions& options, BatchResources& resources) {
+    DaemonState state;
+    state.options = &options;
+    state.resources = &resources;
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, state.maxViewport);
+    state.listener = openDaemonSocket(options.address, true);
+    if (state.listener < 0) {
+        return false;
+    }
+    if (options.token.empty() && !isLocalListener(state.listener)) {
+        std::cerr << "Listening on " << options.address << " accepts other machines and needs a token (--daemon-token)\n";
+        close(state.listener);
+        return false;
+    }
+    // A client that disconnects before its reply must not end the daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    state.passTarget = createRenderTarget(kTargetGranularity, kTargetGranularity, { GL_RGBA32F });
+    state.accumulation = createRenderTarget(kTargetGranularity, kTargetGranularity, { GL_RGBA32F });
+    state.accumulateProgram = createShaderProgram("vertex_shader.glsl", "accumulate_shader.glsl");
+    std::cout << "Render daemon listening on " << options.address << "\n";
+
+    int windowMs = std::max(0, static_cast<int>(options.batchWindowMs + 0.5f));
+    while (state.running) {
+        serviceSockets(state, -1);
+        if (state.pending.empty()) {
+            continue;
+        }
+        // Let requests sent together catch up before tracing the group
+        auto deadline = Clock::now() + std::chrono::milliseconds(windowMs);
+        while (state.running && Clock::now() < deadline) {
+            int remaining = static_cast<int>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count());
+            serviceSockets(state, std::max(remaining, 0));
+        }
+        renderPending(state);
+    }
+
+    while (!state.clients.empty()) {
+        flushClient(state.clients.back());  // last replies, such as "ok shutdown"
+        closeClient(state, state.clients.size() - 1);
+    }
+    close(state.listener);
+    if (!isTcpAddress(options.address)) {
+        unlink(options.address.c_str());
+    }
+    destroyRenderTarget(state.passTarget);
+    destroyRenderTarget(state.accumulation);
+    glDeleteProgram(state.accumulateProgram);
+    std::cout << "Render daemon stopped after " << state.resultCount << " results\n";
+    return true;
+}
+
+#endif  // _WIN32
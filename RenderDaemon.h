@@ -0,0 +1,55 @@
+#ifndef RENDER_DAEMON_H
+#define RENDER_DAEMON_H
+
+#include "BatchRender.h"
+#include <string>
+
+// Long-running render service. The context, shader programs, scene buffers
+// and skybox are set up once; clients connect to a Unix domain socket or TCP
+// port and send one request per line, keywords in any order:
+//
+//   render id 7 size 256 256 spp 16 camera 0 1 -3 0 0 fov 45 gi on denoise off
+//          skybox on time 0 format rgba8
+//   shutdown
+//   auth <token>
+//
+// camera is position x y z, yaw and pitch in degrees; format is rgba8
+// (clamped like the viewer), rgba32f (linear radiance) or sums (radiance
+// sums and sample count, to merge partial results). region x y w h traces
+// only that part of the image, counted from the top left, and seed n starts
+// at pass n so that sample ranges of one image use different samples.
+// Each request is answered by one line:
+//
+//   ok <id> <location> <width> <height> <format> <bytes> <milliseconds>
+//   error <id> <message>
+//
+// The pixels, top row first, are in a POSIX shared memory object named by
+// location, which the client maps and then unlinks; objects still linked are
+// removed when the connection closes. With "deliver inline" the location is
+// "inline" and the bytes follow the line on the socket instead, for clients
+// on other machines. Requests that arrive together and share their shading switches and
+// time are traced as one group: small images are packed side by side into a
+// shared atlas that is accumulated and read back once for all of them.
+//
+// Anyone who can connect may render and shut the daemon down. A TCP address
+// without a host (":7000") listens on the loopback interface only. With a
+// token, every connection has to send "auth <token>" before anything else;
+// listening beyond the loopback interface requires one.
+struct DaemonOptions {
+    std::string address;      // Unix socket path, or host:port for TCP (e.g. "0.0.0.0:7000")
+    std::string token;        // shared secret clients must send first, empty for none
+    int maxSpp = 4096;        // larger requests are refused
+    int maxSize = 4096;       // of the traced region, in either dimension
+    float batchWindowMs = 2.0f;  // time to wait for more requests to join a group
+};
+
+// Serves requests until a shutdown request arrives. Returns false if the
+// socket cannot be set up, or on platforms without Unix domain sockets and
+// POSIX shared memory.
+bool runRenderDaemon(const DaemonOptions& options, BatchResources& resources);
+
+// Listens on or connects to a daemon address. Returns the socket, or -1
+// after printing the error.
+int openDaemonSocket(const std::string& address, bool listening);
+
+#endif  // RENDER_DAEMON_H
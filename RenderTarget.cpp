@@ -0,0 +1,112 @@
+#include "RenderTarget.h"
+#include <iostream>
+
+namespace {
+
+// Returns a pixel transfer format/type compatible with the internal format.
+void uploadFormatFor(GLenum internalFormat, GLenum& format, GLenum& type) {
+    switch (internalFormat) {
+    case GL_R32F:
+    case GL_R16F:
+        format = GL_RED;
+        type = GL_FLOAT;
+        break;
+    case GL_RG32F:
+    case GL_RG16F:
+        format = GL_RG;
+        type = GL_FLOAT;
+        break;
+    case GL_RGBA32UI:
+        format = GL_RGBA_INTEGER;
+        type = GL_UNSIGNED_INT;
+        break;
+    case GL_R8:
+        format = GL_RED;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    case GL_RGBA8:
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    default:
+        format = GL_RGBA;
+        type = GL_FLOAT;
+        break;
+    }
+}
+
+bool isIntegerFormat(GLenum internalFormat) {
+    return internalFormat == GL_RGBA32UI;
+}
+
+}  // namespace
+
+RenderTarget createRenderTarget(int width, int height, const std::vector<GLenum>& formats, bool withDepth) {
+    RenderTarget target;
+    target.width = width;
+    target.height = height;
+    target.formats = formats;
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+
+    std::vector<GLenum> drawBuffers;
+    for (size_t i = 0; i < formats.size(); i++) {
+        GLenum format, type;
+        uploadFormatFor(formats[i], format, type);
+
+        // Integer textures cannot be linearly filtered.
+        GLint filter = isIntegerFormat(formats[i]) ? GL_NEAREST : GL_LINEAR;
+
+        GLuint tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i), GL_TEXTURE_2D, tex, 0);
+
+        target.textures.push_back(tex);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+    }
+    glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+
+    if (withDepth) {
+        glGenRenderbuffers(1, &target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Render target " << width << "x" << height << " is incomplete\n";
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return target;
+}
+
+void resizeRenderTarget(RenderTarget& target, int width, int height) {
+    if (target.width == width && target.height == height) {
+        return;
+    }
+    std::vector<GLenum> formats = target.formats;
+    bool withDepth = target.depth != 0;
+    destroyRenderTarget(target);
+    target = createRenderTarget(width, height, formats, withDepth);
+}
+
+void destroyRenderTarget(RenderTarget& target) {
+    if (!target.textures.empty()) {
+        glDeleteTextures(static_cast<GLsizei>(target.textures.size()), target.textures.data());
+    }
+    if (target.depth) {
+        glDeleteRenderbuffers(1, &target.depth);
+    }
+    glDeleteFramebuffers(1, &target.fbo);
+    target = RenderTarget();
+}
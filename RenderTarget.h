@@ -0,0 +1,30 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// Offscreen framebuffer with one texture per color attachment.
+// Attachment i is bound to GL_COLOR_ATTACHMENT0 + i and to fragment output location i.
+struct RenderTarget {
+    GLuint fbo = 0;
+    std::vector<GLuint> textures;
+    std::vector<GLenum> formats;
+    GLuint depth = 0;  // depth renderbuffer, 0 if the target has none
+    int width = 0;
+    int height = 0;
+};
+
+// Creates a framebuffer of the given size with one texture per internal format
+// (e.g. { GL_RGBA16F }). Textures use linear filtering and clamp-to-edge.
+// withDepth adds a 24-bit depth renderbuffer for rasterized passes.
+RenderTarget createRenderTarget(int width, int height, const std::vector<GLenum>& formats, bool withDepth = false);
+
+// Recreates the target's textures at a new size, keeping its formats and depth buffer.
+// Does nothing if the size is unchanged.
+void resizeRenderTarget(RenderTarget& target, int width, int height);
+
+// Releases the framebuffer and its textures.
+void destroyRenderTarget(RenderTarget& target);
+
+#endif  // RENDER_TARGET_H
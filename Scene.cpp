@@ -0,0 +1,594 @@
+#include "Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+Scene createDefaultScene() {
+    Scene scene;
+
+    // Material 0: red sphere. Material 1: white/grey checkerboard floor.
+    scene.materials.push_back({ { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, 0.0f });
+    scene.materials.push_back({ { 1.0f, 1.0f, 1.0f }, { 0.2f, 0.2f, 0.2f }, 2.0f });
+
+    scene.spheres.push_back({ { 0.0f, 0.0f, 5.0f }, 1.0f, 0 });
+
+    // Large floor at y=-1, big enough to look infinite but bounded to +-50 in X and Z.
+    scene.planes.push_back({ -1.0f, 50.0f, 1 });
+
+    return scene;
+}
+
+Scene createMeshScene() {
+    Scene scene = createDefaultScene();
+
+    // Material 2: pale gold torus lying on the floor beside the sphere.
+    scene.materials.push_back({ { 0.9f, 0.75f, 0.35f }, { 0.9f, 0.75f, 0.35f }, 0.0f });
+    scene.meshes.push_back(createTorusMesh(1.0f, 0.4f, 48, 24, 2));
+    const float position[3] = { 2.5f, -0.6f, 6.0f };
+    scene.instances.push_back(makeMeshInstance(0, -1, position, 0.0f, 0.0f, 1.0f));
+
+    return scene;
+}
+
+Scene createInstancedScene() {
+    Scene scene = createDefaultScene();
+
+    // Materials 2-4: gold, teal and lilac rings scattered over the floor.
+    scene.materials.push_back({ { 0.9f, 0.75f, 0.35f }, { 0.9f, 0.75f, 0.35f }, 0.0f });
+    scene.materials.push_back({ { 0.2f, 0.7f, 0.7f }, { 0.2f, 0.7f, 0.7f }, 0.0f });
+    scene.materials.push_back({ { 0.7f, 0.5f, 0.9f }, { 0.7f, 0.5f, 0.9f }, 0.0f });
+    scene.meshes.push_back(createTorusMesh(1.0f, 0.4f, 24, 12, 2));
+
+    // 48 x 48 grid in front of the camera with deterministic jitter, so
+    // every run traces the same scene.
+    const int grid = 48;
+    const float spacing = 0.6f;
+    const float scale = 0.2f;
+    unsigned int seed = 12345u;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    for (int i = 0; i < grid; i++) {
+        for (int j = 0; j < grid; j++) {
+            float position[3] = {
+                (i - grid / 2 + random()) * spacing,
+                -1.0f + 0.4f * scale + 0.3f * random(),
+                2.0f + (j + random()) * spacing,
+            };
+            // Keep clear of the sphere
+            float dx = position[0] - scene.spheres[0].center[0];
+            float dz = position[2] - scene.spheres[0].center[2];
+            if (dx * dx + dz * dz < 2.5f * 2.5f) {
+                continue;
+            }
+            float yaw = 6.28318531f * random();
+            float pitch = 1.2f * (random() - 0.5f);
+            int material = 2 + (i + j) % 3;
+            scene.instances.push_back(makeMeshInstance(0, material, position, yaw, pitch, scale));
+        }
+    }
+
+    return scene;
+}
+
+Scene createAnimatedScene() {
+    Scene scene = createDefaultScene();
+
+    // Materials 2-3: gold and teal rings either side of the sphere, sharing
+    // one twisting mesh.
+    scene.materials.push_back({ { 0.9f, 0.75f, 0.35f }, { 0.9f, 0.75f, 0.35f }, 0.0f });
+    scene.materials.push_back({ { 0.2f, 0.7f, 0.7f }, { 0.2f, 0.7f, 0.7f }, 0.0f });
+    Mesh torus = createTorusMesh(1.0f, 0.4f, 96, 48, 2);
+    torus.twistAmount = 2.5f;
+    torus.twistSpeed = 1.5f;
+    torus.restPositions = torus.positions;
+    scene.meshes.push_back(torus);
+
+    const float right[3] = { 2.5f, -0.2f, 6.0f };
+    const float left[3] = { -2.5f, -0.2f, 6.0f };
+    scene.instances.push_back(makeMeshInstance(0, 2, right, 0.0f, 0.0f, 1.0f));
+    scene.instances.push_back(makeMeshInstance(0, 3, left, 1.0f, 0.3f, 1.0f));
+
+    return scene;
+}
+
+Mesh createTorusMesh(float majorRadius, float minorRadius, int segments, int sides, int material) {
+    const float twoPi = 6.28318531f;
+    Mesh mesh;
+    mesh.material = material;
+
+    for (int i = 0; i < segments; i++) {
+        float u = twoPi * i / segments;
+        for (int j = 0; j < sides; j++) {
+            float v = twoPi * j / sides;
+            float ring = majorRadius + minorRadius * std::cos(v);
+            mesh.positions.push_back(ring * std::cos(u));
+            mesh.positions.push_back(minorRadius * std::sin(v));
+            mesh.positions.push_back(ring * std::sin(u));
+        }
+    }
+
+    // Two triangles per quad of the (segments x sides) grid, wrapping in both directions.
+    for (int i = 0; i < segments; i++) {
+        for (int j = 0; j < sides; j++) {
+            unsigned int a = i * sides + j;
+            unsigned int b = ((i + 1) % segments) * sides + j;
+            unsigned int c = ((i + 1) % segments) * sides + (j + 1) % sides;
+            unsigned int d = i * sides + (j + 1) % sides;
+            mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+        }
+    }
+    return mesh;
+}
+
+MeshInstance makeMeshInstance(int mesh, int material, const float position[3],
+                              float yaw, float pitch, float scale) {
+    float cy = std::cos(yaw), sy = std::sin(yaw);
+    float cp = std::cos(pitch), sp = std::sin(pitch);
+
+    // R = Rx(pitch) * Ry(yaw), scaled; translation in the last column
+    MeshInstance instance;
+    instance.mesh = mesh;
+    instance.material = material;
+    const float rows[3][4] = {
+        { cy * scale, 0.0f, sy * scale, position[0] },
+        { sp * sy * scale, cp * scale, -sp * cy * scale, position[1] },
+        { -cp * sy * scale, sp * scale, cp * cy * scale, position[2] },
+    };
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            instance.transform[r * 4 + c] = rows[r][c];
+        }
+    }
+    return instance;
+}
+
+void transformPoint(const float transform[12], const float point[3], float result[3]) {
+    for (int r = 0; r < 3; r++) {
+        const float* row = &transform[r * 4];
+        result[r] = row[0] * point[0] + row[1] * point[1] + row[2] * point[2] + row[3];
+    }
+}
+
+bool animateMesh(Mesh& mesh, float time) {
+    if (mesh.twistAmount == 0.0f || mesh.restPositions.size() != mesh.positions.size()) {
+        return false;
+    }
+    float swing = mesh.twistAmount * std::sin(mesh.twistSpeed * time);
+    for (size_t i = 0; i + 2 < mesh.restPositions.size(); i += 3) {
+        const float* rest = &mesh.restPositions[i];
+        float angle = swing * rest[1];
+        float c = std::cos(angle), s = std::sin(angle);
+        mesh.positions[i] = c * rest[0] + s * rest[2];
+        mesh.positions[i + 1] = rest[1];
+        mesh.positions[i + 2] = -s * rest[0] + c * rest[2];
+    }
+    return true;
+}
+
+bool sceneAnimated(const Scene& scene) {
+    for (const Mesh& mesh : scene.meshes) {
+        if (mesh.twistAmount != 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int sceneTriangleCount(const Scene& scene) {
+    size_t count = 0;
+    for (const MeshInstance& instance : scene.instances) {
+        count += scene.meshes[instance.mesh].indices.size() / 3;
+    }
+    return static_cast<int>(count);
+}
+
+int scenePrimitiveCount(const Scene& scene) {
+    return static_cast<int>(scene.spheres.size() + scene.planes.size()) + sceneTriangleCount(scene);
+}
+
+namespace {
+
+// Triangles per bottom-level leaf.
+const int kBlasLeafSize = 4;
+
+// Changed node runs closer than this are uploaded as one range.
+const int kRefitUploadGap = 16;
+
+// Inverts a row-major 3x4 affine transform.
+void invertAffine(const float m[12], float inv[12]) {
+    float a = m[0], b = m[1], c = m[2];
+    float d = m[4], e = m[5], f = m[6];
+    float g = m[8], h = m[9], i = m[10];
+    float c0 = e * i - f * h;
+    float c1 = f * g - d * i;
+    float c2 = d * h - e * g;
+    float invDet = 1.0f / (a * c0 + b * c1 + c * c2);
+    float r[9] = {
+        c0 * invDet, (c * h - b * i) * invDet, (b * f - c * e) * invDet,
+        c1 * invDet, (a * i - c * g) * invDet, (c * d - a * f) * invDet,
+        c2 * invDet, (b * g - a * h) * invDet, (a * e - b * d) * invDet,
+    };
+    for (int row = 0; row < 3; row++) {
+        inv[row * 4 + 0] = r[row * 3 + 0];
+        inv[row * 4 + 1] = r[row * 3 + 1];
+        inv[row * 4 + 2] = r[row * 3 + 2];
+        inv[row * 4 + 3] = -(r[row * 3 + 0] * m[3] + r[row * 3 + 1] * m[7] + r[row * 3 + 2] * m[11]);
+    }
+}
+
+// World-space bounds of an object-space box under an instance transform:
+// the transformed center plus the extents through the absolute matrix.
+Aabb transformAabb(const float transform[12], const Aabb& box) {
+    Aabb result;
+    for (int r = 0; r < 3; r++) {
+        const float* row = &transform[r * 4];
+        float center = row[3];
+        float extent = 0.0f;
+        for (int c = 0; c < 3; c++) {
+            center += row[c] * 0.5f * (box.min[c] + box.max[c]);
+            extent += std::fabs(row[c]) * 0.5f * (box.max[c] - box.min[c]);
+        }
+        result.min[r] = center - extent;
+        result.max[r] = center + extent;
+    }
+    return result;
+}
+
+// Node layout shared by both levels: (bounds.min, first), (bounds.max, count),
+// with 'first' offset to an absolute node or primitive index.
+void packBvhNode(std::vector<float>& texels, const BvhNode& node, int firstBase) {
+    float first = static_cast<float>(node.first + firstBase);
+    texels.insert(texels.end(), { node.bounds.min[0], node.bounds.min[1], node.bounds.min[2], first });
+    texels.insert(texels.end(), { node.bounds.max[0], node.bounds.max[1], node.bounds.max[2],
+                                  static_cast<float>(node.count) });
+}
+
+// Packs nodes [begin, end) of a mesh's BVH. Leaves point at the mesh's
+// triangles, inner nodes at the mesh's node range.
+void packBvhNodes(std::vector<float>& texels, const Bvh& bvh, int begin, int end,
+                  int triangleBase, int nodeBase) {
+    for (int i = begin; i < end; i++) {
+        const BvhNode& node = bvh.nodes[i];
+        packBvhNode(texels, node, node.count > 0 ? triangleBase : nodeBase);
+    }
+}
+
+// Stores a word as the bits of a texel component; the shader reads it back
+// through the RGBA32UI view of the buffer.
+float wordTexel(unsigned int word) {
+    float value;
+    std::memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+// Packs four of a node's bytes, starting at slot 'first', into one word.
+unsigned int packBytes(const unsigned char* bytes, int first) {
+    return bytes[first] | bytes[first + 1] << 8 | bytes[first + 2] << 16 |
+        static_cast<unsigned int>(bytes[first + 3]) << 24;
+}
+
+// Wide node layout, five texels (80 bytes) for eight children:
+//   (origin.xyz as floats, exponent bytes x | y << 8 | z << 16)
+//   (childBase, primBase, meta bytes 0-3, meta bytes 4-7)
+//   (qlo.x 0-3, qlo.x 4-7, qlo.y 0-3, qlo.y 4-7)
+//   (qlo.z 0-3, qlo.z 4-7, qhi.x 0-3, qhi.x 4-7)
+//   (qhi.y 0-3, qhi.y 4-7, qhi.z 0-3, qhi.z 4-7)
+// with childBase and primBase made absolute.
+void packWideBvhNodes(std::vector<float>& texels, const WideBvh& bvh, int triangleBase, int nodeBase) {
+    for (const WideBvhNode& node : bvh.nodes) {
+        unsigned int exponents = node.exponent[0] | node.exponent[1] << 8 | node.exponent[2] << 16;
+        texels.insert(texels.end(), { node.origin[0], node.origin[1], node.origin[2], wordTexel(exponents) });
+        texels.insert(texels.end(), { wordTexel(node.childBase + nodeBase), wordTexel(node.primBase + triangleBase),
+                                      wordTexel(packBytes(node.meta, 0)), wordTexel(packBytes(node.meta, 4)) });
+        const unsigned char* planes[6] = { node.qlo[0], node.qlo[1], node.qlo[2], node.qhi[0], node.qhi[1], node.qhi[2] };
+        for (int p = 0; p < 6; p += 2) {
+            texels.insert(texels.end(), { wordTexel(packBytes(planes[p], 0)), wordTexel(packBytes(planes[p], 4)),
+                                          wordTexel(packBytes(planes[p + 1], 0)), wordTexel(packBytes(planes[p + 1], 4)) });
+        }
+    }
+}
+
+std::vector<Aabb> meshTriangleBounds(const Mesh& mesh) {
+    std::vector<Aabb> bounds;
+    bounds.reserve(mesh.indices.size() / 3);
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        Aabb box = emptyAabb();
+        for (int k = 0; k < 3; k++) {
+            growAabb(box, &mesh.positions[mesh.indices[i + k] * 3]);
+        }
+        bounds.push_back(box);
+    }
+    return bounds;
+}
+
+// Packs the mesh's triangles in the given order, e.g. the leaf order of its BVH.
+void packMeshTriangles(std::vector<float>& texels, const Mesh& mesh, const std::vector<int>& order) {
+    for (int triangle : order) {
+        const float* v0 = &mesh.positions[mesh.indices[triangle * 3] * 3];
+        const float* v1 = &mesh.positions[mesh.indices[triangle * 3 + 1] * 3];
+        const float* v2 = &mesh.positions[mesh.indices[triangle * 3 + 2] * 3];
+        texels.insert(texels.end(), { v0[0], v0[1], v0[2], static_cast<float>(mesh.material) });
+        texels.insert(texels.end(), { v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2], 0.0f });
+        texels.insert(texels.end(), { v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2], 0.0f });
+    }
+}
+
+void uploadTexels(GLuint buffer, int texelOffset, const std::vector<float>& texels) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, texelOffset * 4 * sizeof(float), texels.size() * sizeof(float), texels.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+}  // namespace
+
+SceneBuffers uploadSceneBuffers(const Scene& scene, bool wideBvh) {
+    SceneBuffers buffers;
+
+    // Layout (one vec4 per texel):
+    //   material: (albedo.rgb, checkerScale), (albedo2.rgb, 0)
+    //   sphere:   (center.xyz, radius), (material, 0, 0, 0)
+    //   plane:    (height, halfSize, material, 0)
+    //   triangle: (v0.xyz, material), (v1 - v0, 0), (v2 - v0, 0) in object space
+    //   BVH node: (min.xyz, first), (max.xyz, count)
+    //   wide BVH node: five texels of packed words, see packWideBvhNodes()
+    //   instance: world-to-object rows 0-2, (BLAS root, material, wide, 0)
+    std::vector<float> texels;
+    for (const Material& m : scene.materials) {
+        texels.insert(texels.end(), { m.albedo[0], m.albedo[1], m.albedo[2], m.checkerScale });
+        texels.insert(texels.end(), { m.albedo2[0], m.albedo2[1], m.albedo2[2], 0.0f });
+    }
+    buffers.sphereOffset = static_cast<int>(texels.size() / 4);
+    buffers.sphereCount = static_cast<int>(scene.spheres.size());
+    for (const Sphere& s : scene.spheres) {
+        texels.insert(texels.end(), { s.center[0], s.center[1], s.center[2], s.radius });
+        texels.insert(texels.end(), { static_cast<float>(s.material), 0.0f, 0.0f, 0.0f });
+    }
+    buffers.planeOffset = static_cast<int>(texels.size() / 4);
+    buffers.planeCount = static_cast<int>(scene.planes.size());
+    for (const FinitePlane& p : scene.planes) {
+        texels.insert(texels.end(), { p.height, p.halfSize, static_cast<float>(p.material), 0.0f });
+    }
+
+    // One bottom-level BVH per mesh; triangles are stored in leaf order so
+    // every leaf covers a contiguous triangle range. Static meshes get a
+    // compressed wide tree; animated ones keep a binary tree that can be
+    // refit in place.
+    buffers.triangleOffset = static_cast<int>(texels.size() / 4);
+    int triangleBase = 0;
+    std::vector<WideBvh> wideBlases(scene.meshes.size());
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        const Mesh& mesh = scene.meshes[m];
+        std::vector<Aabb> triangleBounds = meshTriangleBounds(mesh);
+        bool wide = wideBvh && mesh.twistAmount == 0.0f;
+        buffers.blases.push_back(buildBvh(triangleBounds, wide ? kWideLeafSize : kBlasLeafSize));
+        buffers.blasBuildCost.push_back(bvhSahCost(buffers.blases.back()));
+        buffers.blasCost.push_back(buffers.blasBuildCost.back());
+        buffers.blasWide.push_back(wide);
+        buffers.triangleBases.push_back(triangleBase);
+        if (wide) {
+            wideBlases[m] = collapseBvh(buffers.blases.back(), triangleBounds);
+            packMeshTriangles(texels, mesh, wideBlases[m].primIndices);
+        } else {
+            packMeshTriangles(texels, mesh, buffers.blases.back().primIndices);
+        }
+        triangleBase += static_cast<int>(mesh.indices.size() / 3);
+    }
+    buffers.triangleCount = triangleBase;
+    buffers.blasRebuilds.resize(scene.meshes.size());
+
+    buffers.blasNodeOffset = static_cast<int>(texels.size() / 4);
+    int nodeBase = 0;
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        const Bvh& blas = buffers.blases[m];
+        buffers.blasRoots.push_back(nodeBase);
+        buffers.blasBounds.push_back(blas.nodes[0].bounds);
+        if (buffers.blasWide[m]) {
+            buffers.binaryNodeCount += static_cast<int>(blas.nodes.size());
+            continue;
+        }
+        packBvhNodes(texels, blas, 0, static_cast<int>(blas.nodes.size()), buffers.triangleBases[m], nodeBase);
+        int capacity = std::max(2 * static_cast<int>(scene.meshes[m].indices.size() / 3) - 1, 1);
+        texels.resize((buffers.blasNodeOffset + nodeBase + capacity) * 2 * 4, 0.0f);
+        nodeBase += capacity;
+    }
+
+    buffers.wideNodeOffset = static_cast<int>(texels.size() / 4);
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        if (buffers.blasWide[m]) {
+            buffers.blasRoots[m] = buffers.wideNodeCount;
+            packWideBvhNodes(texels, wideBlases[m], buffers.triangleBases[m], buffers.wideNodeCount);
+            buffers.wideNodeCount += static_cast<int>(wideBlases[m].nodes.size());
+        }
+    }
+
+    // Instances and the top-level BVH are filled in by updateSceneInstances();
+    // a binary tree over n leaves never needs more than 2n - 1 nodes.
+    buffers.instanceOffset = static_cast<int>(texels.size() / 4);
+    buffers.instanceCount = static_cast<int>(scene.instances.size());
+    buffers.tlasNodeOffset = buffers.instanceOffset + buffers.instanceCount * 4;
+    int tlasCapacity = std::max(2 * buffers.instanceCount - 1, 1);
+    texels.resize((buffers.tlasNodeOffset + tlasCapacity * 2) * 4, 0.0f);
+
+    glGenBuffers(1, &buffers.buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers.buffer);
+    // Instances are rewritten every pass and animated meshes every frame
+    GLenum usage = scene.instances.empty() ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
+    glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(float), texels.data(), usage);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &buffers.texture);
+    glBindTexture(GL_TEXTURE_BUFFER, buffers.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffers.buffer);
+    // Second view of the same storage for the packed words of wide nodes
+    glGenTextures(1, &buffers.wordTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, buffers.wordTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, buffers.buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    updateSceneInstances(buffers, scene);
+    return buffers;
+}
+
+bool updateSceneMeshes(SceneBuffers& buffers, Scene& scene, float time, bool refitOnHost) {
+    auto start = std::chrono::steady_clock::now();
+    int threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    bool moved = false;
+    buffers.refitNodes = 0;
+
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        Mesh& mesh = scene.meshes[m];
+        if (!animateMesh(mesh, time)) {
+            continue;
+        }
+        moved = true;
+        if (!refitOnHost) {
+            // The caller rebuilds the tree on the GPU from the triangles in mesh
+            // order; the top level only needs the mesh bounds
+            Aabb bounds = emptyAabb();
+            for (size_t i = 0; i + 2 < mesh.positions.size(); i += 3) {
+                growAabb(bounds, &mesh.positions[i]);
+            }
+            buffers.blasBounds[m] = bounds;
+            std::vector<int> order(mesh.indices.size() / 3);
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = static_cast<int>(i);
+            }
+            std::vector<float> texels;
+            packMeshTriangles(texels, mesh, order);
+            uploadTexels(buffers.buffer, buffers.triangleOffset + buffers.triangleBases[m] * 3, texels);
+            continue;
+        }
+        std::vector<Aabb> triangleBounds = meshTriangleBounds(mesh);
+        Bvh& blas = buffers.blases[m];
+        int nodeBase = buffers.blasRoots[m];
+
+        // Swap in a finished background rebuild; its topology was built for an
+        // earlier pose, so it is refit below like any other tree
+        std::future<Bvh>& rebuild = buffers.blasRebuilds[m];
+        bool rebuilt = rebuild.valid() &&
+            rebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        if (rebuilt) {
+            blas = rebuild.get();
+        }
+
+        std::vector<unsigned char> changedNodes;
+        refitBvh(blas, triangleBounds, threadCount, changedNodes);
+        buffers.blasBounds[m] = blas.nodes[0].bounds;
+
+        // Every triangle of an animated mesh moves, so its whole range is sent;
+        // nodes only in the runs that changed (all of them after a rebuild)
+        std::vector<float> texels;
+        packMeshTriangles(texels, mesh, blas.primIndices);
+        uploadTexels(buffers.buffer, buffers.triangleOffset + buffers.triangleBases[m] * 3, texels);
+
+        int nodeCount = static_cast<int>(blas.nodes.size());
+        int i = 0;
+        while (i < nodeCount) {
+            if (!rebuilt && !changedNodes[i]) {
+                i++;
+                continue;
+            }
+            // Extend the run across short unchanged gaps
+            int end = i + 1;
+            int lastChanged = i;
+            while (end < nodeCount && (rebuilt || end - lastChanged <= kRefitUploadGap)) {
+                if (rebuilt || changedNodes[end]) {
+                    lastChanged = end;
+                }
+                end++;
+            }
+            end = lastChanged + 1;
+            texels.clear();
+            packBvhNodes(texels, blas, i, end, buffers.triangleBases[m], nodeBase);
+            uploadTexels(buffers.buffer, buffers.blasNodeOffset + (nodeBase + i) * 2, texels);
+            buffers.refitNodes += end - i;
+            i = end;
+        }
+
+        // Refitting keeps the topology of an old pose; once the tree has
+        // degraded enough, rebuild it from a snapshot without blocking the frame
+        float cost = bvhSahCost(blas);
+        if (rebuilt) {
+            std::cout << "Rebuilt BVH of mesh " << m << ": SAH cost " << buffers.blasCost[m]
+                      << " -> " << cost << "\n";
+            buffers.blasBuildCost[m] = cost;
+        } else if (!rebuild.valid() && cost > buffers.blasBuildCost[m] * kBvhRebuildThreshold) {
+            rebuild = std::async(std::launch::async, [triangleBounds]() {
+                return buildBvh(triangleBounds, kBlasLeafSize);
+            });
+        }
+        buffers.blasCost[m] = cost;
+    }
+
+    buffers.refitMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return moved;
+}
+
+void updateSceneInstances(SceneBuffers& buffers, const Scene& scene) {
+    if (buffers.instanceCount == 0) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Aabb> instanceBounds;
+    instanceBounds.reserve(scene.instances.size());
+    for (const MeshInstance& instance : scene.instances) {
+        instanceBounds.push_back(transformAabb(instance.transform, buffers.blasBounds[instance.mesh]));
+    }
+    Bvh tlas = buildBvh(instanceBounds, 1);
+
+    // Instance records go in leaf order so leaves cover contiguous ranges
+    std::vector<float> texels;
+    texels.reserve((buffers.instanceCount * 4 + tlas.nodes.size() * 2) * 4);
+    for (int index : tlas.primIndices) {
+        const MeshInstance& instance = scene.instances[index];
+        const Mesh& mesh = scene.meshes[instance.mesh];
+        float worldToObject[12];
+        invertAffine(instance.transform, worldToObject);
+        texels.insert(texels.end(), worldToObject, worldToObject + 12);
+        int material = instance.material >= 0 ? instance.material : mesh.material;
+        texels.insert(texels.end(), { static_cast<float>(buffers.blasRoots[instance.mesh]),
+                                      static_cast<float>(material),
+                                      buffers.blasWide[instance.mesh] ? 1.0f : 0.0f, 0.0f });
+    }
+    for (const BvhNode& node : tlas.nodes) {
+        packBvhNode(texels, node, 0);
+    }
+
+    uploadTexels(buffers.buffer, buffers.instanceOffset, texels);
+
+    buffers.tlasBuildMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+void bindSceneBuffers(GLuint program, const SceneBuffers& buffers, int textureUnit) {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, buffers.texture);
+    glUniform1i(glGetUniformLocation(program, "uScenePrims"), textureUnit);
+    glActiveTexture(GL_TEXTURE0 + kSceneWordsTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, buffers.wordTexture);
+    glUniform1i(glGetUniformLocation(program, "uSceneWords"), kSceneWordsTextureUnit);
+    glUniform1i(glGetUniformLocation(program, "uSphereOffset"), buffers.sphereOffset);
+    glUniform1i(glGetUniformLocation(program, "uSphereCount"), buffers.sphereCount);
+    glUniform1i(glGetUniformLocation(program, "uPlaneOffset"), buffers.planeOffset);
+    glUniform1i(glGetUniformLocation(program, "uPlaneCount"), buffers.planeCount);
+    glUniform1i(glGetUniformLocation(program, "uTriangleOffset"), buffers.triangleOffset);
+    glUniform1i(glGetUniformLocation(program, "uBlasNodeOffset"), buffers.blasNodeOffset);
+    glUniform1i(glGetUniformLocation(program, "uWideNodeOffset"), buffers.wideNodeOffset);
+    glUniform1i(glGetUniformLocation(program, "uInstanceOffset"), buffers.instanceOffset);
+    glUniform1i(glGetUniformLocation(program, "uInstanceCount"), buffers.instanceCount);
+    glUniform1i(glGetUniformLocation(program, "uTlasNodeOffset"), buffers.tlasNodeOffset);
+}
+
+void destroySceneBuffers(SceneBuffers& buffers) {
+    glDeleteTextures(1, &buffers.texture);
+    glDeleteTextures(1, &buffers.wordTexture);
+    glDeleteBuffers(1, &buffers.buffer);
+    buffers = SceneBuffers();
+}
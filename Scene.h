@@ -0,0 +1,169 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "Bvh.h"
+#include <GL/glew.h>
+#include <future>
+#include <vector>
+
+// Surface description shared by all primitives. A non-zero checkerScale
+// alternates between albedo and albedo2 in a world-space XZ checkerboard.
+struct Material {
+    float albedo[3];
+    float albedo2[3];
+    float checkerScale;
+};
+
+struct Sphere {
+    float center[3];
+    float radius;
+    int material;
+};
+
+// Axis-aligned square lying in the XZ plane at the given height.
+struct FinitePlane {
+    float height;
+    float halfSize;
+    int material;
+};
+
+// Triangle mesh in object space, placed in the world by MeshInstances.
+// Every three consecutive indices form a triangle.
+struct Mesh {
+    std::vector<float> positions;  // xyz per vertex, current pose
+    std::vector<unsigned int> indices;
+    int material;
+    // Optional vertex animation: the rest pose is twisted around the Y axis by
+    // an angle proportional to height that swings back and forth over time.
+    // Meshes with twistAmount == 0 never move.
+    float twistAmount = 0.0f;  // peak twist in radians per unit of height
+    float twistSpeed = 0.0f;   // radians per second of the swing
+    std::vector<float> restPositions;
+};
+
+// One placement of a mesh. Many instances share the mesh's geometry and its
+// bottom-level BVH; only the transform and material are per instance.
+struct MeshInstance {
+    int mesh;
+    int material;         // -1 uses the mesh's own material
+    float transform[12];  // object-to-world, row-major 3x4
+};
+
+// Host-side description of everything the tracer can hit.
+struct Scene {
+    std::vector<Material> materials;
+    std::vector<Sphere> spheres;
+    std::vector<FinitePlane> planes;
+    std::vector<Mesh> meshes;
+    std::vector<MeshInstance> instances;
+};
+
+// SAH cost growth, relative to the freshly built tree, at which a refit
+// mesh BVH is rebuilt.
+const float kBvhRebuildThreshold = 1.25f;
+
+// Texture unit of the RGBA32UI view of the scene buffer.
+const int kSceneWordsTextureUnit = 4;
+
+// GPU copy of a scene for the generic, buffer-driven shader path.
+// All primitives live in one RGBA32F texture buffer: materials first,
+// then spheres, planes, mesh triangles, the binary bottom-level BVH nodes of
+// animated meshes, the wide bottom-level nodes of static meshes, the
+// instances and finally the top-level BVH nodes over the instances.
+// The instances and top-level nodes come last so a rebuild of the top level
+// only rewrites the tail of the buffer.
+struct SceneBuffers {
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    GLuint wordTexture = 0;  // same storage as integer words
+    int sphereOffset = 0;
+    int sphereCount = 0;
+    int planeOffset = 0;
+    int planeCount = 0;
+    int triangleOffset = 0;
+    int triangleCount = 0;
+    int blasNodeOffset = 0;
+    int wideNodeOffset = 0;
+    int instanceOffset = 0;
+    int instanceCount = 0;
+    int tlasNodeOffset = 0;
+    std::vector<int> blasRoots;     // bottom-level root node of each mesh
+    std::vector<bool> blasWide;     // whether that root is a wide node
+    std::vector<Aabb> blasBounds;   // object-space bounds of each mesh
+    double tlasBuildMs = 0.0;    // host time of the latest top-level rebuild
+    int wideNodeCount = 0;       // wide nodes over all static meshes
+    int binaryNodeCount = 0;     // binary nodes the meshes' trees were collapsed from
+
+    // Host copies of the bottom-level trees, refit in place when meshes move.
+    // Each mesh owns room for 2n - 1 nodes so a rebuild never moves the others.
+    std::vector<Bvh> blases;
+    std::vector<int> triangleBases;     // first triangle of each mesh
+    std::vector<float> blasBuildCost;   // SAH cost when the tree was last built
+    std::vector<float> blasCost;        // SAH cost after the latest refit
+    std::vector<std::future<Bvh>> blasRebuilds;  // background rebuilds in flight
+    double refitMs = 0.0;        // host time of the latest mesh update
+    int refitNodes = 0;          // nodes re-uploaded by the latest mesh update
+};
+
+// Builds the default scene: a red sphere above a large checkerboard floor.
+Scene createDefaultScene();
+
+// Default scene plus a finely tessellated torus mesh.
+Scene createMeshScene();
+
+// Default scene plus a field of over two thousand instances of one torus mesh.
+Scene createInstancedScene();
+
+// Default scene plus two instances of a twisting torus.
+Scene createAnimatedScene();
+
+// Builds a torus around the object-space Y axis with the given number of
+// segments around the axis and sides around the tube.
+Mesh createTorusMesh(float majorRadius, float minorRadius, int segments, int sides, int material);
+
+// Places a mesh at 'position', rotated by yaw (around Y) then tilted by
+// pitch (around X), uniformly scaled.
+MeshInstance makeMeshInstance(int mesh, int material, const float position[3],
+                              float yaw, float pitch, float scale);
+
+// Applies a row-major 3x4 transform to a point.
+void transformPoint(const float transform[12], const float point[3], float result[3]);
+
+// Recomputes the positions of an animated mesh for the given time. Returns
+// false for static meshes.
+bool animateMesh(Mesh& mesh, float time);
+
+// True when any mesh of the scene is animated.
+bool sceneAnimated(const Scene& scene);
+
+// Number of world-space triangles over all instances of the scene.
+int sceneTriangleCount(const Scene& scene);
+
+// Total number of primitives (analytic primitives and triangles) in the scene.
+int scenePrimitiveCount(const Scene& scene);
+
+// Packs the scene into a texture buffer for the generic shader path. With
+// wideBvh false static meshes keep binary trees as well.
+SceneBuffers uploadSceneBuffers(const Scene& scene, bool wideBvh = true);
+
+// Animates the scene's meshes to 'time', refits their bottom-level BVHs and
+// uploads the triangles and the node ranges that changed. A mesh whose tree
+// has degraded past kBvhRebuildThreshold times its build cost is rebuilt on
+// a background thread and swapped in once ready. With refitOnHost false only
+// the triangles are uploaded, in mesh order, for buildGpuBvh() to rebuild the
+// trees. Returns true if any mesh moved.
+bool updateSceneMeshes(SceneBuffers& buffers, Scene& scene, float time, bool refitOnHost = true);
+
+// Rebuilds the top-level BVH from the current instance transforms and uploads
+// the instance records and top-level nodes. The instance count must not change.
+void updateSceneInstances(SceneBuffers& buffers, const Scene& scene);
+
+// Binds the scene texture buffer to the given texture unit and sets the
+// uScenePrims/offset/count uniforms on the currently used program. The
+// integer view goes to kSceneWordsTextureUnit.
+void bindSceneBuffers(GLuint program, const SceneBuffers& buffers, int textureUnit);
+
+// Releases the GL objects owned by the scene buffers.
+void destroySceneBuffers(SceneBuffers& buffers);
+
+#endif  // SCENE_H
@@ -0,0 +1,132 @@
+#include "SceneCodegen.h"
+#include "Shader.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char* kSceneMarker = "// @SCENE_INTERSECT@";
+
+// Formats a float as a GLSL float literal that round-trips exactly.
+std::string glslFloat(float value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+    std::string s = buf;
+    if (s.find_first_of(".eEn") == std::string::npos) {
+        s += ".0";
+    }
+    return s;
+}
+
+std::string glslVec3(const float v[3]) {
+    return "vec3(" + glslFloat(v[0]) + ", " + glslFloat(v[1]) + ", " + glslFloat(v[2]) + ")";
+}
+
+// Expression for the base color of a hit at 'hitPos' with the given material.
+std::string materialColorExpr(const Material& m) {
+    if (m.checkerScale == 0.0f) {
+        return glslVec3(m.albedo);
+    }
+    return "checkerColor(hitPos, " + glslFloat(m.checkerScale) + ", " +
+        glslVec3(m.albedo) + ", " + glslVec3(m.albedo2) + ")";
+}
+
+const Material& materialOf(const Scene& scene, int index) {
+    static const Material fallback = { { 1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 1.0f }, 0.0f };
+    if (index < 0 || index >= static_cast<int>(scene.materials.size())) {
+        return fallback;
+    }
+    return scene.materials[index];
+}
+
+}  // namespace
+
+bool shouldSpecializeScene(const Scene& scene) {
+    // Animated vertices cannot be baked in as constants
+    return scenePrimitiveCount(scene) <= kSceneSpecializationThreshold && !sceneAnimated(scene);
+}
+
+std::string generateSceneIntersectGLSL(const Scene& scene) {
+    std::string code;
+    code += "// Generated by generateSceneIntersectGLSL(): one unrolled test per primitive.\n";
+    code += "bool intersectScene(vec3 ro, vec3 rd, bool withTriangles, out float t, out vec3 hitNormal, out vec3 baseColor) {\n";
+    code += "    t = 1e20;\n";
+    code += "    bool hit = false;\n";
+    code += "    vec3 n;\n";
+    code += "    float tHit;\n";
+    code += "    vec3 hitPos;\n";
+
+    for (size_t i = 0; i < scene.spheres.size(); i++) {
+        const Sphere& s = scene.spheres[i];
+        code += "\n    // Sphere " + std::to_string(i) + "\n";
+        code += "    tHit = intersectSphere(ro, rd, " + glslVec3(s.center) + ", " + glslFloat(s.radius) + ", n);\n";
+        code += "    if (tHit > 0.0 && tHit < t) {\n";
+        code += "        t = tHit;\n";
+        code += "        hitNormal = n;\n";
+        code += "        hitPos = ro + t * rd;\n";
+        code += "        baseColor = " + materialColorExpr(materialOf(scene, s.material)) + ";\n";
+        code += "        hit = true;\n";
+        code += "    }\n";
+    }
+
+    for (size_t i = 0; i < scene.planes.size(); i++) {
+        const FinitePlane& p = scene.planes[i];
+        code += "\n    // Plane " + std::to_string(i) + "\n";
+        code += "    tHit = intersectFinitePlane(ro, rd, " + glslFloat(p.height) + ", " + glslFloat(p.halfSize) + ", n);\n";
+        code += "    if (tHit > 0.0 && tHit < t) {\n";
+        code += "        t = tHit;\n";
+        code += "        hitNormal = n;\n";
+        code += "        hitPos = ro + t * rd;\n";
+        code += "        baseColor = " + materialColorExpr(materialOf(scene, p.material)) + ";\n";
+        code += "        hit = true;\n";
+        code += "    }\n";
+    }
+
+    if (!scene.instances.empty()) {
+        // Small scenes need no BVH: every instance's triangles are baked in world space
+        code += "\n    if (withTriangles) {\n";
+        for (size_t n = 0; n < scene.instances.size(); n++) {
+            const MeshInstance& instance = scene.instances[n];
+            const Mesh& mesh = scene.meshes[instance.mesh];
+            int material = instance.material >= 0 ? instance.material : mesh.material;
+            std::string color = materialColorExpr(materialOf(scene, material));
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                float v0[3], v1[3], v2[3];
+                transformPoint(instance.transform, &mesh.positions[mesh.indices[i] * 3], v0);
+                transformPoint(instance.transform, &mesh.positions[mesh.indices[i + 1] * 3], v1);
+                transformPoint(instance.transform, &mesh.positions[mesh.indices[i + 2] * 3], v2);
+                float e1[3] = { v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2] };
+                float e2[3] = { v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2] };
+                code += "        // Instance " + std::to_string(n) + ", triangle " + std::to_string(i / 3) + "\n";
+                code += "        tHit = intersectTriangle(ro, rd, " + glslVec3(v0) + ", " + glslVec3(e1) + ", " + glslVec3(e2) + ", n);\n";
+                code += "        if (tHit > 0.0 && tHit < t) {\n";
+                code += "            t = tHit;\n";
+                code += "            hitNormal = n;\n";
+                code += "            hitPos = ro + t * rd;\n";
+                code += "            baseColor = " + color + ";\n";
+                code += "            hit = true;\n";
+                code += "        }\n";
+            }
+        }
+        code += "    }\n";
+    }
+
+    code += "    return hit;\n";
+    code += "}\n";
+    return code;
+}
+
+std::string buildSceneFragmentSource(const std::string& source, const Scene& scene, bool specialize) {
+    if (!specialize) {
+        return source;
+    }
+    std::string result = source;
+    size_t markerPos = result.find(kSceneMarker);
+    if (markerPos == std::string::npos) {
+        std::cerr << "Scene marker not found in fragment shader, using generic scene path\n";
+        return source;
+    }
+    result.replace(markerPos, std::strlen(kSceneMarker), generateSceneIntersectGLSL(scene));
+    return addShaderDefines(result, { "SCENE_SPECIALIZED" });
+}
@@ -0,0 +1,24 @@
+#ifndef SCENE_CODEGEN_H
+#define SCENE_CODEGEN_H
+
+#include "Scene.h"
+#include <string>
+
+// Scenes with at most this many primitives get a specialised shader with
+// every primitive baked in as constants. Larger scenes use the generic loop
+// over the scene texture buffer, which compiles once regardless of size.
+const int kSceneSpecializationThreshold = 32;
+
+// Returns true when the scene is small and static enough for the specialised path.
+bool shouldSpecializeScene(const Scene& scene);
+
+// Emits GLSL for intersectScene() with one unrolled intersection test per
+// primitive and all centers, radii and materials as literal constants.
+std::string generateSceneIntersectGLSL(const Scene& scene);
+
+// Prepares the trace fragment shader source: when specialize is true the
+// generated intersectScene() replaces the // @SCENE_INTERSECT@ marker and
+// SCENE_SPECIALIZED is defined, otherwise the generic path is left in place.
+std::string buildSceneFragmentSource(const std::string& source, const Scene& scene, bool specialize);
+
+#endif  // SCENE_CODEGEN_H
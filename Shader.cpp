@@ -34,7 +34,10 @@ GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath) {
     // Read shader source code from files.
     std::string vertexCode = readFile(vertexPath);
     std::string fragmentCode = readFile(fragmentPath);
+    return createShaderProgramFromSource(vertexCode, fragmentCode);
+}
 
+GLuint createShaderProgramFromSource(const std::string& vertexCode, const std::string& fragmentCode) {
     // Compile shaders.
     GLuint vertexShader = compileShader(vertexCode.c_str(), GL_VERTEX_SHADER);
     GLuint fragmentShader = compileShader(fragmentCode.c_str(), GL_FRAGMENT_SHADER);
@@ -60,3 +63,43 @@ GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath) {
 
     return shaderProgram;
 }
+
+GLuint createComputeProgramFromSource(const std::string& computeCode) {
+    GLuint computeShader = compileShader(computeCode.c_str(), GL_COMPUTE_SHADER);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, computeShader);
+    glLinkProgram(program);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "Shader linking error:\n" << infoLog << "\n";
+    }
+
+    glDeleteShader(computeShader);
+    return program;
+}
+
+std::string addShaderDefines(const std::string& source, const std::vector<std::string>& defines) {
+    if (defines.empty()) {
+        return source;
+    }
+    std::string block;
+    for (const std::string& define : defines) {
+        block += "#define " + define + "\n";
+    }
+
+    // GLSL requires #version to be the first directive, so the defines go on the line after it.
+    size_t versionPos = source.find("#version");
+    if (versionPos == std::string::npos) {
+        return block + source;
+    }
+    size_t lineEnd = source.find('\n', versionPos);
+    if (lineEnd == std::string::npos) {
+        return source + "\n" + block;
+    }
+    return source.substr(0, lineEnd + 1) + block + source.substr(lineEnd + 1);
+}
@@ -3,6 +3,7 @@
 
 #include <GL/glew.h>
 #include <string>
+#include <vector>
 
 // Reads the contents of a file and returns it as a string.
 std::string readFile(const char* filePath);
@@ -13,4 +14,14 @@ GLuint compileShader(const char* source, GLenum shaderType);
 // Creates a shader program from vertex and fragment shader files.
 GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath);
 
+// Creates a shader program from in-memory vertex and fragment shader sources.
+GLuint createShaderProgramFromSource(const std::string& vertexCode, const std::string& fragmentCode);
+
+// Creates a compute shader program from in-memory source (needs GL 4.3).
+GLuint createComputeProgramFromSource(const std::string& computeCode);
+
+// Inserts "#define NAME" lines directly after the #version directive so one
+// shader file can be compiled into several permutations.
+std::string addShaderDefines(const std::string& source, const std::vector<std::string>& defines);
+
 #endif  // SHADER_H
@@ -0,0 +1,165 @@
+#include "Svgf.h"
+#include "Shader.h"
+
+namespace {
+
+RenderTarget createHistoryTarget(int width, int height) {
+    return createRenderTarget(width, height, { GL_RGBA16F, GL_RGBA16F, GL_RGBA32F, GL_RGBA32F, GL_R16F });
+}
+
+RenderTarget createFilterTarget(int width, int height) {
+    return createRenderTarget(width, height, { GL_RGBA16F, GL_RGBA16F });
+}
+
+void bindTextures(GLuint program, const char* const* names, const GLuint* textures, int count) {
+    for (int i = 0; i < count; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glUniform1i(glGetUniformLocation(program, names[i]), i);
+    }
+}
+
+void drawInto(const RenderTarget& target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glViewport(0, 0, target.width, target.height);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// Copies one color attachment of 'source' into the same attachment of 'dest'.
+void copyAttachment(const RenderTarget& source, const RenderTarget& dest, int attachment) {
+    GLenum buffer = GL_COLOR_ATTACHMENT0 + attachment;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo);
+    glReadBuffer(buffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dest.fbo);
+
+    // Restrict the draw buffers to the one attachment for the blit, then restore them.
+    std::vector<GLenum> only(dest.textures.size(), GL_NONE);
+    only[attachment] = buffer;
+    glDrawBuffers(static_cast<GLsizei>(only.size()), only.data());
+    glBlitFramebuffer(0, 0, source.width, source.height, 0, 0, dest.width, dest.height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    std::vector<GLenum> all;
+    for (size_t i = 0; i < dest.textures.size(); i++) {
+        all.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+    }
+    glDrawBuffers(static_cast<GLsizei>(all.size()), all.data());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+}  // namespace
+
+void createSvgf(SvgfState& svgf, int width, int height) {
+    for (int i = 0; i < 2; i++) {
+        svgf.history[i] = createHistoryTarget(width, height);
+        svgf.filter[i] = createFilterTarget(width, height);
+    }
+    svgf.output = createRenderTarget(width, height, { GL_RGBA16F });
+    svgf.current = 0;
+    svgf.valid = false;
+
+    svgf.temporalProgram = createShaderProgram("vertex_shader.glsl", "svgf_temporal_shader.glsl");
+    svgf.varianceProgram = createShaderProgram("vertex_shader.glsl", "svgf_variance_shader.glsl");
+    svgf.atrousProgram = createShaderProgram("vertex_shader.glsl", "svgf_atrous_shader.glsl");
+    svgf.modulateProgram = createShaderProgram("vertex_shader.glsl", "svgf_modulate_shader.glsl");
+}
+
+void resizeSvgf(SvgfState& svgf, int width, int height) {
+    if (svgf.output.width == width && svgf.output.height == height) {
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        resizeRenderTarget(svgf.history[i], width, height);
+        resizeRenderTarget(svgf.filter[i], width, height);
+    }
+    resizeRenderTarget(svgf.output, width, height);
+    svgf.valid = false;
+}
+
+void resetSvgf(SvgfState& svgf) {
+    svgf.valid = false;
+}
+
+GLuint applySvgf(SvgfState& svgf, const RenderTarget& traceTarget,
+                 const CameraState& camera, float aspect, float fov) {
+    const RenderTarget& previous = svgf.history[svgf.current];
+    const RenderTarget& next = svgf.history[1 - svgf.current];
+
+    // 1) Temporal accumulation of demodulated lighting and its moments
+    glUseProgram(svgf.temporalProgram);
+    {
+        const char* names[9] = {
+            "uColor", "uGeom", "uAlbedo", "uIndirect",
+            "uPrevDirect", "uPrevIndirect", "uPrevMoments", "uPrevGeom", "uPrevHistoryLength"
+        };
+        GLuint textures[9] = {
+            traceTarget.textures[0], traceTarget.textures[1], traceTarget.textures[2], traceTarget.textures[3],
+            previous.textures[0], previous.textures[1], previous.textures[2], previous.textures[3], previous.textures[4]
+        };
+        bindTextures(svgf.temporalProgram, names, textures, 9);
+    }
+    setCameraUniforms(svgf.temporalProgram, "uCam", camera);
+    setCameraUniforms(svgf.temporalProgram, "uPrevCam", svgf.camera);
+    glUniform1f(glGetUniformLocation(svgf.temporalProgram, "uAspect"), aspect);
+    glUniform1f(glGetUniformLocation(svgf.temporalProgram, "uFov"), fov);
+    glUniform1i(glGetUniformLocation(svgf.temporalProgram, "uHistoryValid"), svgf.valid ? 1 : 0);
+    drawInto(next);
+
+    // 2) Per-pixel variance from the moments (spatial estimate for young histories)
+    glUseProgram(svgf.varianceProgram);
+    {
+        const char* names[5] = { "uDirect", "uIndirect", "uMoments", "uGeom", "uHistoryLength" };
+        GLuint textures[5] = { next.textures[0], next.textures[1], next.textures[2], next.textures[3], next.textures[4] };
+        bindTextures(svgf.varianceProgram, names, textures, 5);
+    }
+    drawInto(svgf.filter[0]);
+
+    // 3) Variance-guided a-trous iterations. The first iteration's result is
+    //    fed back as the color history for the next frame.
+    glUseProgram(svgf.atrousProgram);
+    int source = 0;
+    for (int i = 0; i < kSvgfAtrousIterations; i++) {
+        const RenderTarget& in = svgf.filter[source];
+        const RenderTarget& out = svgf.filter[1 - source];
+        const char* names[3] = { "uDirect", "uIndirect", "uGeom" };
+        GLuint textures[3] = { in.textures[0], in.textures[1], next.textures[3] };
+        bindTextures(svgf.atrousProgram, names, textures, 3);
+        glUniform1i(glGetUniformLocation(svgf.atrousProgram, "uStepSize"), 1 << i);
+        drawInto(out);
+        source = 1 - source;
+
+        if (i == 0) {
+            copyAttachment(out, next, 0);
+            copyAttachment(out, next, 1);
+            glUseProgram(svgf.atrousProgram);
+        }
+    }
+
+    // 4) Remodulate with this frame's albedo
+    glUseProgram(svgf.modulateProgram);
+    {
+        const char* names[3] = { "uDirect", "uIndirect", "uAlbedo" };
+        GLuint textures[3] = { svgf.filter[source].textures[0], svgf.filter[source].textures[1], traceTarget.textures[2] };
+        bindTextures(svgf.modulateProgram, names, textures, 3);
+    }
+    drawInto(svgf.output);
+
+    svgf.current = 1 - svgf.current;
+    svgf.valid = true;
+    svgf.camera = camera;
+    return svgf.output.textures[0];
+}
+
+void destroySvgf(SvgfState& svgf) {
+    for (int i = 0; i < 2; i++) {
+        destroyRenderTarget(svgf.history[i]);
+        destroyRenderTarget(svgf.filter[i]);
+    }
+    destroyRenderTarget(svgf.output);
+    glDeleteProgram(svgf.temporalProgram);
+    glDeleteProgram(svgf.varianceProgram);
+    glDeleteProgram(svgf.atrousProgram);
+    glDeleteProgram(svgf.modulateProgram);
+    svgf = SvgfState();
+}
@@ -0,0 +1,49 @@
+#ifndef SVGF_H
+#define SVGF_H
+
+#include "Camera.h"
+#include "RenderTarget.h"
+
+// Number of edge-avoiding a-trous iterations (step sizes 1, 2, 4, ...).
+const int kSvgfAtrousIterations = 5;
+
+// Spatiotemporal variance-guided filtering (Schied et al. 2017) of the trace output.
+//
+// The trace target must provide: 0 radiance, 1 normal/depth, 2 albedo,
+// 3 indirect radiance. Lighting is demodulated by albedo, integrated over
+// time together with its luminance moments, filtered by a variance-guided
+// a-trous wavelet, then remodulated.
+struct SvgfState {
+    // Ping-pong history: 0 direct, 1 indirect, 2 moments, 3 normal/depth, 4 history length.
+    RenderTarget history[2];
+    // Ping-pong a-trous buffers: 0 direct + variance, 1 indirect + variance.
+    RenderTarget filter[2];
+    RenderTarget output;
+    int current = 0;
+    bool valid = false;
+    CameraState camera = {};
+
+    GLuint temporalProgram = 0;
+    GLuint varianceProgram = 0;
+    GLuint atrousProgram = 0;
+    GLuint modulateProgram = 0;
+};
+
+// Allocates the intermediate targets and compiles the svgf_*_shader.glsl programs.
+void createSvgf(SvgfState& svgf, int width, int height);
+
+// Matches the trace resolution; a size change drops the history.
+void resizeSvgf(SvgfState& svgf, int width, int height);
+
+// Drops the temporal history, e.g. when a toggle changes the image.
+void resetSvgf(SvgfState& svgf);
+
+// Runs the whole pipeline on this frame's trace output and returns the
+// texture with the filtered image. Expects the full-screen quad VAO to be bound.
+GLuint applySvgf(SvgfState& svgf, const RenderTarget& traceTarget,
+                 const CameraState& camera, float aspect, float fov);
+
+// Releases targets and programs.
+void destroySvgf(SvgfState& svgf);
+
+#endif  // SVGF_H
@@ -0,0 +1,84 @@
+#include "TemporalReprojection.h"
+#include "Shader.h"
+
+namespace {
+
+RenderTarget createHistoryTarget(int width, int height) {
+    return createRenderTarget(width, height, { GL_RGBA32F, GL_RGBA32F, GL_RGBA32F });
+}
+
+}  // namespace
+
+void createTemporalHistory(TemporalHistory& history, int width, int height) {
+    history.targets[0] = createHistoryTarget(width, height);
+    history.targets[1] = createHistoryTarget(width, height);
+    history.current = 0;
+    history.valid = false;
+    history.program = createShaderProgram("vertex_shader.glsl", "reproject_shader.glsl");
+}
+
+void resizeTemporalHistory(TemporalHistory& history, int width, int height) {
+    if (history.targets[0].width == width && history.targets[0].height == height) {
+        return;
+    }
+    resizeRenderTarget(history.targets[0], width, height);
+    resizeRenderTarget(history.targets[1], width, height);
+    history.valid = false;
+}
+
+void resetTemporalHistory(TemporalHistory& history) {
+    history.valid = false;
+}
+
+GLuint applyTemporalReprojection(TemporalHistory& history, const RenderTarget& traceTarget,
+                                 const CameraState& camera, float aspect, float fov) {
+    const RenderTarget& previous = history.targets[history.current];
+    const RenderTarget& next = history.targets[1 - history.current];
+
+    glBindFramebuffer(GL_FRAMEBUFFER, next.fbo);
+    glViewport(0, 0, next.width, next.height);
+    glUseProgram(history.program);
+
+    // Units 0-1: this frame, units 2-4: history.
+    const char* samplers[5] = { "uCurrentColor", "uCurrentGeom", "uHistoryColor", "uHistoryGeom", "uHistoryMoments" };
+    GLuint textures[5] = {
+        traceTarget.textures[0], traceTarget.textures[1],
+        previous.textures[0], previous.textures[1], previous.textures[2]
+    };
+    for (int i = 0; i < 5; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glUniform1i(glGetUniformLocation(history.program, samplers[i]), i);
+    }
+
+    bool cameraMoved = !cameraStatesEqual(camera, history.camera);
+    setCameraUniforms(history.program, "uCam", camera);
+    setCameraUniforms(history.program, "uPrevCam", history.camera);
+    glUniform1f(glGetUniformLocation(history.program, "uAspect"), aspect);
+    glUniform1f(glGetUniformLocation(history.program, "uFov"), fov);
+    glUniform1i(glGetUniformLocation(history.program, "uHistoryValid"), history.valid ? 1 : 0);
+    glUniform1f(glGetUniformLocation(history.program, "uMaxHistory"),
+                cameraMoved ? kMovingHistoryCap : kStaticHistoryCap);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    history.current = 1 - history.current;
+    history.valid = true;
+    history.camera = camera;
+    return next.textures[0];
+}
+
+const RenderTarget& currentTemporalHistory(const TemporalHistory& history) {
+    return history.targets[history.current];
+}
+
+bool temporalCameraMoved(const TemporalHistory& history, const CameraState& camera) {
+    return !history.valid || !cameraStatesEqual(camera, history.camera);
+}
+
+void destroyTemporalHistory(TemporalHistory& history) {
+    destroyRenderTarget(history.targets[0]);
+    destroyRenderTarget(history.targets[1]);
+    glDeleteProgram(history.program);
+    history = TemporalHistory();
+}
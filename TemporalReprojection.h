@@ -0,0 +1,52 @@
+#ifndef TEMPORAL_REPROJECTION_H
+#define TEMPORAL_REPROJECTION_H
+
+#include "Camera.h"
+#include "RenderTarget.h"
+
+// Accumulated sample cap while the camera moves. Lower values react faster
+// to disocclusion and lighting changes, higher values hide more noise.
+const float kMovingHistoryCap = 16.0f;
+
+// Cap while the camera is still: effectively unbounded progressive accumulation.
+const float kStaticHistoryCap = 65536.0f;
+
+// Ping-pong history for temporal reprojection. Each target holds
+// the accumulated radiance (rgb) with its sample count (a) in attachment 0,
+// the primary normal (xyz) and hit distance (w) in attachment 1 and the
+// luminance moments (mean, mean of squares, frames) in attachment 2.
+struct TemporalHistory {
+    RenderTarget targets[2];
+    int current = 0;     // index of the target holding the latest history
+    bool valid = false;  // false until the first frame after a reset
+    GLuint program = 0;
+    CameraState camera = {};  // camera the latest history was rendered with
+};
+
+// Allocates history targets of the given size and compiles reproject_shader.glsl.
+void createTemporalHistory(TemporalHistory& history, int width, int height);
+
+// Resizes the history to match the trace target; a size change drops the history.
+void resizeTemporalHistory(TemporalHistory& history, int width, int height);
+
+// Drops the accumulated history, e.g. when a toggle changes the image.
+void resetTemporalHistory(TemporalHistory& history);
+
+// Reprojects the previous history into the current view, validates it by
+// depth and normal similarity and blends it with this frame's samples from
+// traceTarget (color in attachment 0, normal/depth in attachment 1).
+// Returns the texture holding the accumulated result. Expects the full-screen
+// quad VAO to be bound.
+GLuint applyTemporalReprojection(TemporalHistory& history, const RenderTarget& traceTarget,
+                                 const CameraState& camera, float aspect, float fov);
+
+// Target holding the latest accumulated history.
+const RenderTarget& currentTemporalHistory(const TemporalHistory& history);
+
+// True if the camera differs from the one the latest history was rendered with.
+bool temporalCameraMoved(const TemporalHistory& history, const CameraState& camera);
+
+// Releases targets and program.
+void destroyTemporalHistory(TemporalHistory& history);
+
+#endif  // TEMPORAL_REPROJECTION_H
@@ -0,0 +1,58 @@
+#include "TileList.h"
+
+void createTileList(TileList& list) {
+    glGenBuffers(1, &list.buffer);
+    glGenTextures(1, &list.texture);
+    list.count = 0;
+    list.capacity = 0;
+}
+
+void uploadTileList(TileList& list, const std::vector<uint32_t>& tiles) {
+    list.count = static_cast<int>(tiles.size());
+    if (tiles.empty()) {
+        return;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, list.buffer);
+    if (list.count > list.capacity) {
+        // Grow (and re-attach) only when needed; otherwise update in place.
+        list.capacity = list.count;
+        glBufferData(GL_TEXTURE_BUFFER, tiles.size() * sizeof(uint32_t), tiles.data(), GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, list.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, list.buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    else {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, tiles.size() * sizeof(uint32_t), tiles.data());
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void initTileListUniforms(GLuint program) {
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uTiles"), kTileListTextureUnit);
+    glUniform1i(glGetUniformLocation(program, "uTiled"), 0);
+    glUseProgram(0);
+}
+
+void drawTileList(const TileList& list, GLuint program, int tileSize, int targetWidth, int targetHeight) {
+    if (list.count == 0) {
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + kTileListTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, list.texture);
+    glUniform1i(glGetUniformLocation(program, "uTileSize"), tileSize);
+    glUniform2f(glGetUniformLocation(program, "uTargetSize"), static_cast<float>(targetWidth), static_cast<float>(targetHeight));
+    glUniform1i(glGetUniformLocation(program, "uTiled"), 1);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, list.count);
+
+    // Leave the program in full-screen mode for other draws.
+    glUniform1i(glGetUniformLocation(program, "uTiled"), 0);
+}
+
+void destroyTileList(TileList& list) {
+    glDeleteTextures(1, &list.texture);
+    glDeleteBuffers(1, &list.buffer);
+    list = TileList();
+}
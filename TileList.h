@@ -0,0 +1,42 @@
+#ifndef TILE_LIST_H
+#define TILE_LIST_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+// Texture unit reserved for the tile buffer in programs using tile_vertex_shader.glsl.
+const int kTileListTextureUnit = 7;
+
+// A compacted list of screen tiles drawn with one instanced call.
+// tile_vertex_shader.glsl expands instance i into the quad covering tile i.
+struct TileList {
+    GLuint buffer = 0;
+    GLuint texture = 0;  // GL_R32UI texture buffer over 'buffer'
+    int count = 0;
+    int capacity = 0;
+};
+
+// Packs tile coordinates the way tile_vertex_shader.glsl unpacks them.
+inline uint32_t packTile(int x, int y) {
+    return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 16);
+}
+
+void createTileList(TileList& list);
+
+// Replaces the list contents with the given packed tiles.
+void uploadTileList(TileList& list, const std::vector<uint32_t>& tiles);
+
+// Points uTiles of a program using tile_vertex_shader.glsl at its reserved
+// texture unit. Call once after linking: samplers of different types must not
+// share a unit, and uTiles would otherwise default to unit 0.
+void initTileListUniforms(GLuint program);
+
+// Draws every tile of the list into the bound framebuffer with the current
+// program, which must use tile_vertex_shader.glsl. The full-screen quad VAO
+// must be bound.
+void drawTileList(const TileList& list, GLuint program, int tileSize, int targetWidth, int targetHeight);
+
+void destroyTileList(TileList& list);
+
+#endif  // TILE_LIST_H
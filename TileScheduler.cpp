@@ -0,0 +1,76 @@
+#include "TileScheduler.h"
+#include <algorithm>
+
+void createTileScheduler(TileScheduler& scheduler, int width, int height) {
+    createTileList(scheduler.batch);
+    resizeTileScheduler(scheduler, width, height);
+}
+
+void resizeTileScheduler(TileScheduler& scheduler, int width, int height) {
+    scheduler.tilesX = (width + kSliceTileSize - 1) / kSliceTileSize;
+    scheduler.tilesY = (height + kSliceTileSize - 1) / kSliceTileSize;
+    restartTilePass(scheduler);
+}
+
+void restartTilePass(TileScheduler& scheduler) {
+    scheduler.nextTile = 0;
+}
+
+bool tilePassStarting(const TileScheduler& scheduler) {
+    return scheduler.nextTile == 0;
+}
+
+bool tilePassComplete(const TileScheduler& scheduler) {
+    return scheduler.nextTile >= scheduler.tilesX * scheduler.tilesY;
+}
+
+int drawNextTileBatch(TileScheduler& scheduler, GLuint program, int targetWidth, int targetHeight) {
+    int total = scheduler.tilesX * scheduler.tilesY;
+    int count = std::min(scheduler.tilesPerFrame, total - scheduler.nextTile);
+    if (count <= 0) {
+        return 0;
+    }
+
+    // Row-major order: consecutive batches sweep the image from the bottom up.
+    std::vector<uint32_t> tiles;
+    tiles.reserve(count);
+    for (int i = scheduler.nextTile; i < scheduler.nextTile + count; i++) {
+        tiles.push_back(packTile(i % scheduler.tilesX, i / scheduler.tilesX));
+    }
+    uploadTileList(scheduler.batch, tiles);
+    drawTileList(scheduler.batch, program, kSliceTileSize, targetWidth, targetHeight);
+
+    scheduler.nextTile += count;
+    return count;
+}
+
+void updateTileScheduler(TileScheduler& scheduler, double gpuMs, int tiles) {
+    if (tiles <= 0 || gpuMs <= 0.0) {
+        return;
+    }
+    if (scheduler.warmupSamples > 0) {
+        scheduler.warmupSamples--;
+        return;
+    }
+
+    // Same smoothing as the dynamic resolution controller
+    float sample = static_cast<float>(gpuMs / tiles);
+    if (scheduler.msPerTile < 0.0f) {
+        scheduler.msPerTile = sample;
+    }
+    else {
+        scheduler.msPerTile += 0.25f * (sample - scheduler.msPerTile);
+    }
+
+    // Grow at most 2x per result so a stale cheap measurement cannot blow the budget,
+    // but shrink immediately when tiles got more expensive.
+    int total = std::max(scheduler.tilesX * scheduler.tilesY, 1);
+    int fit = static_cast<int>(scheduler.budgetMs / scheduler.msPerTile);
+    fit = std::min(fit, scheduler.tilesPerFrame * 2);
+    scheduler.tilesPerFrame = std::max(1, std::min(fit, total));
+}
+
+void destroyTileScheduler(TileScheduler& scheduler) {
+    destroyTileList(scheduler.batch);
+    scheduler = TileScheduler();
+}
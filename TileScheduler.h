@@ -0,0 +1,50 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include "TileList.h"
+
+// Edge length in pixels of the tiles a time-sliced trace pass is split into.
+const int kSliceTileSize = 64;
+
+// Splits the full-screen trace pass into tiles and issues only as many per
+// frame as fit in a GPU time budget. One pass fills the trace target over
+// several frames; its result is used once every tile has been traced, so no
+// single draw can run long enough to stall input or trip a GPU watchdog.
+struct TileScheduler {
+    float budgetMs = 16.6f;
+    float msPerTile = -1.0f;  // smoothed GPU cost of one tile, -1 until measured
+    int tilesPerFrame = 4;
+    // Samples still to be ignored, since the first sliced frame includes shader warm-up.
+    int warmupSamples = 1;
+
+    int tilesX = 0;
+    int tilesY = 0;
+    int nextTile = 0;  // first tile of the current pass not yet issued
+    TileList batch;
+};
+
+void createTileScheduler(TileScheduler& scheduler, int width, int height);
+
+// Matches the tiling to a new render size; restarts the pass.
+void resizeTileScheduler(TileScheduler& scheduler, int width, int height);
+
+// Drops the tiles issued so far, e.g. when a toggle changes the image.
+void restartTilePass(TileScheduler& scheduler);
+
+// True before the first batch of a pass has been issued.
+bool tilePassStarting(const TileScheduler& scheduler);
+
+// True once every tile of the pass has been issued; call restartTilePass() to begin the next.
+bool tilePassComplete(const TileScheduler& scheduler);
+
+// Draws the next batch of tiles of the pass with the current program, which
+// must use tile_vertex_shader.glsl. Returns the number of tiles drawn.
+int drawNextTileBatch(TileScheduler& scheduler, GLuint program, int targetWidth, int targetHeight);
+
+// Feeds the GPU time measured for a batch of 'tiles' tiles and picks the
+// batch size for the following frames.
+void updateTileScheduler(TileScheduler& scheduler, double gpuMs, int tiles);
+
+void destroyTileScheduler(TileScheduler& scheduler);
+
+#endif  // TILE_SCHEDULER_H
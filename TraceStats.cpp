@@ -0,0 +1,161 @@
+#include "TraceStats.h"
+#include "Shader.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+const char* const kTraceStatNames[kTraceStatCount] = { "bounces", "tests", "samples", "cycles" };
+
+namespace {
+
+// log2 of the value at the top of each counter's color ramp: 80 samples of
+// 3 bounces, a million tests, 128 samples and 2^28 cycles.
+const float kTraceStatLogRange[kTraceStatCount] = { 8.0f, 20.0f, 7.0f, 28.0f };
+
+// Screen regions per axis in the regions table.
+const int kTraceStatsRegions = 8;
+
+// Histogram bucket of a value: 0 for zero, b for [2^(b-1), 2^b).
+int bucketOf(uint32_t value) {
+    int bucket = 0;
+    while (value) {
+        bucket++;
+        value >>= 1;
+    }
+    return bucket;
+}
+
+std::string regionsPath(const std::string& path) {
+    size_t dot = path.rfind('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path + "_regions";
+    }
+    return path.substr(0, dot) + "_regions" + path.substr(dot);
+}
+
+}  // namespace
+
+void createTraceStatsOverlay(TraceStatsOverlay& overlay) {
+    overlay.program = createShaderProgram("vertex_shader.glsl", "trace_stats_shader.glsl");
+}
+
+void cycleTraceStatsOverlay(TraceStatsOverlay& overlay) {
+    overlay.stat = overlay.stat + 1 < kTraceStatCount ? overlay.stat + 1 : -1;
+}
+
+void drawTraceStatsOverlay(const TraceStatsOverlay& overlay, GLuint statsTexture) {
+    if (overlay.stat < 0) {
+        return;
+    }
+    glUseProgram(overlay.program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, statsTexture);
+    glUniform1i(glGetUniformLocation(overlay.program, "uStats"), 0);
+    glUniform1i(glGetUniformLocation(overlay.program, "uStat"), overlay.stat);
+    glUniform1f(glGetUniformLocation(overlay.program, "uLogRange"), kTraceStatLogRange[overlay.stat]);
+    glUniform1f(glGetUniformLocation(overlay.program, "uOpacity"), overlay.opacity);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisable(GL_BLEND);
+}
+
+void destroyTraceStatsOverlay(TraceStatsOverlay& overlay) {
+    glDeleteProgram(overlay.program);
+    overlay = TraceStatsOverlay();
+}
+
+bool writeTraceStatsCsv(GLuint statsTexture, int width, int height, const std::string& path) {
+    std::vector<uint32_t> texels(static_cast<size_t>(width) * height * 4);
+    glBindTexture(GL_TEXTURE_2D, statsTexture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, texels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Histograms and region totals in one pass
+    std::vector<uint64_t> histogram(33 * kTraceStatCount, 0);
+    std::vector<uint64_t> regions(kTraceStatsRegions * kTraceStatsRegions * kTraceStatCount, 0);
+    uint64_t totals[kTraceStatCount] = {};
+    int lastBucket = 0;
+    for (int y = 0; y < height; y++) {
+        int regionY = y * kTraceStatsRegions / height;
+        for (int x = 0; x < width; x++) {
+            int region = regionY * kTraceStatsRegions + x * kTraceStatsRegions / width;
+            const uint32_t* pixel = &texels[(static_cast<size_t>(y) * width + x) * 4];
+            for (int s = 0; s < kTraceStatCount; s++) {
+                int bucket = bucketOf(pixel[s]);
+                histogram[bucket * kTraceStatCount + s]++;
+                lastBucket = std::max(lastBucket, bucket);
+                regions[region * kTraceStatCount + s] += pixel[s];
+                totals[s] += pixel[s];
+            }
+        }
+    }
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to write " << path << "\n";
+        return false;
+    }
+    file << "bucket,min,max";
+    for (int s = 0; s < kTraceStatCount; s++) {
+        file << "," << kTraceStatNames[s];
+    }
+    file << "\n";
+    for (int b = 0; b <= lastBucket; b++) {
+        uint64_t lo = b == 0 ? 0 : uint64_t(1) << (b - 1);
+        uint64_t hi = b == 0 ? 0 : (uint64_t(1) << b) - 1;
+        file << b << "," << lo << "," << hi;
+        for (int s = 0; s < kTraceStatCount; s++) {
+            file << "," << histogram[b * kTraceStatCount + s];
+        }
+        file << "\n";
+    }
+
+    std::string regionsFile = regionsPath(path);
+    std::ofstream regionsOut(regionsFile);
+    if (!regionsOut) {
+        std::cerr << "Failed to write " << regionsFile << "\n";
+        return false;
+    }
+    regionsOut << "region_x,region_y,x0,y0,x1,y1";
+    for (int s = 0; s < kTraceStatCount; s++) {
+        regionsOut << "," << kTraceStatNames[s];
+    }
+    regionsOut << "\n";
+    for (int ry = 0; ry < kTraceStatsRegions; ry++) {
+        for (int rx = 0; rx < kTraceStatsRegions; rx++) {
+            // Pixel rows count from the bottom of the image
+            regionsOut << rx << "," << ry << "," << (rx * width + kTraceStatsRegions - 1) / kTraceStatsRegions << ","
+                       << (ry * height + kTraceStatsRegions - 1) / kTraceStatsRegions << ","
+                       << ((rx + 1) * width + kTraceStatsRegions - 1) / kTraceStatsRegions << ","
+                       << ((ry + 1) * height + kTraceStatsRegions - 1) / kTraceStatsRegions;
+            for (int s = 0; s < kTraceStatCount; s++) {
+                regionsOut << "," << regions[(ry * kTraceStatsRegions + rx) * kTraceStatCount + s];
+            }
+            regionsOut << "\n";
+        }
+    }
+
+    // Cycles measure cost best; without the shader clock fall back to tests
+    int costStat = totals[3] > 0 ? 3 : 1;
+    int busiest = 0;
+    for (int r = 1; r < kTraceStatsRegions * kTraceStatsRegions; r++) {
+        if (regions[r * kTraceStatCount + costStat] > regions[busiest * kTraceStatCount + costStat]) {
+            busiest = r;
+        }
+    }
+    std::cout << "Trace stats of " << width << "x" << height << " pixels written to " << path << " and "
+              << regionsFile << ": " << totals[0] << " bounces, " << totals[1] << " tests, "
+              << totals[2] << " samples, " << totals[3] << " cycles\n";
+    if (totals[costStat] > 0) {
+        std::cout << "Most expensive region (" << busiest % kTraceStatsRegions << ", "
+                  << busiest / kTraceStatsRegions << ") of " << kTraceStatsRegions << "x" << kTraceStatsRegions
+                  << ": " << 100.0 * regions[busiest * kTraceStatCount + costStat] / totals[costStat]
+                  << "% of " << kTraceStatNames[costStat] << "\n";
+    }
+    return true;
+}
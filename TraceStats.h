@@ -0,0 +1,42 @@
+#ifndef TRACE_STATS_H
+#define TRACE_STATS_H
+
+#include <GL/glew.h>
+#include <string>
+
+// Per-pixel cost counters written by the TRACE_STATS permutation of the
+// trace shader to an RGBA32UI attachment: bounces traced, primitive
+// intersection tests, samples, and shader clock cycles (ARB_shader_clock,
+// zero where the extension is missing).
+const int kTraceStatCount = 4;
+extern const char* const kTraceStatNames[kTraceStatCount];
+
+// Color attachment of the trace target that holds the counters.
+const int kTraceStatsAttachment = 4;
+
+// False-color overlay of one counter on a log scale, blended over the
+// upscaled image. stat == -1 hides it.
+struct TraceStatsOverlay {
+    GLuint program = 0;
+    int stat = -1;
+    float opacity = 0.8f;
+};
+
+void createTraceStatsOverlay(TraceStatsOverlay& overlay);
+
+// Moves to the next counter, wrapping around to hidden.
+void cycleTraceStatsOverlay(TraceStatsOverlay& overlay);
+
+// Draws the overlay into the currently bound framebuffer. Expects the
+// full-screen quad VAO to be bound.
+void drawTraceStatsOverlay(const TraceStatsOverlay& overlay, GLuint statsTexture);
+
+void destroyTraceStatsOverlay(TraceStatsOverlay& overlay);
+
+// Reads the counters back and writes a power-of-two histogram of every
+// counter to 'path', plus the totals of an 8x8 grid of screen regions to
+// the same name with a "_regions" suffix. Prints a short summary naming the
+// most expensive region. Blocks until the GPU has finished the frame.
+bool writeTraceStatsCsv(GLuint statsTexture, int width, int height, const std::string& path);
+
+#endif  // TRACE_STATS_H
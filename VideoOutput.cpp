@@ -0,0 +1,111 @@
+#include "VideoOutput.h"
+#include "Shader.h"
+#include <iostream>
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+
+// Windows pipes translate line endings unless opened in binary mode.
+#ifdef _WIN32
+const char* const kPipeMode = "wb";
+#else
+const char* const kPipeMode = "w";
+#endif
+
+size_t frameBytes(const VideoOutput& video) {
+    return static_cast<size_t>(video.width) * video.height * 3 / 2;
+}
+
+void writeFrame(VideoOutput* video, const CapturedFrame& frame) {
+    if (video->failed) {
+        return;
+    }
+    if (std::fputs("FRAME\n", video->file) < 0 ||
+        std::fwrite(frame.pixels.data(), 1, frameBytes(*video), video->file) != frameBytes(*video)) {
+        std::cerr << "Video output failed at frame " << frame.index << ", discarding the rest\n";
+        video->failed = true;
+    }
+}
+
+}  // namespace
+
+bool createVideoOutput(VideoOutput& video, const std::string& destination, int width, int height, int fps) {
+    video.width = width & ~1;
+    video.height = height & ~1;
+    video.fps = fps;
+    video.pipe = !destination.empty() && destination[0] == '|';
+    if (video.pipe) {
+#ifndef _WIN32
+        // An encoder that exits early must fail the write, not kill the renderer
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+        video.file = popen(destination.c_str() + 1, kPipeMode);
+    }
+    else {
+        video.file = std::fopen(destination.c_str(), "wb");
+    }
+    if (!video.file || video.width <= 0 || video.height <= 0) {
+        std::cerr << "Failed to open video output " << destination << "\n";
+        if (video.file) {
+            video.pipe ? pclose(video.file) : std::fclose(video.file);
+            video.file = nullptr;
+        }
+        return false;
+    }
+    std::fprintf(video.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", video.width, video.height, fps);
+
+    // The planes take a frame and a half of bytes, four per texel
+    int targetWidth = video.width;
+    size_t texels = (frameBytes(video) + 3) / 4;
+    int targetHeight = static_cast<int>((texels + targetWidth - 1) / targetWidth);
+    video.planes = createRenderTarget(targetWidth, targetHeight, { GL_RGBA8 });
+    video.program = createShaderProgram("vertex_shader.glsl", "yuv_shader.glsl");
+    createFrameCapture(video.capture, [&video](const CapturedFrame& frame) { writeFrame(&video, frame); }, false);
+    std::cout << "Video output: " << video.width << "x" << video.height << " at " << fps << " fps to "
+              << destination << "\n";
+    return true;
+}
+
+void encodeVideoFrame(VideoOutput& video, GLuint source, GLuint quadVAO) {
+    glBindFramebuffer(GL_FRAMEBUFFER, video.planes.fbo);
+    glViewport(0, 0, video.planes.width, video.planes.height);
+    glUseProgram(video.program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glUniform1i(glGetUniformLocation(video.program, "uSource"), 0);
+    glUniform2i(glGetUniformLocation(video.program, "uFrameSize"), video.width, video.height);
+    glUniform1i(glGetUniformLocation(video.program, "uTargetWidth"), video.planes.width);
+    glUniform1i(glGetUniformLocation(video.program, "uTargetHeight"), video.planes.height);
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+
+    captureFrame(video.capture, video.planes.fbo, video.planes.width, video.planes.height);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    video.frameCount++;
+}
+
+void destroyVideoOutput(VideoOutput& video) {
+    if (!video.file) {
+        return;
+    }
+    destroyFrameCapture(video.capture);
+    int status = video.pipe ? pclose(video.file) : std::fclose(video.file);
+    video.file = nullptr;
+    if (status != 0) {
+        std::cerr << "Video " << (video.pipe ? "encoder exited with status " : "file close failed: ") << status
+                  << "\n";
+    }
+    else if (!video.failed) {
+        std::cout << "Video output: wrote " << video.frameCount << " frames\n";
+    }
+    destroyRenderTarget(video.planes);
+    glDeleteProgram(video.program);
+}
@@ -0,0 +1,44 @@
+#ifndef VIDEO_OUTPUT_H
+#define VIDEO_OUTPUT_H
+
+#include "FrameCapture.h"
+#include "RenderTarget.h"
+#include <GL/glew.h>
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+// Raw video stream of rendered frames. Each frame is tonemapped and converted
+// to 8-bit YUV 4:2:0 (BT.601, limited range) on the GPU, packed into an RGBA8
+// target as the three planes back to back, read back asynchronously and
+// written as a YUV4MPEG2 frame on the capture thread. Capture waits for the
+// writer instead of dropping frames, so the stream is complete however slowly
+// the encoder consumes it.
+struct VideoOutput {
+    int width = 0;
+    int height = 0;
+    int fps = 30;
+    GLuint program = 0;
+    RenderTarget planes;  // RGBA8, four bytes of the Y, U and V planes per texel
+    FrameCapture capture;
+    std::FILE* file = nullptr;
+    bool pipe = false;  // file is an encoder process
+    std::atomic<bool> failed{ false };  // a write failed; later frames are discarded
+    long long frameCount = 0;
+};
+
+// Opens the destination and writes the stream header. A destination starting
+// with '|' is a command the stream is piped into, e.g.
+// "|ffmpeg -y -i - -c:v libx264 out.mp4"; anything else is a .y4m file.
+// Odd sizes are rounded down to even ones. Returns false if it cannot be opened.
+bool createVideoOutput(VideoOutput& video, const std::string& destination, int width, int height, int fps);
+
+// Converts the image in source (linear color, any size) and queues it as the
+// next frame. Leaves framebuffer 0 bound.
+void encodeVideoFrame(VideoOutput& video, GLuint source, GLuint quadVAO);
+
+// Writes the frames still in flight and closes the file or waits for the
+// encoder process to exit.
+void destroyVideoOutput(VideoOutput& video);
+
+#endif  // VIDEO_OUTPUT_H
@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 AccumOut; // weighted radiance sum (rgb), sample count (a); blended additively
+
+uniform sampler2D uSource; // one trace pass: mean radiance (rgb), sample count (a)
+
+void main() {
+    // Same size as the accumulation target, so no filtering
+    vec4 pass = texelFetch(uSource, ivec2(gl_FragCoord.xy), 0);
+    AccumOut = vec4(pass.rgb * pass.a, pass.a);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 Active; // r = 1 if the pixel still needs samples
+in vec2 TexCoords;
+
+uniform sampler2D uHistoryMoments; // luminance mean (x), mean of squares (y), frames (z)
+uniform float uThreshold;          // target relative standard error of the accumulated mean
+uniform float uMinFrames;          // frames before the variance estimate is trusted
+
+void main() {
+    vec4 moments = texelFetch(uHistoryMoments, ivec2(gl_FragCoord.xy), 0);
+    float frames = moments.z;
+
+    // Unbiased variance of the per-frame values, then the standard error of their mean
+    float variance = max(moments.y - moments.x * moments.x, 0.0) * frames / max(frames - 1.0, 1.0);
+    float stdError = sqrt(variance / max(frames, 1.0));
+
+    // Relative to brightness, with a floor so near-black pixels can converge
+    float error = stdError / max(moments.x, 0.05);
+    Active = vec4((frames < uMinFrames || error > uThreshold) ? 1.0 : 0.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 Active; // r = 1 if any pixel of the tile still needs samples
+in vec2 TexCoords;
+
+uniform sampler2D uPixelMask;
+uniform int uTileSize;
+
+void main() {
+    ivec2 size = textureSize(uPixelMask, 0);
+    ivec2 origin = ivec2(gl_FragCoord.xy) * uTileSize;
+    ivec2 end = min(origin + ivec2(uTileSize), size);
+    float anyActive = 0.0;
+    for (int y = origin.y; y < end.y; y++) {
+        for (int x = origin.x; x < end.x; x++) {
+            anyActive = max(anyActive, texelFetch(uPixelMask, ivec2(x, y), 0).r);
+        }
+    }
+    Active = vec4(anyActive);
+}
@@ -1,23 +1,89 @@
 #version 330 core
-out vec4 FragColor;
+#ifdef TRACE_STATS
+#extension GL_ARB_shader_clock : enable
+#endif
+layout(location = 0) out vec4 FragColor; // radiance (rgb), samples taken this frame (a)
+layout(location = 1) out vec4 GeomOut;   // primary hit normal (xyz), hit distance (w)
+layout(location = 2) out vec4 AlbedoOut; // primary hit base color (rgb)
+layout(location = 3) out vec4 IndirectOut; // radiance arriving via bounces >= 1 (rgb)
+#ifdef TRACE_STATS
+layout(location = 4) out uvec4 StatsOut;   // bounces, primitive tests, samples, clock cycles
+#endif
 in vec2 TexCoords;
 
 // Camera and scene uniforms
 uniform vec3 uCamPos;
 uniform mat3 uCamRot;
 uniform float uTime;
+uniform float uAspect;  // display aspect ratio (width / height)
+uniform float uFov;     // vertical field of view in radians
+uniform vec2 uPixelJitter; // primary ray offset from the pixel center, in pixels (offline passes)
 uniform bool uDenoise; // Toggle for denoising
 uniform bool uGI;      // Toggle for global illumination
 uniform bool uSkybox;  // Toggle for using the skybox
+uniform int uMaxBounces; // bounces traced this frame (<= maxBounces), lowered for interactive previews
 uniform sampler2D uSkyboxTex; // HDR skybox texture (equirectangular)
 
+// Generic scene data (unused when the scene is baked in as constants)
+uniform samplerBuffer uScenePrims; // materials, spheres and planes packed as vec4 texels
+uniform usamplerBuffer uSceneWords; // the same texels as raw words, for packed data
+uniform int uSphereOffset;
+uniform int uSphereCount;
+uniform int uPlaneOffset;
+uniform int uPlaneCount;
+uniform int uTriangleOffset;   // object-space mesh triangles in BLAS leaf order
+uniform int uBlasNodeOffset;   // binary bottom-level BVH nodes of animated meshes
+uniform int uWideNodeOffset;   // compressed eight-wide BVH nodes of static meshes
+uniform int uInstanceOffset;   // world-to-object transform, BLAS root and format per instance
+uniform int uInstanceCount;
+uniform int uTlasNodeOffset;   // top-level BVH over the instances
+
+// Hybrid mode: primary visibility of the triangle meshes comes from a rasterized G-buffer
+uniform bool uRasterPrimary;
+uniform sampler2D uRasterPosition; // world position (xyz), material (w)
+uniform sampler2D uRasterGeom;     // normal (xyz), ray distance (w, skyDepth where no triangle)
+
+// Adaptive sampling: pixels whose accumulated estimate has converged are skipped
+uniform bool uAdaptive;
+uniform sampler2D uActiveMask; // r = 1 where more samples are needed
+
 // Maximum number of bounces for reflections/gi
 const int maxBounces = 3;
 
+// Hit distance reported for rays that escape to the sky
+const float skyDepth = 1e6;
+
+// Primary hit of the most recent traceRayFrom() call, used for the G-buffer output
+vec3 gPrimaryNormal;
+float gPrimaryDepth;
+vec3 gPrimaryAlbedo;
+vec3 gIndirect;  // part of the returned color that came from secondary bounces
+
+// Added to the random seeds so samples sharing a cached primary hit take different bounces
+float gSampleSeed = 0.0;
+
+// Cost counters of the TRACE_STATS permutation (see TraceStats.h)
+#ifdef TRACE_STATS
+uint gStatBounces = 0u;
+uint gStatTests = 0u;
+#define COUNT_STAT(counter) counter++
+#else
+#define COUNT_STAT(counter)
+#endif
+
+// Closest hit of a ray, kept so the supersampling loop can reuse the primary hit
+struct Hit {
+    bool hit;
+    float t;
+    vec3 normal;
+    vec3 baseColor;
+};
+
 // --------------------------------------------------------
 // 1. Sphere Intersection
 // --------------------------------------------------------
 float intersectSphere(vec3 ro, vec3 rd, vec3 center, float radius, out vec3 normal) {
+    COUNT_STAT(gStatTests);
     vec3 oc = ro - center;
     float b = dot(oc, rd);
     float c = dot(oc, oc) - radius * radius;
@@ -39,6 +105,7 @@ float intersectSphere(vec3 ro, vec3 rd, vec3 center, float radius, out vec3 norm
 //    (plane at y=planeY, with half-size in X and Z)
 // --------------------------------------------------------
 float intersectFinitePlane(vec3 ro, vec3 rd, float planeY, float halfSize, out vec3 normal) {
+    COUNT_STAT(gStatTests);
     // If the ray is nearly parallel to the plane, no intersection
     if (abs(rd.y) < 0.0001) return -1.0;
 
@@ -56,52 +123,447 @@ float intersectFinitePlane(vec3 ro, vec3 rd, float planeY, float halfSize, out v
 }
 
 // --------------------------------------------------------
-// 3. Trace a ray through the scene with up to maxBounces
+// 2b. Triangle Intersection (Moller-Trumbore)
+//    Takes the first vertex and the two edges leaving it; the
+//    normal faces the incoming ray so both sides shade alike.
+// --------------------------------------------------------
+float intersectTriangle(vec3 ro, vec3 rd, vec3 v0, vec3 e1, vec3 e2, out vec3 normal) {
+    COUNT_STAT(gStatTests);
+    vec3 p = cross(rd, e2);
+    float det = dot(e1, p);
+    if (abs(det) < 1e-8) return -1.0;
+    float invDet = 1.0 / det;
+    vec3 s = ro - v0;
+    float u = dot(s, p) * invDet;
+    if (u < 0.0 || u > 1.0) return -1.0;
+    vec3 q = cross(s, e1);
+    float v = dot(rd, q) * invDet;
+    if (v < 0.0 || u + v > 1.0) return -1.0;
+    float t = dot(e2, q) * invDet;
+    if (t <= 0.0) return -1.0;
+    normal = normalize(cross(e1, e2));
+    if (dot(normal, rd) > 0.0) normal = -normal;
+    return t;
+}
+
+// --------------------------------------------------------
+// 3. Scene Intersection
+//    Either generated on the host with every primitive as a
+//    constant (SCENE_SPECIALIZED), or a generic loop over the
+//    primitives packed into uScenePrims.
+// --------------------------------------------------------
+vec3 checkerColor(vec3 hitPos, float scale, vec3 colorA, vec3 colorB) {
+    float checker = mod(floor(hitPos.x * scale) + floor(hitPos.z * scale), 2.0);
+    return (checker < 1.0) ? colorA : colorB;
+}
+
+// Material lookup in the scene buffer; also used for rasterized hits in the specialized path
+vec3 materialColor(int material, vec3 hitPos) {
+    vec4 m0 = texelFetch(uScenePrims, material * 2);
+    vec4 m1 = texelFetch(uScenePrims, material * 2 + 1);
+    if (m0.w == 0.0) return m0.rgb;
+    return checkerColor(hitPos, m0.w, m0.rgb, m1.rgb);
+}
+
+#ifndef SCENE_SPECIALIZED
+// --------------------------------------------------------
+// 3a. Two-level BVH traversal
+//    A top-level BVH over mesh instances; each instance leaf
+//    moves the ray into object space and walks the mesh's
+//    bottom-level BVH: binary for animated meshes, compressed
+//    eight-wide for static ones. Binary nodes are stored as
+//    (min, first), (max, count) texel pairs and walked with a
+//    per-ray stack, or without one in the BVH_STACKLESS
+//    permutation.
+// --------------------------------------------------------
+// A walk holds at most one far child per level above the current node, so a
+// stack of kMaxBvhDepth (Bvh.h) entries never drops one.
+const int bvhStackSize = 64;
+
+#ifdef BVH_STACKLESS
+// Stackless permutation of the binary traversal: a restart trail (Laine 2010)
+// replaces the per-ray stack. Bit d of the 64-bit trail is set once the near
+// child of the node at depth d on the current path is finished (or when that
+// node had only one child to visit). A finished subtree bumps the trail and
+// traversal restarts at the root, following the trail back down. Children
+// are culled against the current t, so after a closer hit a restart may no
+// longer see a far child it entered before; that child lies behind the hit
+// and skipping it is correct. The near child has the smaller entry distance
+// and is only culled together with the far one, so the two never swap and
+// the trail stays valid. Trees must not be deeper than 64 levels; the SAH
+// builder stops splitting there (kMaxBvhDepth) and the Morton-code builder's
+// prefix lengths cannot exceed it.
+bool trailBit(uvec2 trail, int depth) {
+    uint word = depth < 32 ? trail.x : trail.y;
+    return ((word >> uint(31 - (depth & 31))) & 1u) != 0u;
+}
+
+// Picks the child to descend into at 'depth' and moves one level down.
+int descendTrail(inout uvec2 trail, inout int depth, int near, int far, bool farHit) {
+    int next = near;
+    if (!farHit) {
+        // Nothing else to visit below this node
+        if (depth < 32) trail.x |= 1u << uint(31 - depth);
+        else trail.y |= 1u << uint(63 - depth);
+    } else if (trailBit(trail, depth)) {
+        next = far;
+    }
+    depth++;
+    return next;
+}
+
+// Called when the subtree at 'depth' is finished: marks the deepest level
+// above it whose far child is still to visit and clears the levels below.
+// Returns false once the whole tree is finished.
+bool popTrail(inout uvec2 trail, int depth) {
+    int level = depth - 1;
+    if (level >= 32) {
+        uint open = ~trail.y & ~((1u << uint(63 - level)) - 1u);
+        if (open != 0u) {
+            uint bit = open & (~open + 1u);  // deepest unfinished level
+            trail.y = (trail.y | bit) & ~(bit - 1u);
+            return true;
+        }
+        level = 31;
+    }
+    if (level < 0) return false;
+    uint open = ~trail.x & ~((1u << uint(31 - level)) - 1u);
+    if (open == 0u) return false;
+    uint bit = open & (~open + 1u);
+    trail.x = (trail.x | bit) & ~(bit - 1u);
+    trail.y = 0u;
+    return true;
+}
+#endif
+
+// Entry distance of the ray into a box, or 1e30 on a miss or beyond tMax
+float intersectAabb(vec3 ro, vec3 invDir, vec3 bmin, vec3 bmax, float tMax) {
+    vec3 t0 = (bmin - ro) * invDir;
+    vec3 t1 = (bmax - ro) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float enter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+    float exit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+    return enter <= exit ? enter : 1e30;
+}
+
+vec3 safeInverse(vec3 d) {
+    return 1.0 / mix(d, vec3(1e-20), lessThan(abs(d), vec3(1e-20)));
+}
+
+// Closest triangle of one mesh in object space. The direction is not
+// normalized, so t is directly comparable with world-space distances.
+bool intersectBlas(vec3 ro, vec3 rd, int root, inout float t, out vec3 normal) {
+    vec3 invDir = safeInverse(rd);
+#ifdef BVH_STACKLESS
+    uvec2 trail = uvec2(0u);
+    int depth = 0;
+#else
+    int stack[bvhStackSize];
+    int stackSize = 0;
+#endif
+    int node = root;
+    bool hit = false;
+    vec3 n;
+    while (true) {
+        vec4 b1 = texelFetch(uScenePrims, uBlasNodeOffset + node * 2 + 1);
+        if (b1.w > 0.0) {
+            int first = int(texelFetch(uScenePrims, uBlasNodeOffset + node * 2).w);
+            int count = int(b1.w);
+            for (int i = first; i < first + count; i++) {
+                vec4 v0 = texelFetch(uScenePrims, uTriangleOffset + i * 3);
+                vec4 e1 = texelFetch(uScenePrims, uTriangleOffset + i * 3 + 1);
+                vec4 e2 = texelFetch(uScenePrims, uTriangleOffset + i * 3 + 2);
+                float tHit = intersectTriangle(ro, rd, v0.xyz, e1.xyz, e2.xyz, n);
+                if (tHit > 0.0 && tHit < t) {
+                    t = tHit;
+                    normal = n;
+                    hit = true;
+                }
+            }
+        } else {
+            // Visit the nearer child first and keep the other for later
+            int left = int(texelFetch(uScenePrims, uBlasNodeOffset + node * 2).w);
+            float tLeft = intersectAabb(ro, invDir,
+                texelFetch(uScenePrims, uBlasNodeOffset + left * 2).xyz,
+                texelFetch(uScenePrims, uBlasNodeOffset + left * 2 + 1).xyz, t);
+            float tRight = intersectAabb(ro, invDir,
+                texelFetch(uScenePrims, uBlasNodeOffset + left * 2 + 2).xyz,
+                texelFetch(uScenePrims, uBlasNodeOffset + left * 2 + 3).xyz, t);
+            int near = tLeft <= tRight ? left : left + 1;
+            int far = tLeft <= tRight ? left + 1 : left;
+            if (min(tLeft, tRight) < 1e30) {
+#ifdef BVH_STACKLESS
+                node = descendTrail(trail, depth, near, far, max(tLeft, tRight) < 1e30);
+#else
+                if (max(tLeft, tRight) < 1e30 && stackSize < bvhStackSize) {
+                    stack[stackSize++] = far;
+                }
+                node = near;
+#endif
+                continue;
+            }
+        }
+#ifdef BVH_STACKLESS
+        if (!popTrail(trail, depth)) break;
+        node = root;
+        depth = 0;
+#else
+        if (stackSize == 0) break;
+        node = stack[--stackSize];
+#endif
+    }
+    return hit;
+}
+
+// Closest triangle of a mesh with a compressed eight-wide BVH (see
+// WideBvhNode in Bvh.h): five texels per node, child boxes decoded from
+// 8-bit offsets. Children were placed in slots by the octant they lie in,
+// so walking slot i ^ nearOctant for i = 0..7 is roughly front to back;
+// leaves are intersected on the way, inner children then pushed far to near.
+const int wideStackSize = 64;
+
+uint nodeByte(uint low, uint high, uint slot) {
+    return ((slot < 4u ? low : high) >> ((slot & 3u) * 8u)) & 0xffu;
+}
+
+bool intersectWideBlas(vec3 ro, vec3 rd, int root, inout float t, out vec3 normal) {
+    vec3 invDir = safeInverse(rd);
+    uint nearOctant = (rd.x < 0.0 ? 1u : 0u) | (rd.y < 0.0 ? 2u : 0u) | (rd.z < 0.0 ? 4u : 0u);
+    int stack[wideStackSize];
+    int stackSize = 0;
+    int node = root;
+    bool hit = false;
+    vec3 n;
+    while (true) {
+        int base = uWideNodeOffset + node * 5;
+        vec3 origin = texelFetch(uScenePrims, base).xyz;
+        uint exponents = texelFetch(uSceneWords, base).w;
+        uvec4 header = texelFetch(uSceneWords, base + 1);
+        uvec4 lo = texelFetch(uSceneWords, base + 2);
+        uvec4 mixed = texelFetch(uSceneWords, base + 3);
+        uvec4 hi = texelFetch(uSceneWords, base + 4);
+        vec3 gridStep = vec3(uintBitsToFloat((exponents & 0xffu) << 23),
+                         uintBitsToFloat(((exponents >> 8) & 0xffu) << 23),
+                         uintBitsToFloat(((exponents >> 16) & 0xffu) << 23));
+        // Slab distances are affine in the quantized coordinates
+        vec3 slabBase = (origin - ro) * invDir;
+        vec3 slabStep = gridStep * invDir;
+
+        uint innerHits = 0u;  // bit i: the inner child visited i-th was hit
+        for (uint i = 0u; i < 8u; i++) {
+            uint slot = i ^ nearOctant;
+            uint meta = nodeByte(header.z, header.w, slot);
+            if (meta == 0xffu) continue;
+            vec3 qlo = vec3(nodeByte(lo.x, lo.y, slot), nodeByte(lo.z, lo.w, slot), nodeByte(mixed.x, mixed.y, slot));
+            vec3 qhi = vec3(nodeByte(mixed.z, mixed.w, slot), nodeByte(hi.x, hi.y, slot), nodeByte(hi.z, hi.w, slot));
+            vec3 t0 = slabBase + qlo * slabStep;
+            vec3 t1 = slabBase + qhi * slabStep;
+            vec3 tNear = min(t0, t1);
+            vec3 tFar = max(t0, t1);
+            float enter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+            float exit = min(min(tFar.x, tFar.y), min(tFar.z, t));
+            if (enter > exit) continue;
+            if (meta >= 0x80u) {
+                innerHits |= 1u << i;
+            } else {
+                int first = int(header.y + (meta & 31u));
+                for (int k = first; k <= first + int(meta >> 5); k++) {
+                    vec4 v0 = texelFetch(uScenePrims, uTriangleOffset + k * 3);
+                    vec4 e1 = texelFetch(uScenePrims, uTriangleOffset + k * 3 + 1);
+                    vec4 e2 = texelFetch(uScenePrims, uTriangleOffset + k * 3 + 2);
+                    float tHit = intersectTriangle(ro, rd, v0.xyz, e1.xyz, e2.xyz, n);
+                    if (tHit > 0.0 && tHit < t) {
+                        t = tHit;
+                        normal = n;
+                        hit = true;
+                    }
+                }
+            }
+        }
+        // Far children first so the nearest is popped next
+        for (int i = 7; i >= 0; i--) {
+            if ((innerHits & (1u << uint(i))) != 0u && stackSize < wideStackSize) {
+                uint meta = nodeByte(header.z, header.w, uint(i) ^ nearOctant);
+                stack[stackSize++] = int(header.x + (meta & 7u));
+            }
+        }
+        if (stackSize == 0) break;
+        node = stack[--stackSize];
+    }
+    return hit;
+}
+
+// Closest mesh hit over all instances; updates t, the world normal and material
+void intersectInstances(vec3 ro, vec3 rd, inout float t, inout vec3 hitNormal, inout int material) {
+    if (uInstanceCount == 0) return;
+    vec3 invDir = safeInverse(rd);
+#ifdef BVH_STACKLESS
+    uvec2 trail = uvec2(0u);
+    int depth = 0;
+#else
+    int stack[bvhStackSize];
+    int stackSize = 0;
+#endif
+    int node = 0;
+    vec4 root0 = texelFetch(uScenePrims, uTlasNodeOffset);
+    vec4 root1 = texelFetch(uScenePrims, uTlasNodeOffset + 1);
+    if (intersectAabb(ro, invDir, root0.xyz, root1.xyz, t) >= 1e30) return;
+    while (true) {
+        vec4 b1 = texelFetch(uScenePrims, uTlasNodeOffset + node * 2 + 1);
+        if (b1.w > 0.0) {
+            int first = int(texelFetch(uScenePrims, uTlasNodeOffset + node * 2).w);
+            for (int i = first; i < first + int(b1.w); i++) {
+                int base = uInstanceOffset + i * 4;
+                mat3x4 worldToObject = mat3x4(texelFetch(uScenePrims, base),
+                                              texelFetch(uScenePrims, base + 1),
+                                              texelFetch(uScenePrims, base + 2));
+                vec4 info = texelFetch(uScenePrims, base + 3);
+                // Rows are stored, so v * M applies the transform
+                vec3 localRo = vec4(ro, 1.0) * worldToObject;
+                vec3 localRd = vec4(rd, 0.0) * worldToObject;
+                vec3 n;
+                bool meshHit = info.z > 0.0 ? intersectWideBlas(localRo, localRd, int(info.x), t, n)
+                                            : intersectBlas(localRo, localRd, int(info.x), t, n);
+                if (meshHit) {
+                    hitNormal = normalize(mat3(worldToObject) * n);
+                    material = int(info.y);
+                }
+            }
+        } else {
+            int left = int(texelFetch(uScenePrims, uTlasNodeOffset + node * 2).w);
+            float tLeft = intersectAabb(ro, invDir,
+                texelFetch(uScenePrims, uTlasNodeOffset + left * 2).xyz,
+                texelFetch(uScenePrims, uTlasNodeOffset + left * 2 + 1).xyz, t);
+            float tRight = intersectAabb(ro, invDir,
+                texelFetch(uScenePrims, uTlasNodeOffset + left * 2 + 2).xyz,
+                texelFetch(uScenePrims, uTlasNodeOffset + left * 2 + 3).xyz, t);
+            int near = tLeft <= tRight ? left : left + 1;
+            int far = tLeft <= tRight ? left + 1 : left;
+            if (min(tLeft, tRight) < 1e30) {
+#ifdef BVH_STACKLESS
+                node = descendTrail(trail, depth, near, far, max(tLeft, tRight) < 1e30);
+#else
+                if (max(tLeft, tRight) < 1e30 && stackSize < bvhStackSize) {
+                    stack[stackSize++] = far;
+                }
+                node = near;
+#endif
+                continue;
+            }
+        }
+#ifdef BVH_STACKLESS
+        if (!popTrail(trail, depth)) break;
+        node = 0;
+        depth = 0;
+#else
+        if (stackSize == 0) break;
+        node = stack[--stackSize];
+#endif
+    }
+}
+#endif
+
+// withTriangles = false skips the meshes, for when the rasterizer already resolved them
+#ifdef SCENE_SPECIALIZED
+// @SCENE_INTERSECT@
+#else
+bool intersectScene(vec3 ro, vec3 rd, bool withTriangles, out float t, out vec3 hitNormal, out vec3 baseColor) {
+    t = 1e20;
+    int material = -1;
+    vec3 n;
+
+    for (int i = 0; i < uSphereCount; i++) {
+        vec4 s0 = texelFetch(uScenePrims, uSphereOffset + i * 2);
+        vec4 s1 = texelFetch(uScenePrims, uSphereOffset + i * 2 + 1);
+        float tHit = intersectSphere(ro, rd, s0.xyz, s0.w, n);
+        if (tHit > 0.0 && tHit < t) {
+            t = tHit;
+            hitNormal = n;
+            material = int(s1.x);
+        }
+    }
+
+    for (int i = 0; i < uPlaneCount; i++) {
+        vec4 p = texelFetch(uScenePrims, uPlaneOffset + i);
+        float tHit = intersectFinitePlane(ro, rd, p.x, p.y, n);
+        if (tHit > 0.0 && tHit < t) {
+            t = tHit;
+            hitNormal = n;
+            material = int(p.z);
+        }
+    }
+
+    if (withTriangles) {
+        intersectInstances(ro, rd, t, hitNormal, material);
+    }
+
+    if (material < 0) return false;
+    baseColor = materialColor(material, ro + t * rd);
+    return true;
+}
+#endif
+
+Hit traceClosest(vec3 ro, vec3 rd) {
+    Hit h;
+    h.hit = intersectScene(ro, rd, true, h.t, h.normal, h.baseColor);
+    return h;
+}
+
+// Primary hit of this pixel: traced, or merged from the rasterized G-buffer in hybrid mode
+Hit tracePrimary(vec3 ro, vec3 rd) {
+    if (!uRasterPrimary) {
+        return traceClosest(ro, rd);
+    }
+    Hit h;
+    h.hit = intersectScene(ro, rd, false, h.t, h.normal, h.baseColor);
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 geom = texelFetch(uRasterGeom, pixel, 0);
+    if (geom.w < skyDepth && (!h.hit || geom.w < h.t)) {
+        vec4 position = texelFetch(uRasterPosition, pixel, 0);
+        h.hit = true;
+        h.t = geom.w;
+        h.normal = geom.xyz;
+        h.baseColor = materialColor(int(position.w + 0.5), position.xyz);
+    }
+    return h;
+}
+
+// --------------------------------------------------------
+// 4. Trace a ray through the scene with up to maxBounces
 //    Now includes:
 //    - finite plane
 //    - distance accumulation for fog
+//    The primary hit is passed in, so only the bounces are traced here.
 // --------------------------------------------------------
-vec3 traceRay(vec3 ro, vec3 rd) {
+vec3 traceRayFrom(vec3 ro, vec3 rd, Hit primary) {
     vec3 accColor = vec3(0.0);
     vec3 attenuation = vec3(1.0);
 
     // Keep track of how far the ray has traveled (for fog)
     float totalDistance = 0.0;
 
-    for (int bounce = 0; bounce < maxBounces; bounce++) {
-        float t = 1e20;
-        vec3 hitNormal;
-        vec3 baseColor;
-        bool hit = false;
-
-        // --- Sphere: example red sphere at (0,0,5) radius=1 ---
-        vec3 sphereCenter = vec3(0.0, 0.0, 5.0);
-        float sphereRadius = 1.0;
-        vec3 nSphere;
-        float tSphere = intersectSphere(ro, rd, sphereCenter, sphereRadius, nSphere);
-        if (tSphere > 0.0 && tSphere < t) {
-            t = tSphere;
-            hitNormal = nSphere;
-            baseColor = vec3(1.0, 0.0, 0.0); // red
-            hit = true;
-        }
+    // Radiance gathered at the primary hit (or sky); the rest is indirect
+    vec3 directColor = vec3(0.0);
 
-        // --- Finite Plane: large floor at y=-1, 50 in X,Z ---
-        float planeY = -1.0;
-        float halfSize = 50.0; // big enough to look large, but not infinite
-        vec3 nPlane;
-        float tPlane = intersectFinitePlane(ro, rd, planeY, halfSize, nPlane);
-        if (tPlane > 0.0 && tPlane < t) {
-            t = tPlane;
-            hitNormal = nPlane;
-
-            // Checkerboard pattern
-            vec3 hitPos = ro + t * rd;
-            float scale = 2.0;
-            float checker = mod(floor(hitPos.x * scale) + floor(hitPos.z * scale), 2.0);
-            baseColor = (checker < 1.0) ? vec3(1.0) : vec3(0.2);
-
-            hit = true;
+    int bounces = min(uMaxBounces, maxBounces);
+    for (int bounce = 0; bounce < bounces; bounce++) {
+        COUNT_STAT(gStatBounces);
+        // --- Closest hit over all scene primitives ---
+        Hit h = primary;
+        if (bounce > 0) {
+            h = traceClosest(ro, rd);
+        }
+        bool hit = h.hit;
+        float t = h.t;
+        vec3 hitNormal = h.normal;
+        vec3 baseColor = h.baseColor;
+
+        // Remember the primary hit for temporal reprojection
+        if (bounce == 0) {
+            gPrimaryNormal = hit ? hitNormal : -rd;
+            gPrimaryDepth = hit ? t : skyDepth;
+            gPrimaryAlbedo = hit ? baseColor : vec3(1.0);
         }
 
         // --- If nothing hit, sample background/skybox ---
@@ -115,6 +577,7 @@ vec3 traceRay(vec3 ro, vec3 rd) {
             else {
                 accColor += attenuation * vec3(0.5, 0.7, 1.0); // plain sky
             }
+            if (bounce == 0) directColor = accColor;
             break;
         }
 
@@ -130,13 +593,19 @@ vec3 traceRay(vec3 ro, vec3 rd) {
         // Some reflectivity (glossy or GI)
         float reflectivity = 0.7;
 
+        // A preview that stops early shows the last hit fully lit instead of darkened
+        if (bounce == bounces - 1 && bounces < maxBounces) {
+            reflectivity = 0.0;
+        }
+
         // Accumulate local shading (blended with reflectivity)
         accColor += attenuation * mix(localColor, vec3(0.0), reflectivity);
+        if (bounce == 0) directColor = accColor;
 
         // Decide bounce type based on GI toggle
         if (uGI) {
             // Global Illumination: random diffuse bounce
-            vec2 seed = hitPos.xz + vec2(uTime, uTime * 0.5);
+            vec2 seed = hitPos.xz + vec2(uTime, uTime * 0.5) + gSampleSeed;
             float r1 = fract(sin(dot(seed, vec2(12.9898, 78.233))) * 43758.5453);
             float r2 = fract(sin(dot(seed, vec2(39.3467, 11.135))) * 12345.6789);
             float phi = 2.0 * 3.1415926 * r1;
@@ -160,7 +629,7 @@ vec3 traceRay(vec3 ro, vec3 rd) {
             // Glossy reflection: reflect + small random perturbation
             vec3 refl = reflect(rd, hitNormal);
             float roughness = 0.2;
-            vec2 seed = hitPos.xz + vec2(uTime);
+            vec2 seed = hitPos.xz + vec2(uTime) + gSampleSeed;
             float r1 = fract(sin(dot(seed, vec2(12.9898, 78.233))) * 43758.5453);
             float r2 = fract(sin(dot(seed, vec2(39.3467, 11.135))) * 12345.6789);
             float angle = roughness * 6.2831853 * r1;
@@ -194,21 +663,35 @@ vec3 traceRay(vec3 ro, vec3 rd) {
     // If totalDistance > farFog, fogFactor = 1 => full fog
 
     vec3 fogColor = vec3(0.9, 0.9, 1.0);
+    gIndirect = (accColor - directColor) * (1.0 - fogFactor);
     accColor = mix(accColor, fogColor, fogFactor);
 
     return accColor;
 }
 
 // --------------------------------------------------------
-// 4. Main Entry
+// 5. Main Entry
 // --------------------------------------------------------
 void main() {
+    // TexCoords change linearly across the viewport; take the pixel size
+    // before any fragment is discarded
+    vec2 pixelSize = vec2(dFdx(TexCoords.x), dFdy(TexCoords.y));
+
+    // Converged pixels keep a zero sample count, so the history is left untouched
+    if (uAdaptive && texelFetch(uActiveMask, ivec2(gl_FragCoord.xy), 0).r < 0.5) {
+        discard;
+    }
+
+#if defined(TRACE_STATS) && defined(GL_ARB_shader_clock)
+    uvec2 clockStart = clock2x32ARB();
+#endif
+
     // Convert TexCoords [0..1] to [-1..1]
-    vec2 uv = TexCoords * 2.0 - 1.0;
+    vec2 uv = (TexCoords + uPixelJitter * pixelSize) * 2.0 - 1.0;
 
     // Camera params
-    float fov = radians(45.0);
-    float aspect = 1280.0 / 720.0; // match your window aspect ratio
+    float fov = uFov;
+    float aspect = uAspect;
 
     // Build the base ray direction from UV
     vec3 rayDir = normalize(uCamRot * vec3(
@@ -218,38 +701,46 @@ void main() {
     ));
 
     vec3 color;
+    vec3 indirect;
+    vec3 albedo;
+    float sampleCount = 1.0;
 
     if (uDenoise) {
-        // Example: multi-sample approach
-        int samples = 80;
+        // Example: multi-sample approach. The primary hit is traced once and
+        // shared by every sample; only the stochastic bounces differ.
+        int samples = 80;  // kBatchDenoisePassSamples in BatchRender.h
         vec3 acc = vec3(0.0);
+        vec3 accIndirect = vec3(0.0);
+        vec3 accAlbedo = vec3(0.0);
+        Hit primary = tracePrimary(uCamPos, rayDir);
         for (int i = 0; i < samples; i++) {
-            float jitterX = (
-                fract(sin(dot(uv + vec2(float(i), uTime),
-                    vec2(12.9898, 78.233))) * 43758.5453)
-                - 0.5
-                ) / 500.0;
-            float jitterY = (
-                fract(sin(dot(uv + vec2(float(i) + 1.0, uTime),
-                    vec2(93.9898, 67.345))) * 43758.5453)
-                - 0.5
-                ) / 500.0;
-            vec2 uvOffset = uv + vec2(jitterX, jitterY);
-
-            vec3 rayDirOffset = normalize(uCamRot * vec3(
-                uvOffset.x * aspect * tan(fov / 2.0),
-                uvOffset.y * tan(fov / 2.0),
-                1.0
-            ));
-
-            acc += traceRay(uCamPos, rayDirOffset);
+            gSampleSeed = float(i) * 1.618034;
+            acc += traceRayFrom(uCamPos, rayDir, primary);
+            accIndirect += gIndirect;
+            accAlbedo += gPrimaryAlbedo;
         }
         color = acc / float(samples);
+        indirect = accIndirect / float(samples);
+        albedo = accAlbedo / float(samples);
+        sampleCount = float(samples);
     }
     else {
         // Single-sample path
-        color = traceRay(uCamPos, rayDir);
+        color = traceRayFrom(uCamPos, rayDir, tracePrimary(uCamPos, rayDir));
+        indirect = gIndirect;
+        albedo = gPrimaryAlbedo;
     }
 
-    FragColor = vec4(color, 1.0);
+    FragColor = vec4(color, sampleCount);
+    GeomOut = vec4(gPrimaryNormal, gPrimaryDepth);
+    AlbedoOut = vec4(albedo, 1.0);
+    IndirectOut = vec4(indirect, 1.0);
+
+#ifdef TRACE_STATS
+    uint cycles = 0u;
+#ifdef GL_ARB_shader_clock
+    cycles = clock2x32ARB().x - clockStart.x;  // wraps correctly below 2^32
+#endif
+    StatsOut = uvec4(gStatBounces, gStatTests, uint(sampleCount), cycles);
+#endif
 }
@@ -0,0 +1,16 @@
+#version 330 core
+layout(location = 0) out vec4 PositionOut; // world position (xyz), material (w)
+layout(location = 1) out vec4 GeomOut;     // normal facing the camera (xyz), ray distance (w)
+
+in vec3 WorldPos;
+flat in vec3 FaceNormal;
+flat in float Material;
+
+uniform vec3 uCamPos;
+
+void main() {
+    vec3 toHit = WorldPos - uCamPos;
+    vec3 normal = (dot(FaceNormal, toHit) > 0.0) ? -FaceNormal : FaceNormal;
+    PositionOut = vec4(WorldPos, Material);
+    GeomOut = vec4(normal, length(toHit));
+}
@@ -0,0 +1,40 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec4 aRow0;  // per instance: object-to-world rows
+layout(location = 3) in vec4 aRow1;
+layout(location = 4) in vec4 aRow2;
+layout(location = 5) in float aMaterial;
+
+out vec3 WorldPos;
+flat out vec3 FaceNormal;
+flat out float Material;
+
+// Same camera uniforms as the tracer, so rasterized and traced hits line up exactly
+uniform vec3 uCamPos;
+uniform mat3 uCamRot;
+uniform float uAspect;
+uniform float uFov;
+uniform float uNear;
+uniform float uFar;
+
+void main() {
+    // Rows are stored, so v * M applies the instance transform
+    mat3x4 objectToWorld = mat3x4(aRow0, aRow1, aRow2);
+    vec3 worldPos = vec4(aPos, 1.0) * objectToWorld;
+
+    // uCamRot is orthonormal: its transpose takes world space into camera space (+z forward)
+    vec3 view = transpose(uCamRot) * (worldPos - uCamPos);
+    float tanHalf = tan(uFov / 2.0);
+
+    // Inverse of the tracer's rayDir = uCamRot * (uv.x * aspect * tanHalf, uv.y * tanHalf, 1)
+    float depthScale = (uFar + uNear) / (uFar - uNear);
+    float depthOffset = -2.0 * uFar * uNear / (uFar - uNear);
+    gl_Position = vec4(view.x / (uAspect * tanHalf), view.y / tanHalf,
+                       depthScale * view.z + depthOffset, view.z);
+
+    WorldPos = worldPos;
+    // Normals take the inverse transpose of the linear part, which mat3() returns transposed
+    FaceNormal = normalize(inverse(mat3(objectToWorld)) * aNormal);
+    Material = aMaterial;
+}
@@ -0,0 +1,11 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 Uv;
+in vec4 Color;
+
+uniform sampler2D uFont; // glyph coverage in r, one solid cell for filled rectangles
+
+void main() {
+    float coverage = texture(uFont, Uv).r;
+    FragColor = vec4(Color.rgb, Color.a * coverage);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+layout(location = 0) in vec2 aPos;    // window pixels, origin at the top left
+layout(location = 1) in vec2 aUv;     // font atlas coordinates
+layout(location = 2) in vec4 aColor;
+out vec2 Uv;
+out vec4 Color;
+
+uniform vec2 uViewport;
+
+void main() {
+    Uv = aUv;
+    Color = aColor;
+    vec2 ndc = aPos / uViewport * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+}
@@ -0,0 +1,276 @@
+#version 430 core
+// Linear BVH construction (Karras 2012) for one mesh, entirely on the GPU.
+// Compiled once per kernel; the host defines exactly one of:
+//   LBVH_CENTROID_BOUNDS  bounds of the triangle centroids
+//   LBVH_MORTON           30-bit Morton code and index per triangle
+//   LBVH_SORT_COUNT       4-bit digit histogram per workgroup
+//   LBVH_SORT_SCAN        exclusive scan of the histograms (one workgroup)
+//   LBVH_SORT_SCATTER     stable scatter of keys and values by digit
+//   LBVH_HIERARCHY        parent/child links of the internal nodes
+//   LBVH_FIT              leaf-to-root bounds pass and node output
+// The finished nodes use the scene buffer's BVH node layout,
+// (min.xyz, first), (max.xyz, count), with the children of internal
+// node i at 2i + 1 and 2i + 2 of the mesh's node range.
+layout(local_size_x = 256) in;
+
+uniform samplerBuffer uScenePrims;
+uniform int uTriangleOffset;  // first triangle texel of the scene
+uniform int uTriangleBase;    // first triangle of this mesh
+uniform int uCount;           // triangles in this mesh
+
+layout(std430, binding = 0) buffer SceneTexels { vec4 sceneTexels[]; };
+layout(std430, binding = 1) buffer KeysIn { uint keysIn[]; };
+layout(std430, binding = 2) buffer ValuesIn { uint valuesIn[]; };
+layout(std430, binding = 3) buffer KeysOut { uint keysOut[]; };
+layout(std430, binding = 4) buffer ValuesOut { uint valuesOut[]; };
+layout(std430, binding = 5) buffer Histogram { uint histogram[]; };
+layout(std430, binding = 6) buffer CentroidBounds { uint centroidBounds[6]; };  // ordered min.xyz, max.xyz
+// Node ids: internal nodes 0..n-2, leaf k at n-1+k
+layout(std430, binding = 7) coherent buffer Nodes {
+    ivec2 children[];  // of each internal node
+};
+layout(std430, binding = 8) coherent buffer Parents { int parents[]; };
+layout(std430, binding = 9) coherent buffer Visits { uint visits[]; };
+layout(std430, binding = 10) coherent buffer NodeBounds { vec4 nodeBounds[]; };  // min, max per node id
+
+const uint kRadixBits = 4u;
+const uint kRadixSize = 16u;
+
+// Float to uint mapping that keeps the ordering, so atomicMin/Max work on floats
+uint orderedFromFloat(float f) {
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : (u | 0x80000000u);
+}
+
+float floatFromOrdered(uint u) {
+    return uintBitsToFloat((u & 0x80000000u) != 0u ? (u & 0x7fffffffu) : ~u);
+}
+
+void triangleVertices(uint triangle, out vec3 v0, out vec3 v1, out vec3 v2) {
+    int base = uTriangleOffset + (uTriangleBase + int(triangle)) * 3;
+    v0 = texelFetch(uScenePrims, base).xyz;
+    v1 = v0 + texelFetch(uScenePrims, base + 1).xyz;
+    v2 = v0 + texelFetch(uScenePrims, base + 2).xyz;
+}
+
+#ifdef LBVH_CENTROID_BOUNDS
+shared uint groupBounds[6];
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (gl_LocalInvocationIndex < 6u) {
+        groupBounds[gl_LocalInvocationIndex] = gl_LocalInvocationIndex < 3u ? 0xffffffffu : 0u;
+    }
+    barrier();
+    if (i < uint(uCount)) {
+        vec3 v0, v1, v2;
+        triangleVertices(i, v0, v1, v2);
+        vec3 c = (v0 + v1 + v2) / 3.0;
+        for (int a = 0; a < 3; a++) {
+            atomicMin(groupBounds[a], orderedFromFloat(c[a]));
+            atomicMax(groupBounds[a + 3], orderedFromFloat(c[a]));
+        }
+    }
+    barrier();
+    // One global atomic per workgroup and bound
+    if (gl_LocalInvocationIndex < 3u) {
+        atomicMin(centroidBounds[gl_LocalInvocationIndex], groupBounds[gl_LocalInvocationIndex]);
+    } else if (gl_LocalInvocationIndex < 6u) {
+        atomicMax(centroidBounds[gl_LocalInvocationIndex], groupBounds[gl_LocalInvocationIndex]);
+    }
+}
+#endif
+
+#ifdef LBVH_MORTON
+// Spreads the low 10 bits of x so there are two zero bits between each
+uint expandBits(uint x) {
+    x = (x * 0x00010001u) & 0xff0000ffu;
+    x = (x * 0x00000101u) & 0x0f00f00fu;
+    x = (x * 0x00000011u) & 0xc30c30c3u;
+    x = (x * 0x00000005u) & 0x49249249u;
+    return x;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uint(uCount)) return;
+    vec3 lo = vec3(floatFromOrdered(centroidBounds[0]), floatFromOrdered(centroidBounds[1]),
+                   floatFromOrdered(centroidBounds[2]));
+    vec3 hi = vec3(floatFromOrdered(centroidBounds[3]), floatFromOrdered(centroidBounds[4]),
+                   floatFromOrdered(centroidBounds[5]));
+    vec3 v0, v1, v2;
+    triangleVertices(i, v0, v1, v2);
+    vec3 c = (v0 + v1 + v2) / 3.0;
+    vec3 unit = clamp((c - lo) / max(hi - lo, vec3(1e-20)), 0.0, 1.0);
+    uvec3 q = uvec3(min(unit * 1024.0, vec3(1023.0)));
+    keysOut[i] = (expandBits(q.x) << 2) | (expandBits(q.y) << 1) | expandBits(q.z);
+    valuesOut[i] = i;
+}
+#endif
+
+#ifdef LBVH_SORT_COUNT
+uniform uint uShift;
+shared uint groupCounts[kRadixSize];
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (gl_LocalInvocationIndex < kRadixSize) groupCounts[gl_LocalInvocationIndex] = 0u;
+    barrier();
+    if (i < uint(uCount)) {
+        atomicAdd(groupCounts[(keysIn[i] >> uShift) & (kRadixSize - 1u)], 1u);
+    }
+    barrier();
+    // Digit-major layout: one scan over the whole array yields every
+    // workgroup's output offset for every digit
+    if (gl_LocalInvocationIndex < kRadixSize) {
+        histogram[gl_LocalInvocationIndex * gl_NumWorkGroups.x + gl_WorkGroupID.x] = groupCounts[gl_LocalInvocationIndex];
+    }
+}
+#endif
+
+#ifdef LBVH_SORT_SCAN
+uniform uint uHistogramSize;
+shared uint scan[256];
+
+void main() {
+    uint t = gl_LocalInvocationIndex;
+    uint carry = 0u;
+    for (uint base = 0u; base < uHistogramSize; base += 256u) {
+        uint value = base + t < uHistogramSize ? histogram[base + t] : 0u;
+        scan[t] = value;
+        barrier();
+        // Hillis-Steele inclusive scan of this chunk
+        for (uint offset = 1u; offset < 256u; offset <<= 1) {
+            uint add = t >= offset ? scan[t - offset] : 0u;
+            barrier();
+            scan[t] += add;
+            barrier();
+        }
+        if (base + t < uHistogramSize) {
+            histogram[base + t] = carry + scan[t] - value;
+        }
+        carry += scan[255];
+        barrier();
+    }
+}
+#endif
+
+#ifdef LBVH_SORT_SCATTER
+uniform uint uShift;
+shared uint digits[256];
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    uint t = gl_LocalInvocationIndex;
+    bool valid = i < uint(uCount);
+    uint key = valid ? keysIn[i] : 0u;
+    uint digit = valid ? (key >> uShift) & (kRadixSize - 1u) : kRadixSize;
+    digits[t] = digit;
+    barrier();
+    if (!valid) return;
+    // Stable: rank among the earlier items of this workgroup with the same digit
+    uint rank = 0u;
+    for (uint j = 0u; j < t; j++) {
+        rank += digits[j] == digit ? 1u : 0u;
+    }
+    uint dest = histogram[digit * gl_NumWorkGroups.x + gl_WorkGroupID.x] + rank;
+    keysOut[dest] = key;
+    valuesOut[dest] = valuesIn[i];
+}
+#endif
+
+#ifdef LBVH_HIERARCHY
+// Length of the common prefix of the keys at i and j; equal keys fall back
+// to the indices so every key is unique. -1 outside the array.
+int delta(int i, int j) {
+    if (j < 0 || j >= uCount) return -1;
+    uint a = keysIn[i];
+    uint b = keysIn[j];
+    if (a == b) return 32 + 31 - findMSB(uint(i ^ j));
+    return 31 - findMSB(a ^ b);
+}
+
+void main() {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= uCount - 1) return;
+
+    // Direction of the range and its far end
+    int d = delta(i, i + 1) - delta(i, i - 1) >= 0 ? 1 : -1;
+    int deltaMin = delta(i, i - d);
+    int lengthMax = 2;
+    while (delta(i, i + lengthMax * d) > deltaMin) lengthMax *= 2;
+    int l = 0;
+    for (int t = lengthMax / 2; t >= 1; t /= 2) {
+        if (delta(i, i + (l + t) * d) > deltaMin) l += t;
+    }
+    int j = i + l * d;
+
+    // Split position: the last key sharing more than deltaNode bits with i
+    int deltaNode = delta(i, j);
+    int s = 0;
+    int divisor = 2;
+    for (int t = (l + 1) / 2; ; t = (l + divisor - 1) / divisor) {
+        if (delta(i, i + (s + t) * d) > deltaNode) s += t;
+        if (t <= 1) break;
+        divisor *= 2;
+    }
+    int gamma = i + s * d + min(d, 0);
+
+    int leafBase = uCount - 1;
+    int left = min(i, j) == gamma ? leafBase + gamma : gamma;
+    int right = max(i, j) == gamma + 1 ? leafBase + gamma + 1 : gamma + 1;
+    children[i] = ivec2(left, right);
+    parents[left] = i;
+    parents[right] = i;
+    visits[i] = 0u;
+    if (i == 0) parents[0] = -1;
+}
+#endif
+
+#ifdef LBVH_FIT
+uniform int uBlasNodeOffset;  // first BVH node texel of the scene
+uniform int uNodeBase;        // first node of this mesh
+
+// Slot of a node in the output: the root first, then each internal
+// node's children as an adjacent pair
+int outputSlot(int node) {
+    int parent = parents[node];
+    if (parent < 0) return 0;
+    return children[parent].x == node ? 2 * parent + 1 : 2 * parent + 2;
+}
+
+void writeNode(int node, vec3 bmin, vec3 bmax, int first, int count) {
+    int texel = uBlasNodeOffset + (uNodeBase + outputSlot(node)) * 2;
+    sceneTexels[texel] = vec4(bmin, float(first));
+    sceneTexels[texel + 1] = vec4(bmax, float(count));
+}
+
+void main() {
+    int k = int(gl_GlobalInvocationID.x);
+    if (k >= uCount) return;
+
+    uint triangle = valuesIn[k];
+    vec3 v0, v1, v2;
+    triangleVertices(triangle, v0, v1, v2);
+    vec3 bmin = min(v0, min(v1, v2));
+    vec3 bmax = max(v0, max(v1, v2));
+    int node = uCount - 1 + k;
+    nodeBounds[node * 2] = vec4(bmin, 0.0);
+    nodeBounds[node * 2 + 1] = vec4(bmax, 0.0);
+    writeNode(node, bmin, bmax, uTriangleBase + int(triangle), 1);
+
+    // Climb towards the root; the second child to arrive at a node fits it
+    int parent = parents[node];
+    while (parent >= 0) {
+        memoryBarrierBuffer();
+        if (atomicAdd(visits[parent], 1u) == 0u) return;
+        ivec2 c = children[parent];
+        bmin = min(nodeBounds[c.x * 2].xyz, nodeBounds[c.y * 2].xyz);
+        bmax = max(nodeBounds[c.x * 2 + 1].xyz, nodeBounds[c.y * 2 + 1].xyz);
+        nodeBounds[parent * 2] = vec4(bmin, 0.0);
+        nodeBounds[parent * 2 + 1] = vec4(bmax, 0.0);
+        writeNode(parent, bmin, bmax, uNodeBase + 2 * parent + 1, 0);
+        parent = parents[parent];
+    }
+}
+#endif
@@ -5,6 +5,30 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include "Shader.h"
+#include "AdaptiveSampler.h"
+#include "BatchRender.h"
+#include "Camera.h"
+#include "DistributedRender.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "FrameProfiler.h"
+#include "GpuBvh.h"
+#include "GpuTimer.h"
+#include "Hud.h"
+#include "Options.h"
+#include "PreviewLod.h"
+#include "RasterGBuffer.h"
+#include "RenderDaemon.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "SceneCodegen.h"
+#include "Svgf.h"
+#include "TemporalReprojection.h"
+#include "TileList.h"
+#include "TileScheduler.h"
+#include "TraceStats.h"
+#include "VideoOutput.h"
+#include <algorithm>
 #include <cmath>
 
 // Global camera state
@@ -47,20 +71,91 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
         pitch = -1.57f;
 }
 
-int main() {
+// What a timed trace pass contained, looked up when its GPU timer result arrives.
+struct TraceRecord {
+    PreviewLevel level;
+    int slicedTiles;  // tiles drawn by a time-sliced pass, 0 for a full-screen draw
+    int pixels;
+    int samples;      // samples per traced pixel
+    bool stackless;   // traced with the stackless BVH permutation
+};
+const int kTraceRecordCount = 16;
+
+// Trace passes left out of --bvh-benchmark results.
+const int kBvhBenchmarkWarmupPasses = 4;
+
+// Internal render resolution for a given window framebuffer size.
+void computeRenderSize(const AppOptions& options, float renderScale, int fbWidth, int fbHeight,
+                       int& renderWidth, int& renderHeight) {
+    if (options.renderWidth > 0 && options.renderHeight > 0) {
+        renderWidth = options.renderWidth;
+        renderHeight = options.renderHeight;
+    }
+    else {
+        renderWidth = static_cast<int>(fbWidth * renderScale + 0.5f);
+        renderHeight = static_cast<int>(fbHeight * renderScale + 0.5f);
+    }
+    if (renderWidth < 1) renderWidth = 1;
+    if (renderHeight < 1) renderHeight = 1;
+}
+
+int main(int argc, char** argv) {
+    AppOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return -1;
+    }
+
+    // Batch mode renders a job file offline; its scene overrides --scene
+    BatchJob batchJob;
+    bool batchMode = !options.batchJobPath.empty();
+    if (batchMode) {
+        if (!loadBatchJob(options.batchJobPath, batchJob)) {
+            return -1;
+        }
+        if (!batchJob.scene.empty()) {
+            options.scene = batchJob.scene;
+        }
+    }
+    if (batchMode && !options.workers.empty()) {
+        // The workers do the tracing; no local context is needed
+        return runDistributedJob(batchJob, options.workers, options.daemonToken) ? 0 : 1;
+    }
+
+    // Video frames advance a fixed timestep. Features steered by measured GPU
+    // time would make the frames depend on the machine, so they are off.
+    bool videoMode = !options.videoPath.empty();
+    if (videoMode) {
+        options.dynamicResolution = false;
+        options.timeSlicing = false;
+        options.idleThrottle = false;
+        options.previewLod = false;
+    }
+
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW\n";
         return -1;
     }
 
-    // Set OpenGL version (3.3 core profile)
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // Set OpenGL version (3.3 core profile). The GPU BVH builder needs compute
+    // shaders, so it asks for 4.3 first and falls back to 3.3 without it.
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, options.gpuBvh ? 4 : 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    bool daemonMode = !options.daemonAddress.empty();
+    if (batchMode || daemonMode) {
+        // Only the context is needed
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     // Create a window
     GLFWwindow* window = glfwCreateWindow(1280, 720, "GPU Ray Tracer", nullptr, nullptr);
+    if (!window && options.gpuBvh) {
+        std::cerr << "OpenGL 4.3 unavailable, building BVHs on the CPU\n";
+        options.gpuBvh = false;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        window = glfwCreateWindow(1280, 720, "GPU Ray Tracer", nullptr, nullptr);
+    }
     if (!window) {
         std::cerr << "Failed to create GLFW window\n";
         glfwTerminate();
@@ -85,8 +180,61 @@ int main() {
     }
     glViewport(0, 0, 1280, 720);
 
-    // Create and compile the shader program (loads vertex_shader.glsl and fragment_shader.glsl)
-    GLuint shaderProgram = createShaderProgram("vertex_shader.glsl", "fragment_shader.glsl");
+    // Describe the scene on the host. Small scenes are baked into the shader as constants,
+    // larger ones are traced from a texture buffer by the generic path.
+    Scene scene = (options.scene == "meshes") ? createMeshScene()
+        : (options.scene == "instances") ? createInstancedScene()
+        : (options.scene == "animated") ? createAnimatedScene() : createDefaultScene();
+    bool specializeScene = shouldSpecializeScene(scene);
+    std::cout << "Scene: " << scenePrimitiveCount(scene) << " primitives, "
+              << (specializeScene ? "specialized" : "generic") << " shader path\n";
+    SceneBuffers sceneBuffers = uploadSceneBuffers(scene, options.wideBvh);
+    bool animatedScene = sceneAnimated(scene);
+
+    // Animated meshes are refit on the CPU unless the GPU builder is available
+    bool gpuBvhEnabled = options.gpuBvh && gpuBvhSupported() && animatedScene && !specializeScene;
+    GpuBvhBuilder gpuBvh;
+    if (gpuBvhEnabled) {
+        createGpuBvhBuilder(gpuBvh, scene);
+        std::cout << "Building animated mesh BVHs on the GPU\n";
+    }
+    if (!scene.instances.empty()) {
+        std::cout << "Meshes: " << scene.instances.size() << " instances of " << scene.meshes.size()
+                  << " meshes, " << sceneTriangleCount(scene) << " triangles, top-level BVH built in "
+                  << sceneBuffers.tlasBuildMs << " ms\n";
+    }
+    if (sceneBuffers.wideNodeCount > 0) {
+        // Wide nodes take five texels, binary ones two
+        std::cout << "Static mesh BVHs: " << sceneBuffers.wideNodeCount << " wide nodes, "
+                  << sceneBuffers.wideNodeCount * 80 / 1024 << " KiB (binary: "
+                  << sceneBuffers.binaryNodeCount << " nodes, " << sceneBuffers.binaryNodeCount * 32 / 1024
+                  << " KiB)\n";
+    }
+
+    // Create and compile the shader program (loads tile_vertex_shader.glsl and fragment_shader.glsl).
+    // The tiled vertex shader lets adaptive sampling rasterize only the tiles that need samples.
+    std::string fragmentSource = buildSceneFragmentSource(readFile("fragment_shader.glsl"), scene, specializeScene);
+    if (options.traceStats) {
+        fragmentSource = addShaderDefines(fragmentSource, { "TRACE_STATS" });
+    }
+    std::string tileVertexSource = readFile("tile_vertex_shader.glsl");
+    GLuint stackProgram = createShaderProgramFromSource(tileVertexSource, fragmentSource);
+    initTileListUniforms(stackProgram);
+
+    // The generic path also gets the stackless BVH permutation, selectable at runtime
+    GLuint stacklessProgram = 0;
+    if (!specializeScene) {
+        stacklessProgram = createShaderProgramFromSource(
+            tileVertexSource, addShaderDefines(fragmentSource, { "BVH_STACKLESS" }));
+        initTileListUniforms(stacklessProgram);
+    }
+    bool stacklessEnabled = options.stacklessBvh && stacklessProgram != 0;
+    bool bvhBenchmark = options.bvhBenchmark && stacklessProgram != 0;
+    GLuint shaderProgram = stacklessEnabled ? stacklessProgram : stackProgram;
+    // GPU milliseconds per megapixel of full-quality passes, per permutation
+    double benchmarkMs[2] = {};
+    double benchmarkMegapixels[2] = {};
+    int benchmarkPasses[2] = {};
 
     // Load the HDR skybox image ("skybox.hdr") using stb_image.
     int width, height, nrComponents;
@@ -125,21 +273,198 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glBindVertexArray(0);
 
+    if (batchMode || daemonMode) {
+        BatchResources batch;
+        batch.traceProgram = stackProgram;
+        batch.quadVAO = quadVAO;
+        batch.skyboxTexture = skyboxTexture;
+        batch.scene = &scene;
+        batch.sceneBuffers = &sceneBuffers;
+        batch.specializeScene = specializeScene;
+        batch.gpuBvh = gpuBvhEnabled ? &gpuBvh : nullptr;
+        bool batchSucceeded;
+        if (batchMode) {
+            batchSucceeded = runBatchJob(batchJob, batch);
+        }
+        else {
+            DaemonOptions daemonOptions;
+            daemonOptions.address = options.daemonAddress;
+            daemonOptions.token = options.daemonToken;
+            batchSucceeded = runRenderDaemon(daemonOptions, batch);
+        }
+
+        glDeleteVertexArrays(1, &quadVAO);
+        glDeleteBuffers(1, &quadVBO);
+        destroySceneBuffers(sceneBuffers);
+        if (gpuBvhEnabled) {
+            destroyGpuBvhBuilder(gpuBvh);
+        }
+        glDeleteProgram(stackProgram);
+        if (stacklessProgram != 0) {
+            glDeleteProgram(stacklessProgram);
+        }
+        glfwTerminate();
+        return batchSucceeded ? 0 : 1;
+    }
+
+    // The upscale program stretches the internal-resolution image over the window.
+    GLuint upscaleProgram = createShaderProgram("vertex_shader.glsl", "upscale_shader.glsl");
+
+    // CPU and GPU frame timeline, dumped as Chrome trace JSON
+    FrameProfiler profiler;
+    createFrameProfiler(profiler, options.profile);
+    if (options.profile) {
+        std::cout << "Frame profiler enabled: 'J' writes " << options.profilePath << "\n";
+    }
+
+    // Performance overlay, toggled with F1
+    Hud hud;
+    createHud(hud, options.hud);
+    HudStats hudStats;
+    hudStats.targetMs = options.targetMs;
+
+    // Frame dump, read back through a PBO ring and written on the capture thread
+    FrameCapture frameCapture;
+    std::string capturePattern = options.capturePattern;
+    createFrameCapture(frameCapture, [capturePattern](const CapturedFrame& frame) {
+        writeCapturedFramePpm(captureFramePath(capturePattern, frame.index), frame);
+    }, true);
+    bool captureEnabled = options.capture;
+
+    // Video stream at the initial window size, produced as fast as the GPU and encoder allow
+    VideoOutput video;
+    if (videoMode) {
+        int videoWidth, videoHeight;
+        glfwGetFramebufferSize(window, &videoWidth, &videoHeight);
+        if (!createVideoOutput(video, options.videoPath, videoWidth, videoHeight, options.videoFps)) {
+            glfwTerminate();
+            return -1;
+        }
+        glfwSwapInterval(0);
+    }
+
+    // Cost heatmap of the instrumented trace shader
+    TraceStatsOverlay traceStatsOverlay;
+    if (options.traceStats) {
+        createTraceStatsOverlay(traceStatsOverlay);
+        std::cout << "Trace stats enabled: 'I' cycles the heatmap, 'O' writes " << options.traceStatsPath << "\n";
+        if (!GLEW_ARB_shader_clock) {
+            std::cout << "ARB_shader_clock unavailable, cycle counts will read zero\n";
+        }
+    }
+
     // Timing and key toggle variables
     float lastFrame = 0.0f;
     bool lastVPressed = false;
     bool lastGPressed = false;
     bool lastBPressed = false;
     bool lastFPressed = false;
+    bool lastRPressed = false;
+    bool lastPPressed = false;
+    bool lastNPressed = false;
+    bool lastMPressed = false;
+    bool lastLPressed = false;
+    bool lastHPressed = false;
+    bool lastTPressed = false;
+    bool lastIPressed = false;
+    bool lastOPressed = false;
+    bool lastJPressed = false;
+    bool lastF1Pressed = false;
+    bool lastF12Pressed = false;
+    bool lastLeftBracketPressed = false;
+    bool lastRightBracketPressed = false;
     bool fullscreen = false;
 
+    // Offscreen target the tracer renders into, independent of the window size.
+    float renderScale = options.renderScale;
+    int renderWidth, renderHeight;
+    computeRenderSize(options, renderScale, 1280, 720, renderWidth, renderHeight);
+    // Attachment 0: radiance and sample count, 1: primary normal and hit distance,
+    // 2: primary albedo, 3: indirect radiance, 4: cost counters of the instrumented shader.
+    std::vector<GLenum> traceFormats = { GL_RGBA16F, GL_RGBA32F, GL_RGBA16F, GL_RGBA16F };
+    if (options.traceStats) {
+        traceFormats.push_back(GL_RGBA32UI);
+    }
+    RenderTarget traceTarget = createRenderTarget(renderWidth, renderHeight, traceFormats);
+
+    // Temporal reprojection accumulates samples across frames, following the camera.
+    bool temporalEnabled = options.temporalReprojection;
+    TemporalHistory temporalHistory;
+    createTemporalHistory(temporalHistory, renderWidth, renderHeight);
+
+    // SVGF denoiser on the trace G-buffer; replaces plain reprojection while enabled.
+    bool svgfEnabled = options.svgf;
+    SvgfState svgf;
+    createSvgf(svgf, renderWidth, renderHeight);
+
+    // Adaptive sampling stops tracing pixels whose accumulated estimate has converged.
+    bool adaptiveEnabled = options.adaptiveSampling;
+    AdaptiveSampler adaptiveSampler;
+    adaptiveSampler.threshold = options.adaptiveThreshold;
+    createAdaptiveSampler(adaptiveSampler, renderWidth, renderHeight);
+    bool imageConverged = false;
+
+    // Dynamic resolution: GPU time of the trace pass drives the render scale,
+    // never exceeding the scale requested on the command line.
+    bool dynamicResolutionEnabled = options.dynamicResolution && options.renderWidth == 0;
+    DynamicResolution dynamicResolution;
+    dynamicResolution.targetMs = options.targetMs;
+    dynamicResolution.maxScale = options.renderScale;
+    dynamicResolution.minScale = std::fmin(dynamicResolution.minScale, options.renderScale);
+    dynamicResolution.scale = options.renderScale;
+    GpuTimer traceTimer;
+    createGpuTimer(traceTimer);
+
+    // Heavy modes trace in tiles spread over several frames, within a GPU time budget.
+    // A sliced pass keeps the camera and time it started with.
+    TileScheduler tileScheduler;
+    tileScheduler.budgetMs = options.sliceMs > 0.0f ? options.sliceMs : options.targetMs;
+    createTileScheduler(tileScheduler, renderWidth, renderHeight);
+    CameraState slicedPassCamera = {};
+    float slicedPassTime = 0.0f;
+    GLuint displayTexture = traceTarget.textures[0];
+
+    // Hybrid mode: triangle meshes are rasterized for primary visibility instead of traced.
+    bool hybridEnabled = options.hybridRaster;
+    RasterGBuffer rasterGBuffer;
+    createRasterGBuffer(rasterGBuffer, scene, renderWidth, renderHeight);
+
+    // Preview ladder: cheaper shading and resolution while the camera moves.
+    bool previewLodEnabled = options.previewLod;
+    PreviewLod previewLod;
+    previewLod.targetMs = options.targetMs;
+    PreviewLevel previewLevel = kPreviewFull;
+
+    // Timer results arrive a few frames late and are matched to their pass by tag.
+    TraceRecord traceRecords[kTraceRecordCount] = {};
+    int traceFrame = 0;
+
+    // Render on demand: once a still image has accumulated enough samples the
+    // loop sleeps until input arrives instead of redrawing the same picture.
+    // Animated scenes change every frame and never go idle.
+    bool idleAllowed = options.idleThrottle && !animatedScene && !bvhBenchmark;
+    bool idle = false;
+    float effectiveSpp = 0.0f;  // samples behind each displayed pixel
+
     // Main rendering loop
     while (!glfwWindowShouldClose(window)) {
-        // Calculate delta time
-        float currentFrame = static_cast<float>(glfwGetTime());
-        float deltaTime = currentFrame - lastFrame;
+        if (idle) {
+            {
+                ProfileZone idleZone(profiler, "idle");
+                glfwWaitEvents();
+            }
+            // Time spent asleep must not turn into camera movement
+            lastFrame = static_cast<float>(glfwGetTime());
+        }
+        int64_t frameStartNs = profilerNow(profiler);
+
+        // Calculate delta time; video frames are a fixed step apart
+        float currentFrame = videoMode ? static_cast<float>(video.frameCount) / options.videoFps
+                                       : static_cast<float>(glfwGetTime());
+        float deltaTime = videoMode ? 1.0f / options.videoFps : currentFrame - lastFrame;
         lastFrame = currentFrame;
         const float moveSpeed = 2.0f * deltaTime;
+        recordHudFrame(hud, deltaTime * 1000.0f);
 
         // Process input events
         glfwPollEvents();
@@ -168,6 +493,11 @@ int main() {
         bool currentVPressed = (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS);
         if (currentVPressed && !lastVPressed) {
             denoiseEnabled = !denoiseEnabled;
+            resetDynamicResolution(dynamicResolution);
+            resetPreviewCosts(previewLod);
+            resetTemporalHistory(temporalHistory);
+            resetSvgf(svgf);
+            restartTilePass(tileScheduler);
             std::cout << "Denoiser toggled " << (denoiseEnabled ? "ON" : "OFF") << "\n";
         }
         lastVPressed = currentVPressed;
@@ -176,6 +506,11 @@ int main() {
         bool currentGPressed = (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS);
         if (currentGPressed && !lastGPressed) {
             giEnabled = !giEnabled;
+            resetDynamicResolution(dynamicResolution);
+            resetPreviewCosts(previewLod);
+            resetTemporalHistory(temporalHistory);
+            resetSvgf(svgf);
+            restartTilePass(tileScheduler);
             std::cout << "Global Illumination toggled " << (giEnabled ? "ON" : "OFF") << "\n";
         }
         lastGPressed = currentGPressed;
@@ -184,10 +519,171 @@ int main() {
         bool currentBPressed = (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS);
         if (currentBPressed && !lastBPressed) {
             skyboxEnabled = !skyboxEnabled;
+            resetTemporalHistory(temporalHistory);
+            resetSvgf(svgf);
+            restartTilePass(tileScheduler);
             std::cout << "Skybox toggled " << (skyboxEnabled ? "ON" : "OFF") << "\n";
         }
         lastBPressed = currentBPressed;
 
+        // Toggle temporal reprojection with 'P'
+        bool currentPPressed = (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS);
+        if (currentPPressed && !lastPPressed) {
+            temporalEnabled = !temporalEnabled;
+            resetTemporalHistory(temporalHistory);
+            restartTilePass(tileScheduler);
+            std::cout << "Temporal reprojection toggled " << (temporalEnabled ? "ON" : "OFF") << "\n";
+        }
+        lastPPressed = currentPPressed;
+
+        // Toggle the SVGF denoiser with 'N'
+        bool currentNPressed = (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS);
+        if (currentNPressed && !lastNPressed) {
+            svgfEnabled = !svgfEnabled;
+            resetSvgf(svgf);
+            restartTilePass(tileScheduler);
+            std::cout << "SVGF filter toggled " << (svgfEnabled ? "ON" : "OFF") << "\n";
+        }
+        lastNPressed = currentNPressed;
+
+        // Toggle adaptive sampling with 'M'
+        bool currentMPressed = (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS);
+        if (currentMPressed && !lastMPressed) {
+            adaptiveEnabled = !adaptiveEnabled;
+            resetAdaptiveSampler(adaptiveSampler);
+            restartTilePass(tileScheduler);
+            std::cout << "Adaptive sampling toggled " << (adaptiveEnabled ? "ON" : "OFF") << "\n";
+        }
+        lastMPressed = currentMPressed;
+
+        // Toggle the preview quality ladder with 'L'
+        bool currentLPressed = (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS);
+        if (currentLPressed && !lastLPressed) {
+            previewLodEnabled = !previewLodEnabled;
+            std::cout << "Preview LOD toggled " << (previewLodEnabled ? "ON" : "OFF") << "\n";
+        }
+        lastLPressed = currentLPressed;
+
+        // Toggle rasterized primary visibility with 'H'
+        bool currentHPressed = (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS);
+        if (currentHPressed && !lastHPressed) {
+            hybridEnabled = !hybridEnabled;
+            restartTilePass(tileScheduler);
+            std::cout << "Hybrid raster primary toggled " << (hybridEnabled ? "ON" : "OFF") << "\n";
+        }
+        lastHPressed = currentHPressed;
+
+        // Toggle the stackless BVH traversal with 'T'
+        bool currentTPressed = (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS);
+        if (currentTPressed && !lastTPressed && stacklessProgram != 0) {
+            stacklessEnabled = !stacklessEnabled;
+            resetDynamicResolution(dynamicResolution);
+            resetPreviewCosts(previewLod);
+            std::cout << "Stackless BVH traversal toggled " << (stacklessEnabled ? "ON" : "OFF") << "\n";
+        }
+        lastTPressed = currentTPressed;
+
+        // Cycle the cost heatmap with 'I' and dump its CSV histogram with 'O'
+        if (options.traceStats) {
+            bool currentIPressed = (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS);
+            if (currentIPressed && !lastIPressed) {
+                cycleTraceStatsOverlay(traceStatsOverlay);
+                std::cout << "Cost heatmap: "
+                          << (traceStatsOverlay.stat < 0 ? "OFF" : kTraceStatNames[traceStatsOverlay.stat]) << "\n";
+            }
+            lastIPressed = currentIPressed;
+            bool currentOPressed = (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS);
+            if (currentOPressed && !lastOPressed) {
+                writeTraceStatsCsv(traceTarget.textures[kTraceStatsAttachment], traceTarget.width,
+                                   traceTarget.height, options.traceStatsPath);
+            }
+            lastOPressed = currentOPressed;
+        }
+
+        // Show or hide the performance overlay with F1
+        bool currentF1Pressed = (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS);
+        if (currentF1Pressed && !lastF1Pressed) {
+            hud.visible = !hud.visible;
+        }
+        lastF1Pressed = currentF1Pressed;
+
+        // Start or stop the frame dump with F12
+        bool currentF12Pressed = (glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS);
+        if (currentF12Pressed && !lastF12Pressed) {
+            captureEnabled = !captureEnabled;
+            std::cout << "Frame capture " << (captureEnabled ? "started" : "stopped") << "\n";
+        }
+        lastF12Pressed = currentF12Pressed;
+
+        // Write the frame timeline so far with 'J'
+        bool currentJPressed = (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS);
+        if (currentJPressed && !lastJPressed && options.profile) {
+            writeFrameProfile(profiler, options.profilePath);
+        }
+        lastJPressed = currentJPressed;
+
+        // Lower / raise the internal render scale with '[' and ']'
+        bool currentLeftBracketPressed = (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS);
+        bool currentRightBracketPressed = (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS);
+        if ((currentLeftBracketPressed && !lastLeftBracketPressed) ||
+            (currentRightBracketPressed && !lastRightBracketPressed)) {
+            float step = currentLeftBracketPressed ? -0.125f : 0.125f;
+            renderScale = std::fmin(std::fmax(renderScale + step, 0.125f), 2.0f);
+            if (dynamicResolutionEnabled) {
+                dynamicResolutionEnabled = false;
+                std::cout << "Dynamic resolution OFF (manual scale)\n";
+            }
+        }
+        lastLeftBracketPressed = currentLeftBracketPressed;
+        lastRightBracketPressed = currentRightBracketPressed;
+
+        // Toggle dynamic resolution with 'R'
+        bool currentRPressed = (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS);
+        if (currentRPressed && !lastRPressed && options.renderWidth == 0) {
+            dynamicResolutionEnabled = !dynamicResolutionEnabled;
+            if (dynamicResolutionEnabled) {
+                dynamicResolution.maxScale = std::fmax(renderScale, dynamicResolution.minScale);
+                dynamicResolution.scale = dynamicResolution.maxScale;
+                resetDynamicResolution(dynamicResolution);
+            }
+            std::cout << "Dynamic resolution toggled " << (dynamicResolutionEnabled ? "ON" : "OFF") << "\n";
+        }
+        lastRPressed = currentRPressed;
+
+        // Let the controller pick the render scale from the GPU timings of
+        // full-quality frames as they arrive. Sliced passes size the next batches instead.
+        GpuTimerResult traceResult;
+        while (pollGpuTimer(traceTimer, traceResult)) {
+            if (traceResult.tag <= 0) {
+                continue;
+            }
+            const TraceRecord& record = traceRecords[traceResult.tag % kTraceRecordCount];
+            // The first passes of each program include its lazy compilation
+            if (bvhBenchmark && traceResult.tag > kBvhBenchmarkWarmupPasses &&
+                record.level == kPreviewFull && record.pixels > 0) {
+                benchmarkMs[record.stackless] += traceResult.ms;
+                benchmarkMegapixels[record.stackless] += record.pixels * 1e-6;
+                benchmarkPasses[record.stackless]++;
+            }
+            recordPreviewCost(previewLod, record.level, traceResult.ms, record.pixels);
+            hudStats.traceMs = traceResult.ms;
+            if (traceResult.ms > 0.0) {
+                hudStats.primaryMrays = static_cast<double>(record.pixels) * record.samples / (traceResult.ms * 1000.0);
+            }
+            if (record.slicedTiles > 0) {
+                updateTileScheduler(tileScheduler, traceResult.ms, record.slicedTiles);
+            }
+            else if (record.level == kPreviewFull && dynamicResolutionEnabled &&
+                     updateDynamicResolution(dynamicResolution, traceResult.ms)) {
+                std::cout << "Dynamic resolution scale " << dynamicResolution.scale
+                          << " (GPU " << traceResult.ms << " ms, target "
+                          << dynamicResolution.targetMs << " ms)\n";
+            }
+        }
+        if (dynamicResolutionEnabled) {
+            renderScale = dynamicResolution.scale;
+        }
+
         // --- FPS-style Movement ---
         float forwardHorizontal[3] = { sin(yaw), 0.0f, cos(yaw) };
         float rightHorizontal[3] = { forwardHorizontal[2], 0.0f, -forwardHorizontal[0] };
@@ -220,92 +716,137 @@ int main() {
         }
         // ---------------------------
 
-        // Update viewport (in case of fullscreen change)
+        recordCpuZone(profiler, "input", frameStartNs);
+        int64_t setupStartNs = profilerNow(profiler);
+
+        // Resize the internal target if the window or render scale changed
         int fbWidth, fbHeight;
         glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
-        glViewport(0, 0, fbWidth, fbHeight);
+        if (fbWidth <= 0 || fbHeight <= 0) {
+            // Minimized: nothing to draw into
+            glfwSwapBuffers(window);
+            continue;
+        }
+        computeRenderSize(options, renderScale, fbWidth, fbHeight, renderWidth, renderHeight);
 
-        glClear(GL_COLOR_BUFFER_BIT);
+        // Pick the preview level from camera motion; a change of level restarts accumulation
+        CameraState camera = makeCameraState(cameraPos, yaw, pitch);
+        PreviewLevel level = kPreviewFull;
+        if (previewLodEnabled) {
+            level = updatePreviewLod(previewLod, camera, deltaTime, renderWidth * renderHeight);
+        }
+        if (level != previewLevel) {
+            previewLevel = level;
+            resetTemporalHistory(temporalHistory);
+            resetSvgf(svgf);
+            restartTilePass(tileScheduler);
+        }
+        renderWidth = std::max(1, static_cast<int>(renderWidth * kPreviewLevelScale[previewLevel] + 0.5f));
+        renderHeight = std::max(1, static_cast<int>(renderHeight * kPreviewLevelScale[previewLevel] + 0.5f));
 
-        glUseProgram(shaderProgram);
+        if (renderWidth != traceTarget.width || renderHeight != traceTarget.height) {
+            resizeRenderTarget(traceTarget, renderWidth, renderHeight);
+            resizeTemporalHistory(temporalHistory, renderWidth, renderHeight);
+            resizeSvgf(svgf, renderWidth, renderHeight);
+            resizeAdaptiveSampler(adaptiveSampler, renderWidth, renderHeight);
+            resizeTileScheduler(tileScheduler, renderWidth, renderHeight);
+            displayTexture = traceTarget.textures[0];
+            std::cout << "Render resolution " << renderWidth << "x" << renderHeight
+                      << " (window " << fbWidth << "x" << fbHeight << ")\n";
 
-        // --- Build the Camera Rotation (front, right, up) from yaw & pitch ---
-        float cosPitch = cosf(pitch);
-        float sinPitch = sinf(pitch);
-        float cosYaw = cosf(yaw);
-        float sinYaw = sinf(yaw);
-
-        // 1) Standard "look" vector in a right-handed coordinate system:
-        //    - yaw rotates around Y
-        //    - pitch rotates around X
-        //    This formula ensures "pitch" always moves the camera up/down in its local X axis
-        float front[3] = {
-            cosPitch * sinYaw,  // X
-            sinPitch,           // Y
-            cosPitch * cosYaw   // Z
-        };
-
-        // Normalize front (just in case)
-        {
-            float len = sqrtf(front[0] * front[0] + front[1] * front[1] + front[2] * front[2]);
-            front[0] /= len;
-            front[1] /= len;
-            front[2] /= len;
-        }
-
-        // 2) Compute right = front x worldUp
-        float worldUp[3] = { 0.0f, 1.0f, 0.0f };
-        float right[3] = {
-            front[1] * worldUp[2] - front[2] * worldUp[1],
-            front[2] * worldUp[0] - front[0] * worldUp[2],
-            front[0] * worldUp[1] - front[1] * worldUp[0]
-        };
-        // Normalize right
-        {
-            float rLen = sqrtf(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
-            right[0] /= rLen;
-            right[1] /= rLen;
-            right[2] /= rLen;
-        }
-
-        // 3) Compute up = right x front
-        float up[3] = {
-            right[1] * front[2] - right[2] * front[1],
-            right[2] * front[0] - right[0] * front[2],
-            right[0] * front[1] - right[1] * front[0]
-        };
-        // Normalize up
-        {
-            float uLen = sqrtf(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
-            up[0] /= uLen;
-            up[1] /= uLen;
-            up[2] /= uLen;
+            std::string title = "GPU Ray Tracer - " + std::to_string(renderWidth) + "x" +
+                std::to_string(renderHeight) + " (" + std::to_string(static_cast<int>(renderScale * 100.0f + 0.5f)) + "%)";
+            glfwSetWindowTitle(window, title.c_str());
         }
 
-        // Now send cameraPos, right, up, and front down to the shader:
-        GLint camPosLoc = glGetUniformLocation(shaderProgram, "uCamPos");
-        glUniform3f(camPosLoc, cameraPos[0], cameraPos[1], cameraPos[2]);
+        // Heavy modes only run at full quality
+        bool fullQuality = (previewLevel == kPreviewFull);
+        bool denoiseActive = denoiseEnabled && fullQuality;
+        bool giActive = giEnabled && fullQuality;
 
-        float camRot[9] = {
-            right[0], up[0], front[0],
-            right[1], up[1], front[1],
-            right[2], up[2], front[2]
-        };
-        GLint camRotLoc = glGetUniformLocation(shaderProgram, "uCamRot");
-        glUniformMatrix3fv(camRotLoc, 1, GL_FALSE, camRot);
+        // Heavy modes are traced a few tiles per frame unless slicing is disabled
+        bool slicing = options.timeSlicing && (denoiseActive || giActive);
+        if (!slicing) {
+            restartTilePass(tileScheduler);
+        }
+
+        // A sliced pass keeps the camera and time it started with
+        float traceTime = currentFrame;
+        if (slicing) {
+            if (tilePassStarting(tileScheduler)) {
+                slicedPassCamera = camera;
+                slicedPassTime = currentFrame;
+            }
+            camera = slicedPassCamera;
+            traceTime = slicedPassTime;
+        }
+
+        // Projection follows the window shape, not the internal resolution, so a
+        // fixed render size never distorts the image.
+        float aspect = static_cast<float>(fbWidth) / fbHeight;
+        float fov = options.fovDegrees * 3.14159265f / 180.0f;
+
+        // Animated meshes move once per pass: their BVHs are refit in place and the
+        // top-level BVH over the instances is rebuilt every pass, so instance
+        // transforms are free to change between frames.
+        recordCpuZone(profiler, "frame setup", setupStartNs);
+        int64_t sceneStartNs = profilerNow(profiler);
+        bool passStarting = !slicing || tilePassStarting(tileScheduler);
+        if (!specializeScene && passStarting && updateSceneMeshes(sceneBuffers, scene, traceTime, !gpuBvhEnabled)) {
+            updateRasterGBufferMeshes(rasterGBuffer, scene);
+            int bvhZone = gpuBvhEnabled ? beginGpuZone(profiler, "gpu bvh build") : -1;
+            for (int m = 0; gpuBvhEnabled && m < static_cast<int>(scene.meshes.size()); m++) {
+                if (scene.meshes[m].twistAmount != 0.0f) {
+                    buildGpuBvh(gpuBvh, sceneBuffers, scene, m);
+                }
+            }
+            endGpuZone(profiler, bvhZone);
+        }
+        if (!specializeScene && !scene.instances.empty() && passStarting) {
+            updateSceneInstances(sceneBuffers, scene);
+        }
+        recordCpuZone(profiler, "scene update", sceneStartNs);
+
+        // Hybrid mode: rasterize the triangle meshes into a G-buffer the tracer starts from
+        bool hybridActive = hybridEnabled && !scene.instances.empty();
+        if (hybridActive && passStarting) {
+            resizeRasterGBuffer(rasterGBuffer, traceTarget.width, traceTarget.height);
+            int rasterZone = beginGpuZone(profiler, "raster gbuffer");
+            beginHudPass(hud, kHudPassRaster);
+            renderRasterGBuffer(rasterGBuffer, camera, aspect, fov);
+            endHudPass(hud, kHudPassRaster);
+            endGpuZone(profiler, rasterZone);
+        }
 
+        // Trace into the offscreen target at the internal resolution
+        int64_t traceStartNs = profilerNow(profiler);
+        glBindFramebuffer(GL_FRAMEBUFFER, traceTarget.fbo);
+        glViewport(0, 0, traceTarget.width, traceTarget.height);
+
+        if (bvhBenchmark) {
+            stacklessEnabled = (traceFrame & 1) != 0;
+        }
+        shaderProgram = stacklessEnabled ? stacklessProgram : stackProgram;
+        glUseProgram(shaderProgram);
+
+        // Send the camera position and rotation down to the shader
+        setCameraUniforms(shaderProgram, "uCam", camera);
 
         // Update time uniform for animations
         GLint timeLoc = glGetUniformLocation(shaderProgram, "uTime");
-        glUniform1f(timeLoc, currentFrame);
+        glUniform1f(timeLoc, traceTime);
+
+        glUniform1f(glGetUniformLocation(shaderProgram, "uAspect"), aspect);
+        glUniform1f(glGetUniformLocation(shaderProgram, "uFov"), fov);
 
         // Pass feature toggles to shader
         GLint denoiseLoc = glGetUniformLocation(shaderProgram, "uDenoise");
-        glUniform1i(denoiseLoc, denoiseEnabled ? 1 : 0);
+        glUniform1i(denoiseLoc, denoiseActive ? 1 : 0);
         GLint giLoc = glGetUniformLocation(shaderProgram, "uGI");
-        glUniform1i(giLoc, giEnabled ? 1 : 0);
+        glUniform1i(giLoc, giActive ? 1 : 0);
         GLint skyboxLoc = glGetUniformLocation(shaderProgram, "uSkybox");
         glUniform1i(skyboxLoc, skyboxEnabled ? 1 : 0);
+        glUniform1i(glGetUniformLocation(shaderProgram, "uMaxBounces"), kPreviewLevelBounces[previewLevel]);
 
         // Bind the skybox HDR texture to texture unit 0 and pass its unit index.
         glActiveTexture(GL_TEXTURE0);
@@ -313,18 +854,222 @@ int main() {
         GLint skyboxTexLoc = glGetUniformLocation(shaderProgram, "uSkyboxTex");
         glUniform1i(skyboxTexLoc, 0);
 
-        // Render the full-screen quad
+        // Scene primitives for the generic path on texture unit 1.
+        bindSceneBuffers(shaderProgram, sceneBuffers, 1);
+
+        // Rasterized primary hits on texture units 2 and 3.
+        glUniform1i(glGetUniformLocation(shaderProgram, "uRasterPrimary"), hybridActive ? 1 : 0);
+        bindRasterGBuffer(shaderProgram, rasterGBuffer, 2);
+
+        // Adaptive sampling only applies to progressive accumulation of a still image;
+        // any other frame invalidates the active tile list.
+        bool adaptiveActive = adaptiveEnabled && temporalEnabled && !svgfEnabled && !animatedScene &&
+            temporalHistory.valid && !temporalCameraMoved(temporalHistory, camera);
+        if (adaptiveActive) {
+            // A sliced pass must use one tile list throughout
+            if (!slicing || tilePassStarting(tileScheduler)) {
+                collectActiveTiles(adaptiveSampler);
+            }
+        }
+        else {
+            resetAdaptiveSampler(adaptiveSampler);
+            imageConverged = false;
+        }
+        bool traceTiles = adaptiveActive && adaptiveSampler.activeTilesValid;
+        glUniform1i(glGetUniformLocation(shaderProgram, "uAdaptive"), traceTiles ? 1 : 0);
+        glActiveTexture(GL_TEXTURE0 + kAdaptiveMaskTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, adaptiveSampler.pixelMask.textures[0]);
+        glUniform1i(glGetUniformLocation(shaderProgram, "uActiveMask"), kAdaptiveMaskTextureUnit);
+
+        // Render the full-screen quad, the next slice of tiles, or only the tiles that
+        // still need samples
         glBindVertexArray(quadVAO);
+        if (traceTiles && (!slicing || tilePassStarting(tileScheduler))) {
+            // Skipped pixels must read as "no samples" in the reprojection pass
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        if (options.traceStats && (!slicing || tilePassStarting(tileScheduler))) {
+            // Pixels a pass leaves untraced must not keep the counts of an older one
+            const GLuint zeros[4] = { 0, 0, 0, 0 };
+            glClearBufferuiv(GL_COLOR, kTraceStatsAttachment, zeros);
+        }
+        beginGpuTimer(traceTimer);
+        int traceZone = beginGpuZone(profiler, "trace");
+        int slicedTiles = 0;
+        if (slicing) {
+            slicedTiles = drawNextTileBatch(tileScheduler, shaderProgram, traceTarget.width, traceTarget.height);
+        }
+        else if (traceTiles) {
+            drawTileList(adaptiveSampler.activeTiles, shaderProgram, kAdaptiveTileSize,
+                         traceTarget.width, traceTarget.height);
+        }
+        else {
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        traceFrame++;
+        TraceRecord& record = traceRecords[traceFrame % kTraceRecordCount];
+        record.level = previewLevel;
+        record.slicedTiles = slicedTiles;
+        record.pixels = slicing ? slicedTiles * kSliceTileSize * kSliceTileSize
+            : traceTiles ? adaptiveSampler.activeTiles.count * kAdaptiveTileSize * kAdaptiveTileSize
+                         : traceTarget.width * traceTarget.height;
+        record.samples = denoiseActive ? kBatchDenoisePassSamples : 1;
+        record.stackless = stacklessEnabled;
+        endGpuTimer(traceTimer, traceFrame);
+        endGpuZone(profiler, traceZone);
+        recordCpuZone(profiler, "trace", traceStartNs);
+
+        // Blend with the reprojected history of previous frames once the whole image
+        // is traced; until then the previous result stays on screen.
+        if (!slicing || tilePassComplete(tileScheduler)) {
+            int64_t resolveStartNs = profilerNow(profiler);
+            int resolveZone = beginGpuZone(profiler, svgfEnabled ? "svgf" : "reprojection");
+            beginHudPass(hud, kHudPassResolve);
+
+            // Follow the history caps of the reprojection pass
+            float passSamples = static_cast<float>(record.samples);
+            if ((temporalEnabled || svgfEnabled) && temporalHistory.valid) {
+                float cap = temporalCameraMoved(temporalHistory, camera) ? kMovingHistoryCap : kStaticHistoryCap;
+                effectiveSpp = std::min(effectiveSpp + passSamples, std::max(cap, passSamples));
+            }
+            else {
+                effectiveSpp = passSamples;
+            }
+
+            displayTexture = traceTarget.textures[0];
+            if (svgfEnabled) {
+                displayTexture = applySvgf(svgf, traceTarget, camera, aspect, fov);
+            }
+            else if (temporalEnabled) {
+                displayTexture = applyTemporalReprojection(temporalHistory, traceTarget, camera, aspect, fov);
+                if (adaptiveEnabled) {
+                    updateAdaptiveMasks(adaptiveSampler, currentTemporalHistory(temporalHistory).textures[2]);
+                }
+            }
+            restartTilePass(tileScheduler);
+            endHudPass(hud, kHudPassResolve);
+            endGpuZone(profiler, resolveZone);
+            recordCpuZone(profiler, svgfEnabled ? "svgf" : "reprojection", resolveStartNs);
+        }
+        if (traceTiles && adaptiveSampler.activeTiles.count == 0 && !imageConverged) {
+            imageConverged = true;
+            std::cout << "Adaptive sampling: image converged\n";
+        }
+
+        // Upscale the traced image to the window
+        int upscaleZone = beginGpuZone(profiler, "upscale");
+        beginHudPass(hud, kHudPassUpscale);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, fbWidth, fbHeight);
+        glUseProgram(upscaleProgram);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, displayTexture);
+        glUniform1i(glGetUniformLocation(upscaleProgram, "uSource"), 0);
+        glUniform1f(glGetUniformLocation(upscaleProgram, "uSharpness"), options.sharpness);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        if (options.traceStats) {
+            drawTraceStatsOverlay(traceStatsOverlay, traceTarget.textures[kTraceStatsAttachment]);
+        }
         glBindVertexArray(0);
+        endHudPass(hud, kHudPassUpscale);
+        endGpuZone(profiler, upscaleZone);
+
+        if (captureEnabled) {
+            ProfileZone captureZone(profiler, "capture");
+            captureFrame(frameCapture, 0, fbWidth, fbHeight);
+        }
+        if (videoMode) {
+            ProfileZone videoZone(profiler, "video");
+            encodeVideoFrame(video, displayTexture, quadVAO);
+            if (options.videoFrames > 0 && video.frameCount >= options.videoFrames) {
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
 
-        glfwSwapBuffers(window);
+        if (hud.visible) {
+            hudStats.renderWidth = traceTarget.width;
+            hudStats.renderHeight = traceTarget.height;
+            hudStats.renderScale = renderScale;
+            hudStats.effectiveSpp = effectiveSpp;
+            hudStats.activeFraction = adaptiveActiveFraction(adaptiveSampler);
+            hudStats.toggles = {
+                { "GI", giEnabled }, { "DENOISE", denoiseEnabled }, { "SKYBOX", skyboxEnabled },
+                { "TAA", temporalEnabled }, { "SVGF", svgfEnabled }, { "ADAPTIVE", adaptiveEnabled },
+                { "LOD", previewLodEnabled }, { "HYBRID", hybridEnabled }, { "STACKLESS", stacklessEnabled },
+                { "DYNRES", dynamicResolutionEnabled },
+            };
+            drawHud(hud, hudStats, fbWidth, fbHeight);
+        }
+
+        // Time spent here is the wait for the swap interval or for the GPU to
+        // drain frames queued ahead
+        {
+            ProfileZone swapZone(profiler, "swap");
+            glfwSwapBuffers(window);
+        }
+        pollFrameProfiler(profiler);
+        recordCpuZone(profiler, "frame", frameStartNs);
+
+        // Go idle once the full-quality image of a still camera has converged,
+        // by sample count or by adaptive sampling, and no pass is half done
+        bool converged = imageConverged || effectiveSpp >= options.idleSpp;
+        bool wasIdle = idle;
+        idle = idleAllowed && converged && previewLevel == kPreviewFull && tilePassStarting(tileScheduler) &&
+            !temporalCameraMoved(temporalHistory, makeCameraState(cameraPos, yaw, pitch));
+        if (idle && !wasIdle) {
+            std::cout << "Image converged at " << effectiveSpp << " spp, idle until input\n";
+        }
     }
 
+    if (bvhBenchmark) {
+        const char* names[2] = { "stack", "stackless" };
+        std::cout << "BVH traversal benchmark (GPU trace time of full-quality passes):\n";
+        for (int i = 0; i < 2; i++) {
+            std::cout << "  " << names[i] << ": ";
+            if (benchmarkPasses[i] > 0) {
+                std::cout << benchmarkMs[i] / benchmarkMegapixels[i] << " ms per megapixel over "
+                          << benchmarkPasses[i] << " passes\n";
+            }
+            else {
+                std::cout << "no passes measured\n";
+            }
+        }
+    }
+
+    if (options.traceStats) {
+        writeTraceStatsCsv(traceTarget.textures[kTraceStatsAttachment], traceTarget.width,
+                           traceTarget.height, options.traceStatsPath);
+        destroyTraceStatsOverlay(traceStatsOverlay);
+    }
+
+    if (options.profile) {
+        writeFrameProfile(profiler, options.profilePath);
+    }
+    destroyFrameProfiler(profiler);
+    destroyHud(hud);
+    destroyFrameCapture(frameCapture);
+    destroyVideoOutput(video);
+
     // Cleanup resources
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
-    glDeleteProgram(shaderProgram);
+    destroySceneBuffers(sceneBuffers);
+    destroyRenderTarget(traceTarget);
+    destroyTemporalHistory(temporalHistory);
+    destroySvgf(svgf);
+    destroyAdaptiveSampler(adaptiveSampler);
+    destroyGpuTimer(traceTimer);
+    destroyTileScheduler(tileScheduler);
+    destroyRasterGBuffer(rasterGBuffer);
+    if (gpuBvhEnabled) {
+        destroyGpuBvhBuilder(gpuBvh);
+    }
+    glDeleteProgram(upscaleProgram);
+    glDeleteProgram(stackProgram);
+    if (stacklessProgram != 0) {
+        glDeleteProgram(stacklessProgram);
+    }
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,97 @@
+#version 330 core
+layout(location = 0) out vec4 HistoryColor;   // accumulated radiance (rgb), sample count (a)
+layout(location = 1) out vec4 HistoryGeom;    // primary normal (xyz), hit distance (w)
+layout(location = 2) out vec4 HistoryMoments; // luminance mean (x), mean of squares (y), frames (z)
+in vec2 TexCoords;
+
+// This frame's trace output
+uniform sampler2D uCurrentColor; // mean of this frame's samples (rgb), sample count (a, 0 = not traced)
+uniform sampler2D uCurrentGeom;
+
+// Previous frame's accumulation
+uniform sampler2D uHistoryColor;
+uniform sampler2D uHistoryGeom;
+uniform sampler2D uHistoryMoments;
+
+uniform vec3 uCamPos;
+uniform mat3 uCamRot;
+uniform vec3 uPrevCamPos;
+uniform mat3 uPrevCamRot;
+uniform float uAspect;
+uniform float uFov;
+uniform bool uHistoryValid;
+uniform float uMaxHistory;  // cap on the accumulated sample count
+
+// Hit distance the tracer writes for rays that escape to the sky.
+const float skyDepth = 1e6;
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 current = texelFetch(uCurrentColor, pixel, 0);
+    vec4 geom = texelFetch(uCurrentGeom, pixel, 0);
+
+    // Pixels skipped this frame (adaptive sampling) keep their history untouched.
+    // Skipping only happens while the camera is still, so no reprojection is needed.
+    if (current.a == 0.0) {
+        HistoryColor = uHistoryValid ? texelFetch(uHistoryColor, pixel, 0) : vec4(0.0);
+        HistoryGeom = uHistoryValid ? texelFetch(uHistoryGeom, pixel, 0) : geom;
+        HistoryMoments = uHistoryValid ? texelFetch(uHistoryMoments, pixel, 0) : vec4(0.0);
+        return;
+    }
+
+    float lum = luminance(current.rgb);
+    HistoryGeom = geom;
+    HistoryColor = current;
+    HistoryMoments = vec4(lum, lum * lum, 1.0, 0.0);
+    if (!uHistoryValid) return;
+
+    // Rebuild this pixel's primary hit in world space (same ray as fragment_shader.glsl)
+    vec2 uv = TexCoords * 2.0 - 1.0;
+    float tanHalfFov = tan(uFov / 2.0);
+    vec3 rayDir = normalize(uCamRot * vec3(uv.x * uAspect * tanHalfFov, uv.y * tanHalfFov, 1.0));
+    vec3 worldPos = uCamPos + rayDir * geom.w;
+
+    // Project it with the previous camera. uCamRot is orthonormal, so its
+    // transpose takes world directions back into camera space.
+    vec3 local = transpose(uPrevCamRot) * (worldPos - uPrevCamPos);
+    if (local.z <= 0.0) return;
+    vec2 prevUv = vec2(local.x / (local.z * uAspect * tanHalfFov), local.y / (local.z * tanHalfFov));
+    vec2 prevCoord = prevUv * 0.5 + 0.5;
+    if (any(lessThan(prevCoord, vec2(0.0))) || any(greaterThan(prevCoord, vec2(1.0)))) return;
+
+    // Validate: the history must have seen the same surface (similar distance
+    // from the previous camera and similar orientation), or sky for sky.
+    vec2 historySize = vec2(textureSize(uHistoryGeom, 0));
+    ivec2 prevPixel = ivec2(min(prevCoord * historySize, historySize - 1.0));
+    vec4 prevGeom = texelFetch(uHistoryGeom, prevPixel, 0);
+    bool isSky = geom.w >= skyDepth * 0.5;
+    bool prevIsSky = prevGeom.w >= skyDepth * 0.5;
+    bool valid;
+    if (isSky || prevIsSky) {
+        valid = isSky && prevIsSky;
+    }
+    else {
+        float expectedDepth = length(worldPos - uPrevCamPos);
+        valid = abs(prevGeom.w - expectedDepth) < 0.05 * expectedDepth + 0.01 &&
+                dot(prevGeom.xyz, geom.xyz) > 0.9;
+    }
+    if (!valid) return;
+
+    // Blend: each sample carries equal weight until the cap is reached, after
+    // which the history decays exponentially.
+    vec4 history = texture(uHistoryColor, prevCoord);
+    float historyCount = min(history.a, uMaxHistory);
+    float count = historyCount + current.a;
+    float weight = current.a / max(count, 1.0);
+    HistoryColor = vec4(mix(history.rgb, current.rgb, weight), count);
+
+    // Moments treat each frame's mean as one observation, which is what the
+    // adaptive sampler needs to estimate the error of the accumulated mean.
+    vec4 prevMoments = texture(uHistoryMoments, prevCoord);
+    float frames = min(prevMoments.z, uMaxHistory / current.a) + 1.0;
+    HistoryMoments = vec4(mix(prevMoments.xy, vec2(lum, lum * lum), weight), frames, 0.0);
+}
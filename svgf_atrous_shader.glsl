@@ -0,0 +1,95 @@
+#version 330 core
+layout(location = 0) out vec4 OutDirect;   // filtered direct illumination (rgb), variance (a)
+layout(location = 1) out vec4 OutIndirect; // filtered indirect illumination (rgb), variance (a)
+in vec2 TexCoords;
+
+uniform sampler2D uDirect;
+uniform sampler2D uIndirect;
+uniform sampler2D uGeom;
+uniform int uStepSize;  // 1, 2, 4, ... for successive iterations
+
+// Edge-stopping parameters (Schied et al. 2017)
+const float sigmaNormal = 128.0;
+const float sigmaDepth = 1.0;
+const float sigmaLuminance = 4.0;
+
+// 5-tap B3 spline, indexed by |offset|
+const float kernelWeights[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// 3x3 Gaussian of the variance channel; stabilises the luminance edge-stopping function.
+vec2 filteredVariance(ivec2 pixel, ivec2 size) {
+    const float gaussian[2] = float[2](0.25, 0.125);
+    vec2 sum = vec2(0.0);
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            ivec2 q = clamp(pixel + ivec2(dx, dy), ivec2(0), size - 1);
+            float w = gaussian[abs(dx)] * gaussian[abs(dy)] * 4.0;
+            sum += w * vec2(texelFetch(uDirect, q, 0).a, texelFetch(uIndirect, q, 0).a);
+        }
+    }
+    return sum;
+}
+
+// Screen-space depth slope, using the one-sided difference with the smaller
+// magnitude so silhouettes do not inflate it.
+vec2 depthGradient(ivec2 pixel, ivec2 size, float depth) {
+    float left = texelFetch(uGeom, clamp(pixel - ivec2(1, 0), ivec2(0), size - 1), 0).w;
+    float right = texelFetch(uGeom, clamp(pixel + ivec2(1, 0), ivec2(0), size - 1), 0).w;
+    float down = texelFetch(uGeom, clamp(pixel - ivec2(0, 1), ivec2(0), size - 1), 0).w;
+    float up = texelFetch(uGeom, clamp(pixel + ivec2(0, 1), ivec2(0), size - 1), 0).w;
+    float gx = abs(right - depth) < abs(depth - left) ? right - depth : depth - left;
+    float gy = abs(up - depth) < abs(depth - down) ? up - depth : depth - down;
+    return vec2(gx, gy);
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(uDirect, 0);
+
+    vec4 direct = texelFetch(uDirect, pixel, 0);
+    vec4 indirect = texelFetch(uIndirect, pixel, 0);
+    vec4 geom = texelFetch(uGeom, pixel, 0);
+    float lumDirect = luminance(direct.rgb);
+    float lumIndirect = luminance(indirect.rgb);
+
+    vec2 variance = filteredVariance(pixel, size);
+    vec2 lumScale = sigmaLuminance * sqrt(max(variance, vec2(0.0))) + 1e-10;
+    vec2 gradient = depthGradient(pixel, size, geom.w);
+
+    vec4 sumDirect = vec4(0.0);
+    vec4 sumIndirect = vec4(0.0);
+    vec2 weightSum = vec2(0.0);
+
+    for (int dy = -2; dy <= 2; dy++) {
+        for (int dx = -2; dx <= 2; dx++) {
+            ivec2 offset = ivec2(dx, dy) * uStepSize;
+            ivec2 q = pixel + offset;
+            if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size))) continue;
+
+            vec4 directQ = texelFetch(uDirect, q, 0);
+            vec4 indirectQ = texelFetch(uIndirect, q, 0);
+            vec4 geomQ = texelFetch(uGeom, q, 0);
+
+            float wNormal = pow(max(dot(geom.xyz, geomQ.xyz), 0.0), sigmaNormal);
+            float wDepth = exp(-abs(geom.w - geomQ.w) / (sigmaDepth * abs(dot(gradient, vec2(offset))) + 1e-2));
+            float wGeometry = kernelWeights[abs(dx)] * kernelWeights[abs(dy)] * wNormal * wDepth;
+
+            vec2 w = wGeometry * exp(-vec2(
+                abs(lumDirect - luminance(directQ.rgb)) / lumScale.x,
+                abs(lumIndirect - luminance(indirectQ.rgb)) / lumScale.y));
+
+            // Variance propagates with squared weights
+            sumDirect += vec4(w.x * directQ.rgb, w.x * w.x * directQ.a);
+            sumIndirect += vec4(w.y * indirectQ.rgb, w.y * w.y * indirectQ.a);
+            weightSum += w;
+        }
+    }
+
+    // The center tap always has weight kernelWeights[0]^2 > 0
+    OutDirect = vec4(sumDirect.rgb / weightSum.x, sumDirect.a / (weightSum.x * weightSum.x));
+    OutIndirect = vec4(sumIndirect.rgb / weightSum.y, sumIndirect.a / (weightSum.y * weightSum.y));
+}
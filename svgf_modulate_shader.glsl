@@ -0,0 +1,17 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D uDirect;   // filtered demodulated direct lighting
+uniform sampler2D uIndirect; // filtered demodulated indirect lighting
+uniform sampler2D uAlbedo;   // this frame's primary base color
+
+// Must match svgf_temporal_shader.glsl
+const float albedoEpsilon = 0.01;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 albedo = max(texelFetch(uAlbedo, pixel, 0).rgb, vec3(albedoEpsilon));
+    vec3 lighting = texelFetch(uDirect, pixel, 0).rgb + texelFetch(uIndirect, pixel, 0).rgb;
+    FragColor = vec4(lighting * albedo, 1.0);
+}
@@ -0,0 +1,127 @@
+#version 330 core
+layout(location = 0) out vec4 OutDirect;        // integrated demodulated direct lighting (rgb)
+layout(location = 1) out vec4 OutIndirect;      // integrated demodulated indirect lighting (rgb)
+layout(location = 2) out vec4 OutMoments;       // luminance moments: direct (xy), indirect (zw)
+layout(location = 3) out vec4 OutGeom;          // primary normal (xyz), hit distance (w)
+layout(location = 4) out vec4 OutHistoryLength; // frames accumulated so far (r)
+in vec2 TexCoords;
+
+// This frame's trace output
+uniform sampler2D uColor;    // total radiance (rgb)
+uniform sampler2D uGeom;     // primary normal (xyz), hit distance (w)
+uniform sampler2D uAlbedo;   // primary base color (rgb)
+uniform sampler2D uIndirect; // radiance from secondary bounces (rgb)
+
+// Previous frame's integrated values
+uniform sampler2D uPrevDirect;
+uniform sampler2D uPrevIndirect;
+uniform sampler2D uPrevMoments;
+uniform sampler2D uPrevGeom;
+uniform sampler2D uPrevHistoryLength;
+
+uniform vec3 uCamPos;
+uniform mat3 uCamRot;
+uniform vec3 uPrevCamPos;
+uniform mat3 uPrevCamRot;
+uniform float uAspect;
+uniform float uFov;
+uniform bool uHistoryValid;
+
+const float skyDepth = 1e6;
+
+// Blend factors once enough history exists (exponential moving average)
+const float colorAlpha = 0.2;
+const float momentsAlpha = 0.2;
+const float maxHistoryLength = 32.0;
+
+// Keeps demodulation invertible for black albedo channels; must match svgf_modulate_shader.glsl
+const float albedoEpsilon = 0.01;
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// True if a history texel saw the same surface as this pixel's primary hit.
+bool isConsistent(vec4 prevGeom, vec4 geom, float expectedDepth) {
+    bool isSky = geom.w >= skyDepth * 0.5;
+    bool prevIsSky = prevGeom.w >= skyDepth * 0.5;
+    if (isSky || prevIsSky) return isSky && prevIsSky;
+    return abs(prevGeom.w - expectedDepth) < 0.05 * expectedDepth + 0.01 &&
+           dot(prevGeom.xyz, geom.xyz) > 0.9;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 geom = texelFetch(uGeom, pixel, 0);
+    vec3 color = texelFetch(uColor, pixel, 0).rgb;
+    vec3 indirectRadiance = texelFetch(uIndirect, pixel, 0).rgb;
+    vec3 albedo = max(texelFetch(uAlbedo, pixel, 0).rgb, vec3(albedoEpsilon));
+
+    // Demodulate so the filters see smooth illumination instead of texture detail
+    vec3 direct = max(color - indirectRadiance, vec3(0.0)) / albedo;
+    vec3 indirect = indirectRadiance / albedo;
+    float lumDirect = luminance(direct);
+    float lumIndirect = luminance(indirect);
+    vec4 moments = vec4(lumDirect, lumDirect * lumDirect, lumIndirect, lumIndirect * lumIndirect);
+
+    OutGeom = geom;
+
+    // Reproject this pixel's primary hit into the previous frame (as in reproject_shader.glsl)
+    vec3 prevDirect = vec3(0.0);
+    vec3 prevIndirect = vec3(0.0);
+    vec4 prevMoments = vec4(0.0);
+    float prevLength = 0.0;
+    float weightSum = 0.0;
+    if (uHistoryValid) {
+        vec2 uv = TexCoords * 2.0 - 1.0;
+        float tanHalfFov = tan(uFov / 2.0);
+        vec3 rayDir = normalize(uCamRot * vec3(uv.x * uAspect * tanHalfFov, uv.y * tanHalfFov, 1.0));
+        vec3 worldPos = uCamPos + rayDir * geom.w;
+        vec3 local = transpose(uPrevCamRot) * (worldPos - uPrevCamPos);
+        float expectedDepth = length(worldPos - uPrevCamPos);
+
+        if (local.z > 0.0) {
+            vec2 prevUv = vec2(local.x / (local.z * uAspect * tanHalfFov), local.y / (local.z * tanHalfFov));
+            vec2 size = vec2(textureSize(uPrevGeom, 0));
+            vec2 pos = (prevUv * 0.5 + 0.5) * size - 0.5;
+            ivec2 base = ivec2(floor(pos));
+            vec2 f = fract(pos);
+
+            // Bilinear tap with every texel validated on its own
+            for (int i = 0; i < 4; i++) {
+                ivec2 offset = ivec2(i & 1, i >> 1);
+                ivec2 p = base + offset;
+                if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, ivec2(size)))) continue;
+                if (!isConsistent(texelFetch(uPrevGeom, p, 0), geom, expectedDepth)) continue;
+                float w = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+                prevDirect += w * texelFetch(uPrevDirect, p, 0).rgb;
+                prevIndirect += w * texelFetch(uPrevIndirect, p, 0).rgb;
+                prevMoments += w * texelFetch(uPrevMoments, p, 0);
+                prevLength += w * texelFetch(uPrevHistoryLength, p, 0).r;
+                weightSum += w;
+            }
+        }
+    }
+
+    if (weightSum < 0.01) {
+        // Disocclusion: start a new history from this frame
+        OutDirect = vec4(direct, 1.0);
+        OutIndirect = vec4(indirect, 1.0);
+        OutMoments = moments;
+        OutHistoryLength = vec4(1.0);
+        return;
+    }
+
+    prevDirect /= weightSum;
+    prevIndirect /= weightSum;
+    prevMoments /= weightSum;
+    float historyLength = min(prevLength / weightSum + 1.0, maxHistoryLength);
+
+    // Plain average while the history is short, exponential average afterwards
+    float a = max(colorAlpha, 1.0 / historyLength);
+    float aMoments = max(momentsAlpha, 1.0 / historyLength);
+    OutDirect = vec4(mix(prevDirect, direct, a), 1.0);
+    OutIndirect = vec4(mix(prevIndirect, indirect, a), 1.0);
+    OutMoments = mix(prevMoments, moments, aMoments);
+    OutHistoryLength = vec4(historyLength);
+}
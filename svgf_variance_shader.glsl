@@ -0,0 +1,59 @@
+#version 330 core
+layout(location = 0) out vec4 OutDirect;   // direct illumination (rgb), variance (a)
+layout(location = 1) out vec4 OutIndirect; // indirect illumination (rgb), variance (a)
+in vec2 TexCoords;
+
+uniform sampler2D uDirect;
+uniform sampler2D uIndirect;
+uniform sampler2D uMoments;
+uniform sampler2D uGeom;
+uniform sampler2D uHistoryLength;
+
+// Edge-stopping parameters, shared with svgf_atrous_shader.glsl
+const float sigmaNormal = 128.0;
+const float sigmaDepth = 1.0;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(uDirect, 0);
+    vec3 direct = texelFetch(uDirect, pixel, 0).rgb;
+    vec3 indirect = texelFetch(uIndirect, pixel, 0).rgb;
+    vec4 moments = texelFetch(uMoments, pixel, 0);
+    float historyLength = texelFetch(uHistoryLength, pixel, 0).r;
+
+    if (historyLength >= 4.0) {
+        // Enough temporal samples: variance straight from the integrated moments
+        OutDirect = vec4(direct, max(moments.y - moments.x * moments.x, 0.0));
+        OutIndirect = vec4(indirect, max(moments.w - moments.z * moments.z, 0.0));
+        return;
+    }
+
+    // Short history (disocclusion): estimate the moments spatially over a 7x7
+    // neighbourhood of the same surface instead.
+    vec4 geom = texelFetch(uGeom, pixel, 0);
+    vec4 momentSum = vec4(0.0);
+    vec3 directSum = vec3(0.0);
+    vec3 indirectSum = vec3(0.0);
+    float weightSum = 0.0;
+    for (int dy = -3; dy <= 3; dy++) {
+        for (int dx = -3; dx <= 3; dx++) {
+            ivec2 q = pixel + ivec2(dx, dy);
+            if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size))) continue;
+            vec4 geomQ = texelFetch(uGeom, q, 0);
+            float wNormal = pow(max(dot(geom.xyz, geomQ.xyz), 0.0), sigmaNormal);
+            float wDepth = exp(-abs(geom.w - geomQ.w) / (sigmaDepth * length(vec2(dx, dy)) * 0.05 * geom.w + 1e-3));
+            float w = wNormal * wDepth;
+            momentSum += w * texelFetch(uMoments, q, 0);
+            directSum += w * texelFetch(uDirect, q, 0).rgb;
+            indirectSum += w * texelFetch(uIndirect, q, 0).rgb;
+            weightSum += w;
+        }
+    }
+    weightSum = max(weightSum, 1e-6);
+    momentSum /= weightSum;
+
+    // Boost the variance of young histories so the filter blurs them harder
+    float boost = 4.0 / max(historyLength, 1.0);
+    OutDirect = vec4(directSum / weightSum, max(momentSum.y - momentSum.x * momentSum.x, 0.0) * boost);
+    OutIndirect = vec4(indirectSum / weightSum, max(momentSum.w - momentSum.z * momentSum.z, 0.0) * boost);
+}
@@ -0,0 +1,27 @@
+// tile_vertex_shader.glsl
+#version 330 core
+layout(location = 0) in vec3 aPos;
+out vec2 TexCoords;
+
+// Optional tiled drawing: one instance per entry of uTiles, each covering a
+// uTileSize square of the render target (see TileList.h).
+uniform bool uTiled;
+uniform usamplerBuffer uTiles; // packed tile coordinates, x | (y << 16)
+uniform int uTileSize;
+uniform vec2 uTargetSize;
+
+void main() {
+    if (uTiled) {
+        uint packedTile = texelFetch(uTiles, gl_InstanceID).r;
+        vec2 tile = vec2(float(packedTile & 0xFFFFu), float(packedTile >> 16));
+        vec2 corner = (aPos.xy + vec2(1.0)) * 0.5;
+        vec2 pixel = min((tile + corner) * float(uTileSize), uTargetSize);
+        TexCoords = pixel / uTargetSize;
+        gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+        return;
+    }
+
+    // Convert from clip space to texture coordinates [0,1]
+    TexCoords = (aPos.xy + vec2(1.0)) * 0.5;
+    gl_Position = vec4(aPos, 1.0);
+}
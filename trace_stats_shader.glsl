@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform usampler2D uStats;  // bounces, primitive tests, samples, shader clock cycles
+uniform int uStat;          // counter to show
+uniform float uLogRange;    // log2 of the value shown at the top of the ramp
+uniform float uOpacity;
+
+// Blue through cyan, green and yellow to red
+vec3 heatColor(float x) {
+    vec3 ramp[5] = vec3[](vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 1.0, 0.0),
+                          vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0));
+    float position = x * 4.0;
+    int i = min(int(position), 3);
+    return mix(ramp[i], ramp[i + 1], position - float(i));
+}
+
+void main() {
+    // The counters are at render resolution; no filtering between pixels
+    ivec2 pixel = ivec2(TexCoords * vec2(textureSize(uStats, 0)));
+    uint value = texelFetch(uStats, pixel, 0)[uStat];
+    float x = clamp(log2(1.0 + float(value)) / uLogRange, 0.0, 1.0);
+    FragColor = vec4(heatColor(x), uOpacity);
+}
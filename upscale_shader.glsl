@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D uSource;  // internal-resolution trace result (linear filtering)
+uniform float uSharpness;   // 0 = plain bilinear upscale
+
+void main() {
+    vec3 color = texture(uSource, TexCoords).rgb;
+
+    // Unsharp mask at source texel spacing: restores some of the edge
+    // contrast lost when a low internal resolution is stretched.
+    if (uSharpness > 0.0) {
+        vec2 texel = 1.0 / vec2(textureSize(uSource, 0));
+        vec3 blur = (
+            texture(uSource, TexCoords + vec2(texel.x, 0.0)).rgb +
+            texture(uSource, TexCoords - vec2(texel.x, 0.0)).rgb +
+            texture(uSource, TexCoords + vec2(0.0, texel.y)).rgb +
+            texture(uSource, TexCoords - vec2(0.0, texel.y)).rgb
+        ) * 0.25;
+        color = max(color + (color - blur) * uSharpness, vec3(0.0));
+    }
+
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,52 @@
+#version 330 core
+out vec4 PackedOut; // four consecutive bytes of the I420 frame
+
+uniform sampler2D uSource;  // linear color at any resolution (linear filtering)
+uniform ivec2 uFrameSize;   // video frame size, even in both directions
+uniform int uTargetWidth;   // texels per row of the packed target
+uniform int uTargetHeight;
+
+// The viewer shows radiance clamped to [0, 1]. Keep that look below the
+// shoulder and roll highlights off smoothly instead of clipping them.
+vec3 tonemap(vec3 color) {
+    const float shoulder = 0.8;
+    vec3 over = max(color - shoulder, vec3(0.0));
+    vec3 rolled = shoulder + (1.0 - shoulder) * (1.0 - exp(-over / (1.0 - shoulder)));
+    return mix(clamp(color, 0.0, 1.0), rolled, step(shoulder, color));
+}
+
+// Pixel of the video frame, top row first
+vec3 fetch(ivec2 pixel) {
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(uFrameSize);
+    return tonemap(texture(uSource, vec2(uv.x, 1.0 - uv.y)).rgb);
+}
+
+// Byte b of the frame: the Y plane, then the half-resolution U and V planes.
+float frameByte(int b) {
+    int lumaSize = uFrameSize.x * uFrameSize.y;
+    if (b < lumaSize) {
+        vec3 c = fetch(ivec2(b % uFrameSize.x, b / uFrameSize.x));
+        return (16.0 + 219.0 * dot(c, vec3(0.299, 0.587, 0.114))) / 255.0;
+    }
+    ivec2 chromaSize = uFrameSize / 2;
+    b -= lumaSize;
+    int plane = b / (chromaSize.x * chromaSize.y);
+    if (plane > 1) {
+        return 0.0;  // padding after the V plane
+    }
+    b -= plane * chromaSize.x * chromaSize.y;
+    ivec2 pixel = 2 * ivec2(b % chromaSize.x, b / chromaSize.x);
+    vec3 c = 0.25 * (fetch(pixel) + fetch(pixel + ivec2(1, 0)) +
+                     fetch(pixel + ivec2(0, 1)) + fetch(pixel + ivec2(1, 1)));
+    float y = dot(c, vec3(0.299, 0.587, 0.114));
+    float chroma = plane == 0 ? (c.b - y) / 1.772 : (c.r - y) / 1.402;
+    return (128.0 + 224.0 * chroma) / 255.0;
+}
+
+void main() {
+    // Readback flips the rows, so the top row of the target holds the first bytes
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    int index = (uTargetHeight - 1 - texel.y) * uTargetWidth + texel.x;
+    PackedOut = vec4(frameByte(4 * index), frameByte(4 * index + 1),
+                     frameByte(4 * index + 2), frameByte(4 * index + 3));
+}